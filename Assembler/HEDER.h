@@ -8,48 +8,384 @@
 #include <ctype.h>
  
 /*preProc*/
-#define MAX_MACROS 100
-#define MAX_MACRO_NAME 50
-#define MAX_MACRO_BODY 50
 #define MAX_LINE_LENGTH 256
 
+/*lexer, delimiters of tokens*/
+#define SPACES 1 /* Whitespace */
+#define COMMAS 2
+#define NEWLINES 4
+#define SCAN_BLOCK 32 /* Characters classified into one mask */
+
 /*firstPass and second pass*/
 #define MAX_LABEL_LENGTH 31
-#define MAX_OPCODE_LENGTH 10
-#define MAX_METHOD_LENGTH 10
 #define MIN_MEM_VAL 100
-#define MAX_LINES 4096
+#define MIN_IMMEDIATE -2048 /* An immediate takes the 12 bits above the A,R,E field */
+#define MAX_IMMEDIATE 2047
+#define MIN_DATA -16384 /* A data value takes the whole 15 bit word */
+#define MAX_DATA 16383
 #define BITS 15
 
 
+typedef struct ArenaBlock {
+    struct ArenaBlock *next; /* The block that was current before this one */
+    size_t capacity;
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks; /* Current block first, its memory follows the header */
+    size_t total_capacity;
+    void *last; /* Last allocation, it can grow in place */
+} Arena;
+
+#define ARENA_SIZE (256 * 1024)
+
+typedef struct {
+    const char *start; /* A view of a text, not null terminated */
+    int length;
+} Span;
+
+typedef struct {
+    const char *text;
+    int length;
+    unsigned int *spaces; /* Bit i % SCAN_BLOCK of mask i / SCAN_BLOCK is set if text[i] is whitespace */
+    unsigned int *commas;
+    unsigned int *newlines;
+    unsigned int *separators; /* Whitespace or commas */
+} Scan;
+
+typedef struct {
+    const char *text; /* Mapped, or read into the arena if it can't be mapped */
+    int length;
+    bool mapped;
+} SourceFile;
+
 typedef struct {
-    char name[MAX_MACRO_NAME];
-    char body[MAX_MACRO_BODY][MAX_LINE_LENGTH];
-    int body_lines;
+    Span name; /* View of the source */
+    unsigned long hash;
+    const char *text; /* The expansion, words and lines already normalized, allocated from the arena */
+    int length;
 } Macro;
 
 typedef struct {
-    char label_name[MAX_LABEL_LENGTH];
-    char opcode_name[MAX_OPCODE_LENGTH];
-    int source_method; /* Numeric representation of source method */
-    int destination_method; /* Numeric representation of destination method */
-    char source_method_value[MAX_METHOD_LENGTH]; /* Actual value for source method (e.g., "r3") */
-    char destination_method_value[MAX_METHOD_LENGTH]; /* Actual value for destination method */
-    int memory_cells;
-    int memory_value; /* Address in memory */
-    int opcode_value; /* Numeric value for opcode */
+    char *chars; /* Null terminated text, allocated from the arena */
+    int length;
+    int capacity;
+    Arena *arena;
+} TextBuffer;
+
+typedef struct {
+    bool write_am; /* Write the source after the macro process (.am) */
+    bool write_afp; /* Write the line table of the first pass (.afp) */
+    bool write_asp; /* Write the machine words in binary (.asp) */
+    bool write_aml; /* Write the precompiled macro libraries (.aml) */
+    bool write_bo; /* Write the binary object (.bo) */
+    bool write_c; /* Write the program translated to C (.c) */
+    int jobs; /* Files assembled at the same time */
+    const char *cache; /* The directory of the build cache, or NULL */
+    bool batch_io; /* Read ahead and write behind many files at a time, with io_uring if there is one */
+} Options;
+
+typedef struct {
+    const char *name; /* The name the file would have been written as */
+    const char *text;
+    int length;
+} Artifact;
+
+typedef struct {
+    Artifact *artifacts; /* Files captured instead of written, in the order they were made */
+    int count;
+    int capacity;
+    Arena *arena;
+} ArtifactList;
+
+typedef struct IoRing IoRing;
+
+typedef struct {
+    IoRing *ring; /* NULL if io_uring is not used, the queue is then written with plain system calls */
+    ArtifactList queue; /* Outputs captured to be written together */
+    Arena arena; /* Owns the queue, reset once it is written */
+    long queued_bytes;
+    char *inputs; /* The sources read ahead, one after the other */
+    SourceFile *sources; /* The files first to first + count - 1, a length of -1 if one was not read */
+    int first;
+    int count;
+} IoBatch;
+
+typedef int (*TaskFunction)(int task, int worker, void *context);
+typedef void (*FinishFunction)(int task, void *context);
+
+typedef struct MacroTable {
+    Macro *macros; /* Grows from the arena as macros are defined */
+    int count;
+    int capacity;
+    int *slots; /* Open addressed hash slots holding macro indexes, -1 if empty */
+    int slot_count;
+    const struct MacroTable **libraries; /* Included macro libraries, searched after the table itself */
+    int library_count;
+    int library_capacity;
+    Arena *arena;
+} MacroTable;
+
+typedef struct {
+    char *name; /* The name the library was included by */
+    MacroTable table; /* Read only, its macros are views of the precompiled image */
+    SourceFile image; /* The mapped ".aml" file, or the image compiled into the batch arena */
+    int source_length; /* The library source the table was built from */
+    unsigned long source_hash;
+    bool checked; /* The source was not changed since the library was loaded or checked */
+    int file; /* The last file that included the library */
+} MacroLibrary;
+
+typedef struct {
+    MacroLibrary **libraries; /* Every library included by the batch, each loaded once */
+    int count;
+    int capacity;
+    bool write_aml;
+    int file; /* Counts the files, so a file can tell which libraries it included */
+    Arena *arena; /* The batch arena, it is not reset between files */
+} LibraryCache;
+
+typedef struct {
+    int label; /* Symbol id of the label defined on the line, -1 if there is none */
+    int text; /* Offset of the data/string/entry/extern value in the string pool, -1 if there is none */
+    int data_start; /* First word of a data or string line in the data pool */
+    signed char count_op;/*count how many opcode is there in the line*/
     bool is_data;
     bool is_string;
     bool is_entry;
     bool is_extern;
-    char data_string_value[MAX_LINE_LENGTH]; /* Actual value for data or string */
-    int count_op;/*count how many opcode is there in the line*/
     bool flag; /*Tracks errors in first and second pass*/
 } LineInfo;
 
 typedef struct {
-    char label_name[MAX_LABEL_LENGTH];
-} ExternLabels;
+    /* Fields read for every line while sizing and encoding, one contiguous array each */
+    signed char *opcode_value; /* Numeric value for opcode, -1 for directives */
+    signed char *source_method; /* Numeric representation of source method */
+    signed char *destination_method; /* Numeric representation of destination method */
+    int *source_value; /* Decoded source operand: number, register or symbol id */
+    int *destination_value; /* Decoded destination operand */
+    int *memory_value; /* Address in memory */
+    int *memory_cells;
+    LineInfo *info; /* The rest of the fields of each line */
+    int count;
+    int capacity;
+} LineTable;
+
+typedef struct {
+    char *chars; /* Null terminated texts of the lines, one after the other */
+    int length;
+    int capacity;
+} StringPool;
+
+typedef struct {
+    int symbol; /* Id of the extern symbol in the symbol table */
+    int address; /* Address of the emitted word that refers to the symbol */
+} ExternRef;
+
+typedef struct {
+    ExternRef *refs; /* Extern references in the order their words were emitted */
+    int count;
+    int capacity;
+    Arena *arena;
+} RelocationList;
+
+typedef struct {
+    unsigned short *words; /* 15 bit machine words, the first one is at address MIN_MEM_VAL */
+    int count;
+    int capacity;
+    Arena *arena;
+} MemoryImage;
+
+/*Binary object, the ".bo" file*/
+#define MAX_NUMBER_DIGITS 11 /* The longest decimal number an output line can hold */
+#define OBJECT_MAGIC "AOBJ"
+#define OBJECT_VERSION 1
+#define OBJECT_BYTE_ORDER 0x01020304U
+#define OBJECT_HAS_ENTRIES 1 /* The source states entries, the ".ent" file is made */
+#define OBJECT_HAS_EXTERNS 2 /* The source states externs, the ".ext" file is made */
+
+typedef struct {
+    char magic[4];
+    unsigned int version;
+    unsigned int byte_order; /* OBJECT_BYTE_ORDER as the writing machine stores it */
+    int flags;
+    int ic;
+    int dc;
+    int words_offset; /* ic + dc words of 16 bits, in address order from MIN_MEM_VAL */
+    int export_count;
+    int exports_offset; /* Entry labels in source order */
+    int index_offset; /* export_count export numbers, sorted by label name */
+    int extern_count;
+    int externs_offset; /* Words that refer to extern labels, in address order */
+    int names_offset; /* Null terminated label names */
+    int names_length;
+    int size; /* Size of the whole file */
+} ObjectHeader;
+
+typedef struct {
+    int name; /* Offset of the label name in the names */
+    int address;
+} ObjectSymbol;
+
+typedef struct {
+    const unsigned short *words;
+    int ic;
+    int dc;
+    int flags;
+    const ObjectSymbol *exports;
+    const int *export_index;
+    int export_count;
+    const ObjectSymbol *externs;
+    int extern_count;
+    const char *names;
+    int names_length;
+} ObjectImage;
+
+/*Simulator, the machine the words are made for*/
+#define MEMORY_SIZE 4096 /* Addresses are 12 bits */
+#define REGISTER_COUNT 8
+#define REGISTER_CELLS MEMORY_SIZE /* The registers follow the memory in the cells of the machine */
+#define CONSTANT_CELLS (MEMORY_SIZE + REGISTER_COUNT) /* Then the value of every operand word, by address */
+#define CELL_COUNT (CONSTANT_CELLS + MEMORY_SIZE)
+#define STACK_SIZE 1024 /* Return addresses of jsr */
+#define WORD_MASK 0x7FFF
+#define ADDRESS_MASK 0xFFF
+#define MACHINE_BUFFER_SIZE 65536 /* Characters read by red and printed by prn, buffered */
+#define MACHINE_PAGE_SHIFT 6 /* Memory is restored from a snapshot in pages of 64 words */
+#define MACHINE_PAGES (MEMORY_SIZE >> MACHINE_PAGE_SHIFT)
+
+/* What a decoded instruction does. The suffix tells how its operands are
+   reached: C a cell read or written as it is, I the memory cell whose address
+   is in a register cell, source first */
+enum {
+    MICRO_MOV_CC, MICRO_MOV_CI, MICRO_MOV_IC, MICRO_MOV_II, /* lea too, from a constant cell */
+    MICRO_CMP_CC, MICRO_CMP_CI, MICRO_CMP_IC, MICRO_CMP_II,
+    MICRO_ADD_CC, MICRO_ADD_CI, MICRO_ADD_IC, MICRO_ADD_II,
+    MICRO_SUB_CC, MICRO_SUB_CI, MICRO_SUB_IC, MICRO_SUB_II,
+    MICRO_CLR_C, MICRO_CLR_I,
+    MICRO_NOT_C, MICRO_NOT_I,
+    MICRO_INC_C, MICRO_INC_I,
+    MICRO_DEC_C, MICRO_DEC_I,
+    MICRO_RED_C, MICRO_RED_I,
+    MICRO_PRN_C, MICRO_PRN_I,
+    MICRO_JMP, MICRO_BNE, MICRO_JSR, /* The target is the value of the destination cell */
+    MICRO_RTS,
+    MICRO_STOP,
+    MICRO_DECODE, /* The words were written since they were decoded */
+    MICRO_ILLEGAL,
+    MICRO_EXTERN, /* Refers to an extern label, that no one linked */
+    MICRO_END, /* Past the last address */
+    MICRO_KINDS
+};
+
+typedef struct {
+    unsigned char kind; /* One of the MICRO_* kinds */
+    unsigned char size; /* Words the instruction takes */
+    unsigned short source; /* The cell of the source operand, or of the register that holds its address */
+    unsigned short destination;
+} MicroOp;
+
+/* How a run ended */
+#define MACHINE_STOPPED 0
+#define MACHINE_FAULT 1
+#define MACHINE_OUT_OF_STEPS 2
+
+typedef struct {
+    unsigned short cells[CELL_COUNT]; /* The memory, the registers and the constants of the operand words */
+    MicroOp code[MEMORY_SIZE + 1]; /* The instruction decoded at every address, the last one ends the run */
+    unsigned short stack[STACK_SIZE];
+    int stack_depth;
+    int pc;
+    bool zero; /* The Z flag, set by cmp and the arithmetic */
+    unsigned long steps; /* Instructions run so far */
+    unsigned long step_limit; /* The run stops after this many, 0 for no limit */
+    const char *fault; /* Why the last run failed, a format of the address it failed at */
+    bool print_numbers; /* prn prints the operand in decimal and a newline, not as a character */
+    int input_fd; /* Read by red */
+    int output_fd; /* Written by prn */
+    int input_length;
+    int input_position;
+    int output_length;
+    unsigned char dirty[MACHINE_PAGES]; /* The pages of memory written since the last snapshot */
+    char input[MACHINE_BUFFER_SIZE];
+    char output[MACHINE_BUFFER_SIZE];
+} Machine;
+
+/*Translator of the simulator, from micro-ops to x86-64 code*/
+typedef struct Jit Jit;
+
+/*Assembler daemon, the messages on its socket*/
+#define DEFAULT_SOCKET "/tmp/assemblerd.sock"
+#define REQUEST_MAGIC "AREQ"
+#define RESPONSE_MAGIC "ARES"
+#define REQUEST_AM 1 /* The options of the request, one bit per output asked for */
+#define REQUEST_AFP 2
+#define REQUEST_ASP 4
+#define REQUEST_AML 8
+#define REQUEST_BO 16
+#define REQUEST_C 32
+#define REQUEST_NAME_LIMIT 4096 /* The longest directory or file name the daemon takes */
+#define REQUEST_SOURCE_LIMIT (64 * 1024 * 1024) /* The longest source the daemon takes with a request */
+
+typedef struct {
+    char magic[4];
+    int options;
+    int directory_length; /* The working directory of the client, the names are relative to it */
+    int name_length; /* The name of the file, as given on the command line */
+    int source_length; /* The source follows the name, -1 if the server reads the file itself */
+} Request;
+
+typedef struct {
+    char magic[4];
+    int result; /* 0 if the batch goes on and 1 if it has to stop */
+    int messages_length; /* The ERR/WARN messages, then the system errors, follow the header */
+    int errors_length;
+    int artifact_count; /* Then the outputs of a source sent in the request, each an ArtifactHeader, name and text */
+} Response;
+
+typedef struct {
+    int name_length;
+    int length;
+} ArtifactHeader;
+
+typedef struct {
+    int *values; /* Decoded data and string words of the file, in line order */
+    int count;
+    int capacity;
+} DataPool;
+
+/*Symbol flags*/
+#define SYMBOL_DEFINED 1
+#define SYMBOL_ENTRY 2
+#define SYMBOL_EXTERN 4
+
+typedef struct {
+    int name; /* Offset of the interned name in the names pool */
+    unsigned long hash;
+    int address; /* Memory value of the label, -1 if it is not defined */
+    int flags; /* SYMBOL_DEFINED / SYMBOL_ENTRY / SYMBOL_EXTERN */
+} Symbol;
+
+typedef struct {
+    Symbol *symbols; /* Symbols by id, in the order they were added */
+    int count;
+    int capacity;
+    int *slots; /* Open addressed hash slots holding symbol ids, -1 if empty */
+    int slot_count;
+    char *names; /* Pool of the interned, null terminated names */
+    int names_length;
+    int names_capacity;
+    Arena *arena;
+} SymbolTable;
+
+typedef struct {
+    LineTable lines;
+    SymbolTable symbols;
+    DataPool data;
+    StringPool strings;
+    Arena *arena; /* The per-file arena that owns all the memory of the program */
+} Program;
 
 typedef enum {
     IMMEDIATE = 0, 
@@ -64,44 +400,175 @@ typedef enum {
     E = 1  
 } FieldType;
 
+typedef struct {
+    bool legal; /* The opcode accepts this pair of methods */
+    int words; /* Memory cells the instruction takes */
+    int first_word; /* Encoded opcode, methods and A/R/E field */
+} InstructionForm;
+
+
+
+/*Stating the prototype of the arena functions*/
+void initArena(Arena *arena, size_t capacity);
+void *arenaAlloc(Arena *arena, size_t size);
+void *arenaGrow(Arena *arena, void *memory, size_t old_size, size_t new_size);
+char *arenaString(Arena *arena, const char *str, size_t extra);
+void resetArena(Arena *arena);
+void freeArena(Arena *arena);
+
+/*Stating the prototype of the lexer functions*/
+int openSource(SourceFile *source, const char *name_of_file, Arena *arena);
+void closeSource(SourceFile *source);
+int replaceFile(const char *name_of_file, const char *text, int length);
+int nextLine(const Scan *scan, const char **cursor, Span *line);
+Span trimSpan(const Scan *scan, Span span);
+int nextToken(const Scan *scan, Span *rest, int delimiters, Span *token);
+const char *findDelimiter(const Scan *scan, Span span, int delimiters);
+int spanEquals(Span span, const char *str);
 
+/*Stating the prototype of the scanner functions*/
+void initScanner(void);
+void scanText(Scan *scan, const char *text, int length, Arena *arena);
 
-extern Macro macros[MAX_MACROS];
-extern int macro_count;
+/*Stating the prototype of the diagnostics functions*/
+void setDiagnostics(FILE *message_stream, FILE *error_stream);
+void report(const char *format, ...);
+void reportError(const char *message);
+FILE *messageStream(void);
+FILE *errorStream(void);
+ArtifactList *captureOutputs(ArtifactList *outputs);
+int captureOutput(const char *name_of_file, const char *text, int length);
+
+/*Stating the prototype of the batched I/O functions*/
+void initIoBatch(IoBatch *io);
+void flushOutputs(IoBatch *io);
+ArtifactList *queueOutputs(IoBatch *io);
+void endQueue(IoBatch *io, ArtifactList *previous);
+void prefetchInputs(IoBatch *io, char **files, int first, int count);
+SourceFile *takeInput(IoBatch *io, char **files, int task, int task_count);
+void freeIoBatch(IoBatch *io);
+
+/*Stating the prototype of the thread pool functions*/
+int runTasks(int task_count, int worker_count, TaskFunction run, FinishFunction finish, void *context);
 
 /*Stating the prototype of the pre assembler functions*/
-int preAss(char *name_of_file);
-void trim_whitespace(char* str);
-void remove_blank_lines(const char *input_file);
-void add_macro(const char* name, char body[][MAX_LINE_LENGTH], int body_lines);
-Macro* get_macro(const char* name);
-void process_file(const char* input_file, const char* output_file);
-int preAss(char *name_of_file);
+void appendText(TextBuffer *buffer, const char *text, int length);
+int writeTextFile(const char *name_of_file, const char *text, int length);
+void initMacroTable(MacroTable *table, Arena *arena);
+void add_macro(MacroTable *table, Span name, const char *text, int length);
+Macro* get_macro(MacroTable *table, Span name);
+int process_file(const char* source, int length, TextBuffer *output, MacroTable *table, LibraryCache *cache);
+int preAss(const SourceFile *source, LibraryCache *cache, Arena *arena, Span *expanded);
+
+/*Stating the prototype of the macro library functions*/
+void initLibraryCache(LibraryCache *cache, Arena *arena, bool write_aml);
+const MacroTable *loadLibrary(LibraryCache *cache, const char *name);
+int hashLibrary(const char *name, Arena *arena, int *length, unsigned long *hash);
+void expireLibraries(LibraryCache *cache);
+void freeLibraryCache(LibraryCache *cache);
+
+/*Stating the prototype of the driver functions*/
+int parseOption(const char *arg, Options *options);
+char *baseName(const char *file_name, Arena *arena);
+int assembleText(SourceFile *source, const char *base_name, const Options *options, Arena *arena,
+                 LibraryCache *libraries);
+int assembleFile(const char *file_name, SourceFile *input, const Options *options, Arena *arena,
+                 LibraryCache *libraries);
+
+/*Stating the prototype of the build cache functions*/
+int assembleCached(SourceFile *source, const char *file_name, const char *base_name, const Options *options,
+                   Arena *arena, LibraryCache *libraries);
+
+/*Stating the prototype of the daemon socket functions*/
+const char *socketPath(const char *given);
+int listenSocket(const char *path);
+int connectSocket(const char *path);
+int sendAll(int fd, const void *data, size_t length);
+int receiveAll(int fd, void *data, size_t length);
+int packOptions(const Options *options);
+void unpackOptions(int bits, Options *options);
+
+/*Stating the prototype of the program functions*/
+void initProgram(Program *program, Arena *arena);
+int addLine(Program *program);
+int addString(Program *program, const char *str, int length);
+const char *lineText(const Program *program, int index);
+void addDataValue(Program *program, int value);
+char *outputName(Arena *arena, const char *base_name, const char *extension);
 
 /*Stating the prototype of the first pass functions*/
-int firstPass(char *name_of_file,LineInfo *lines ,int line_count);
-void initializeLineInfo(LineInfo *lineInfo);
-int getOpcodeValue(char *opcode_name);
-int calcData(char *str);
-int calcString(char *str);
-int calculateMemoryCells(LineInfo *lineInfo);
-void processLine(char *line, LineInfo *lineInfo);
-void parseMethod(const char *method_name, int *method, char *value);
-void processInputFile(FILE *file, LineInfo *lines, int *line_count);
+int firstPass(Span source, const char *base_name, const Options *options, Arena *arena);
+int parseNumber(Span text, int *value);
+int parseData(const Scan *scan, Span text, Program *program, int index);
+int calculateMemoryCells(Program *program, int index, int data_count);
+int badLabel(Span token);
+void processLine(const Scan *scan, Span line, Program *program, int index);
+int parseMethod(Span method_name, int *method, int *value, SymbolTable *symbols, int line);
+void formatOperand(const SymbolTable *symbols, int method, int value, char *text);
+int processInputFile(Span source, Program *program);
+void makeAfp(Program *program, const char *base_name);
 
-/*Stating the prototype of the second pass functions*/
-int secondPass(char *name_of_file ,LineInfo *lines, int line_count);
+/*Stating the prototype of the opcode table functions*/
+int getOpcodeValue(Span opcode_name);
+const char *getOpcodeName(int opcode_value);
 int getOperandCount(int opcode_value);
-char* printBinary(int num);
-int findLabelMemory(LineInfo lines[], int numLines, char *label);
-int findLabelAddress(LineInfo lines[], int numLines, char *label);
-void generateOutput(LineInfo lines[], int numLines, const char *filename);
-void makeOb(int machine[], const char *filename, int dc, int ic);
-int isExtern(LineInfo *lines,int num_of_lines,char *label);
-void makeExt(LineInfo *lines,int num_of_lines, char *filename);
-void makeEnt(LineInfo *lines,int num_of_lines, char *filename);
-int isFlag(LineInfo lines[], int numLines);
-int isGoodLine(LineInfo line);
+InstructionForm getInstructionForm(int opcode_value, int source_method, int destination_method);
+
+/*Stating the prototype of the symbol table functions*/
+unsigned long hashName(const char *name, int length);
+void initSymbolTable(SymbolTable *table, Arena *arena);
+const char *symbolName(const SymbolTable *table, int id);
+int findSymbol(const SymbolTable *table, const char *name);
+int internSymbol(SymbolTable *table, const char *name, int length);
+void buildSymbolTable(Program *program);
+int resolveSymbols(Program *program);
+
+/*Stating the prototype of the second pass functions*/
+int secondPass(const char *base_name, Program *program, const Options *options);
+char* printBinary(int num, char *binary_str);
+void formatOctal(int word, char *out);
+int formatDecimal(int value, int width, char *out);
+int findLabelAddress(SymbolTable *symbols, int id);
+int encodeOperand(int method, int value, int shift, SymbolTable *symbols);
+int encodeProgram(Program *program, ObjectImage *object);
+void generateOutput(Program *program, const char *base_name, const Options *options);
+void addWord(MemoryImage *image, int word);
+void makeOb(const MemoryImage *image, const char *base_name, int dc, int ic);
+void addExternRef(RelocationList *relocations, int symbol, int address);
+int isFlag(LineTable *lines);
+int isGoodLine(LineTable *lines, int index);
+
+/*Stating the prototype of the C backend functions*/
+int makeC(Program *program, const ObjectImage *object, const char *base_name);
+
+/*Stating the prototype of the object file functions*/
+void buildObject(Program *program, const MemoryImage *image, const RelocationList *relocations, int ic, int dc,
+                 ObjectImage *object);
+int writeObjectText(const ObjectImage *object, const char *base_name, Arena *arena);
+int readObjectText(const char *base_name, Arena *arena, ObjectImage *object);
+int writeObjectFile(const ObjectImage *object, const char *name_of_file, Arena *arena);
+int loadObjectFile(const SourceFile *file, ObjectImage *object);
+
+/*Stating the prototype of the machine functions*/
+void initMachine(Machine *machine, int input_fd, int output_fd);
+int loadMachine(Machine *machine, const ObjectImage *object);
+void decodeInstruction(Machine *machine, int address);
+int runMachine(Machine *machine);
+int stepMachine(Machine *machine, unsigned long count);
+int endRun(Machine *machine, int status);
+void markWritten(Machine *machine, int at);
+void snapshotMachine(Machine *machine, Machine *snapshot);
+int restoreMachine(Machine *machine, const Machine *snapshot);
+
+/*Stating the prototype of the translator functions*/
+Jit *createJit(void);
+void freeJit(Jit *jit);
+int runJit(Machine *machine, Jit *jit);
+
+/*Stating the prototype of the lane functions*/
+int runLanes(const Machine *base, char **names, int count, bool statistics);
+int fillMachineInput(Machine *machine);
+void flushMachineOutput(Machine *machine);
 
 
 #endif
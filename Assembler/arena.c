@@ -0,0 +1,149 @@
+#include "HEDER.h"
+
+/* Every allocation is rounded up so any type can be stored at its start */
+#define ARENA_ALIGN 8
+#define ALIGN_SIZE(size) (((size) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+
+/**
+ * @brief Allocates a new block and makes it the current block of the arena.
+ * @param arena The arena that the block is added to.
+ * @param capacity The number of bytes the block can hold.
+ */
+static void addBlock(Arena *arena, size_t capacity) {
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + capacity);
+
+    if (block == NULL) {
+        perror("ERR: Unable to allocate memory for the arena");
+        exit(EXIT_FAILURE);
+    }
+    block->next = arena->blocks;
+    block->capacity = capacity;
+    block->used = 0;
+    arena->blocks = block;
+    arena->total_capacity += capacity;
+}
+
+/**
+ * @brief Initializes an arena with one block.
+ * @param arena A pointer to the arena to be initialized.
+ * @param capacity The number of bytes of the first block.
+ */
+void initArena(Arena *arena, size_t capacity) {
+    arena->blocks = NULL;
+    arena->total_capacity = 0;
+    arena->last = NULL;
+    addBlock(arena, ALIGN_SIZE(capacity));
+}
+
+/**
+ * @brief Allocates memory from the arena.
+ *
+ * The memory stays valid until the arena is reset. When the current block is
+ * full a new block, at least twice as big, is added.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the memory, never NULL.
+ */
+void *arenaAlloc(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->blocks;
+    char *memory;
+
+    size = ALIGN_SIZE(size);
+    if (block->capacity - block->used < size) {
+        addBlock(arena, size > block->capacity * 2 ? size : block->capacity * 2);
+        block = arena->blocks;
+    }
+    memory = (char *)(block + 1) + block->used;
+    block->used += size;
+    arena->last = memory;
+    return memory;
+}
+
+/**
+ * @brief Grows an allocation of the arena.
+ *
+ * The last allocation grows in place when its block has room, any other
+ * allocation is copied to new memory (the old copy is released on reset).
+ *
+ * @param arena The arena that owns the allocation.
+ * @param memory The allocation to grow, or NULL for a new allocation.
+ * @param old_size The current size of the allocation.
+ * @param new_size The size needed.
+ * @return A pointer to the grown allocation.
+ */
+void *arenaGrow(Arena *arena, void *memory, size_t old_size, size_t new_size) {
+    ArenaBlock *block = arena->blocks;
+    char *new_memory;
+
+    if (memory != NULL && memory == arena->last &&
+        (char *)memory + ALIGN_SIZE(new_size) <= (char *)(block + 1) + block->capacity) {
+        block->used = ((char *)memory - (char *)(block + 1)) + ALIGN_SIZE(new_size);
+        return memory;
+    }
+    new_memory = (char *)arenaAlloc(arena, new_size);
+    if (memory != NULL) {
+        memcpy(new_memory, memory, old_size);
+    }
+    return new_memory;
+}
+
+/**
+ * @brief Copies a string into the arena.
+ * @param arena The arena to allocate from.
+ * @param str The string to copy.
+ * @param extra Extra bytes to reserve after the string (e.g. for a longer extension).
+ * @return A pointer to the copy.
+ */
+char *arenaString(Arena *arena, const char *str, size_t extra) {
+    size_t length = strlen(str) + 1;
+    char *copy = (char *)arenaAlloc(arena, length + extra);
+
+    memcpy(copy, str, length);
+    return copy;
+}
+
+/**
+ * @brief Releases everything allocated from the arena, keeping its memory.
+ *
+ * If the arena had to add blocks, they are merged into one block of the
+ * total size, so a batch of files of the same size allocates only once.
+ *
+ * @param arena The arena to reset.
+ */
+void resetArena(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    ArenaBlock *next;
+    size_t capacity = arena->total_capacity;
+
+    if (block->next != NULL) {
+        while (block != NULL) {
+            next = block->next;
+            free(block);
+            block = next;
+        }
+        arena->blocks = NULL;
+        arena->total_capacity = 0;
+        addBlock(arena, capacity);
+    }
+    arena->blocks->used = 0;
+    arena->last = NULL;
+}
+
+/**
+ * @brief Frees all the memory of the arena.
+ * @param arena The arena to free.
+ */
+void freeArena(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    ArenaBlock *next;
+
+    while (block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->total_capacity = 0;
+    arena->last = NULL;
+}
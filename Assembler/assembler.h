@@ -0,0 +1,59 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+/*
+ * The assembler as a library (libassembler.a).
+ *
+ * A context assembles one source buffer at a time into memory, nothing is
+ * read from or written to files but the macro libraries named by ".include".
+ * Contexts share no state, so every thread can assemble with its own context
+ * at the same time. A context itself must not be used by two threads at once.
+ */
+
+/*Symbol flags*/
+#define ASM_SYMBOL_DEFINED 1
+#define ASM_SYMBOL_ENTRY 2
+#define ASM_SYMBOL_EXTERN 4
+
+/*Word kinds*/
+#define ASM_WORD_CODE 0
+#define ASM_WORD_DATA 1
+
+typedef struct AssemblerContext AssemblerContext;
+
+typedef struct {
+    const char *name;
+    int address; /* -1 for a symbol that is not defined in the source */
+    int flags; /* ASM_SYMBOL_DEFINED / ASM_SYMBOL_ENTRY / ASM_SYMBOL_EXTERN */
+} AsmSymbol;
+
+typedef struct {
+    const char *name;
+    int address;
+} AsmReference;
+
+/* Everything points into the context and is valid until its next assembly */
+typedef struct {
+    /* The 15 bit words in address order, the first one is at address 100. The data is laid out in
+       source order, so data words may be between the instructions; kinds tells the two apart. */
+    const unsigned short *words;
+    const unsigned char *kinds; /* ASM_WORD_CODE or ASM_WORD_DATA for every word */
+    int word_count; /* code_length + data_length */
+    int code_length;
+    int data_length;
+    const AsmSymbol *symbols; /* Every label of the source, in the order they were found */
+    int symbol_count;
+    const AsmReference *entries; /* The entry labels and their addresses, the ".ent" file */
+    int entry_count;
+    const AsmReference *externs; /* The words that refer to extern labels, the ".ext" file */
+    int extern_count;
+    const char *diagnostics; /* The ERR/WARN messages, null terminated */
+    int diagnostics_length;
+    int errors; /* 1 if the source has errors, the images are then incomplete */
+} AsmResult;
+
+AssemblerContext *createAssembler(void);
+int assembleSource(AssemblerContext *context, const char *source, int length, AsmResult *result);
+void destroyAssembler(AssemblerContext *context);
+
+#endif
@@ -0,0 +1,354 @@
+/* link and open_memstream are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+#include "HEDER.h"
+
+/* The first bytes of a manifest, the digit is the version of the layout */
+#define CACHE_MAGIC "ACM1"
+/* The makefile passes the checksum of the sources, a build without it has to change this by hand */
+#ifndef CACHE_VERSION
+#define CACHE_VERSION "1"
+#endif
+#define KEY_LENGTH 16 /* Hexadecimal digits of a key */
+
+/*
+ * An entry of the cache is a manifest, "<key>.acm", and the outputs, one
+ * "<key><extension>" file each. The key hashes the assembler, the options,
+ * the name and the text of the source. The manifest holds the libraries the
+ * source included, which are checked before the entry is used, the
+ * extensions of the outputs and the messages of the source.
+ */
+typedef struct {
+    char magic[4];
+    int source_length;
+    int library_count; /* Each a CacheLibrary and its name */
+    int output_count; /* Each the length of the extension and the extension */
+    int messages_length; /* Then the ERR/WARN messages */
+} CacheManifest;
+
+typedef struct {
+    int name_length;
+    int source_length;
+    unsigned long source_hash;
+} CacheLibrary;
+
+/* Two 32 bit hashes, FNV-1a and sdbm, side by side */
+typedef struct {
+    unsigned long fnv;
+    unsigned long sdbm;
+} CacheKey;
+
+/**
+ * @brief Adds a text to a key.
+ * @param key The key.
+ * @param text The text.
+ * @param length The length of the text, the text may hold nulls.
+ */
+static void hashInto(CacheKey *key, const char *text, int length) {
+    unsigned long fnv = key->fnv, sdbm = key->sdbm;
+    unsigned char c;
+
+    while (length-- > 0) {
+        c = (unsigned char)*text++;
+        fnv = ((fnv ^ c) * 16777619UL) & 0xFFFFFFFFUL;
+        sdbm = (c + (sdbm << 6) + (sdbm << 16) - sdbm) & 0xFFFFFFFFUL;
+    }
+    key->fnv = fnv;
+    key->sdbm = sdbm;
+}
+
+/**
+ * @brief Gives the name a file of an entry has in the cache.
+ * @param options The options, with the directory of the cache.
+ * @param key The key of the entry, in hexadecimal.
+ * @param extension The extension of the file.
+ * @param arena The per-file arena.
+ * @return The name, allocated from the arena.
+ */
+static char *cachedName(const Options *options, const char *key, const char *extension, Arena *arena) {
+    char *name = (char *)arenaAlloc(arena, strlen(options->cache) + KEY_LENGTH + strlen(extension) + 2);
+
+    sprintf(name, "%s/%s%s", options->cache, key, extension);
+    return name;
+}
+
+/**
+ * @brief Computes the key of a source.
+ * @param source The source.
+ * @param file_name The name of the file, the messages and the ".am" name hold it.
+ * @param options The options.
+ * @param key The key, KEY_LENGTH hexadecimal digits and a null.
+ */
+static void sourceKey(const SourceFile *source, const char *file_name, const Options *options, char *key) {
+    CacheKey hash;
+    char flags[6];
+
+    flags[0] = (char)options->write_am;
+    flags[1] = (char)options->write_asp;
+    flags[2] = (char)options->write_aml;
+    flags[3] = (char)options->write_bo;
+    flags[4] = (char)options->write_c;
+    flags[5] = 0;
+    hash.fnv = 2166136261UL;
+    hash.sdbm = 0;
+    hashInto(&hash, CACHE_VERSION, (int)sizeof(CACHE_VERSION));
+    hashInto(&hash, flags, (int)sizeof(flags));
+    hashInto(&hash, file_name, (int)strlen(file_name) + 1);
+    hashInto(&hash, source->text, source->length);
+    sprintf(key, "%08lx%08lx", hash.fnv, hash.sdbm);
+}
+
+/**
+ * @brief Puts a file of the cache in place of an output, as a hard link.
+ *
+ * The assembler replaces its outputs instead of writing into them, so it
+ * never changes the cache through a link. A file system without hard links
+ * gets a copy.
+ *
+ * @param cached The file in the cache.
+ * @param output The output.
+ * @param arena The per-file arena.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int linkOutput(const char *cached, const char *output, Arena *arena) {
+    SourceFile file;
+    int failed;
+
+    remove(output);
+    if (link(cached, output) == 0) {
+        return 0;
+    }
+    if (openSource(&file, cached, arena) == 1) {
+        return 1;
+    }
+    failed = writeTextFile(output, file.text, file.length);
+    closeSource(&file);
+    return failed;
+}
+
+/**
+ * @brief Reads an int of a manifest, which is not aligned.
+ * @param cursor The place of the int, moved past it.
+ * @param end The end of the manifest.
+ * @param value The int.
+ * @param size The size of the value.
+ * @return 0 if succeded and 1 if the manifest ends before it.
+ */
+static int readField(const char **cursor, const char *end, void *value, size_t size) {
+    if ((size_t)(end - *cursor) < size) {
+        return 1;
+    }
+    memcpy(value, *cursor, size);
+    *cursor += size;
+    return 0;
+}
+
+/**
+ * @brief Restores the outputs and messages of a source from the cache.
+ * @param source The source.
+ * @param key The key of the source.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The options.
+ * @param arena The per-file arena.
+ * @return 0 if the entry was used and 1 if there is none, or its libraries were changed.
+ */
+static int restoreEntry(const SourceFile *source, const char *key, const char *base_name, const Options *options,
+                        Arena *arena) {
+    SourceFile file;
+    CacheManifest manifest;
+    CacheLibrary library;
+    const char *cursor, *end;
+    char *name;
+    int i, length, missed = 0;
+    unsigned long hash;
+
+    if (openSource(&file, cachedName(options, key, ".acm", arena), arena) == 1) {
+        return 1;
+    }
+    cursor = file.text;
+    end = file.text + file.length;
+    if (readField(&cursor, end, &manifest, sizeof(manifest)) == 1 || memcmp(manifest.magic, CACHE_MAGIC, 4) != 0 ||
+        manifest.source_length != source->length) {
+        closeSource(&file);
+        return 1;
+    }
+    for (i = 0; i < manifest.library_count; i++) {
+        if (readField(&cursor, end, &library, sizeof(library)) == 1 || library.name_length < 0 ||
+            end - cursor < library.name_length) {
+            closeSource(&file);
+            return 1;
+        }
+        name = arenaString(arena, "", (size_t)library.name_length);
+        memcpy(name, cursor, (size_t)library.name_length);
+        name[library.name_length] = '\0';
+        cursor += library.name_length;
+        if (hashLibrary(name, arena, &length, &hash) == 1 || length != library.source_length ||
+            hash != library.source_hash) {
+            closeSource(&file);
+            return 1;
+        }
+    }
+
+    /* The outputs are linked first, an entry missing a file is assembled again */
+    for (i = 0; i < manifest.output_count && missed == 0; i++) {
+        if (readField(&cursor, end, &length, sizeof(length)) == 1 || length < 0 || end - cursor < length) {
+            missed = 1;
+            break;
+        }
+        name = arenaString(arena, "", (size_t)length);
+        memcpy(name, cursor, (size_t)length);
+        name[length] = '\0';
+        cursor += length;
+        missed = linkOutput(cachedName(options, key, name, arena), outputName(arena, base_name, name), arena);
+    }
+    if (missed == 0) {
+        if (manifest.messages_length < 0 || end - cursor < manifest.messages_length) {
+            missed = 1;
+        } else {
+            fwrite(cursor, 1, (size_t)manifest.messages_length, messageStream());
+        }
+    }
+    closeSource(&file);
+    return missed;
+}
+
+/**
+ * @brief Stores the outputs and messages of a source in the cache, and puts the outputs in place.
+ * @param source The source.
+ * @param key The key of the source.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The options.
+ * @param artifacts The outputs, captured instead of written.
+ * @param messages The messages of the source.
+ * @param messages_length The length of the messages.
+ * @param libraries The macro libraries, the ones the source included are recorded.
+ * @param arena The per-file arena.
+ */
+static void storeEntry(const SourceFile *source, const char *key, const char *base_name, const Options *options,
+                       const ArtifactList *artifacts, const char *messages, int messages_length,
+                       const LibraryCache *libraries, Arena *arena) {
+    TextBuffer text;
+    CacheManifest manifest;
+    CacheLibrary library;
+    const char *extension;
+    size_t base_length = strlen(base_name);
+    int i, length;
+
+    text.chars = NULL;
+    text.length = 0;
+    text.capacity = 0;
+    text.arena = arena;
+    memcpy(manifest.magic, CACHE_MAGIC, 4);
+    manifest.source_length = source->length;
+    manifest.library_count = 0;
+    manifest.output_count = artifacts->count;
+    manifest.messages_length = messages_length;
+    for (i = 0; i < libraries->count; i++) {
+        if (libraries->libraries[i]->file == libraries->file) {
+            manifest.library_count++;
+        }
+    }
+    appendText(&text, (const char *)&manifest, (int)sizeof(manifest));
+    for (i = 0; i < libraries->count; i++) {
+        if (libraries->libraries[i]->file == libraries->file) {
+            library.name_length = (int)strlen(libraries->libraries[i]->name);
+            library.source_length = libraries->libraries[i]->source_length;
+            library.source_hash = libraries->libraries[i]->source_hash;
+            appendText(&text, (const char *)&library, (int)sizeof(library));
+            appendText(&text, libraries->libraries[i]->name, library.name_length);
+        }
+    }
+
+    for (i = 0; i < artifacts->count; i++) {
+        extension = artifacts->artifacts[i].name + base_length;
+        length = (int)strlen(extension);
+        appendText(&text, (const char *)&length, (int)sizeof(length));
+        appendText(&text, extension, length);
+        if (replaceFile(cachedName(options, key, extension, arena), artifacts->artifacts[i].text,
+                        artifacts->artifacts[i].length) == 1 ||
+            linkOutput(cachedName(options, key, extension, arena), artifacts->artifacts[i].name, arena) == 1) {
+            writeTextFile(artifacts->artifacts[i].name, artifacts->artifacts[i].text, artifacts->artifacts[i].length);
+            text.length = 0; /* The entry is not complete, its manifest is not written */
+        }
+    }
+    appendText(&text, messages, messages_length);
+
+    /* The manifest is written last, once all the outputs are in the cache */
+    if (text.length > 0) {
+        replaceFile(cachedName(options, key, ".acm", arena), text.chars, text.length);
+    }
+}
+
+/**
+ * @brief Assembles a source through the build cache.
+ *
+ * A source that was assembled before, with the same options and libraries,
+ * gets its outputs as links to the cache and its messages again, without
+ * being assembled. Otherwise it is assembled with its outputs and messages
+ * captured, and if it has no errors they are stored in the cache.
+ *
+ * @param source The source, it is closed.
+ * @param file_name The name of the file, as given on the command line.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The options, with the directory of the cache.
+ * @param arena The per-file arena.
+ * @param libraries The macro libraries of the worker.
+ * @return 0 if the batch goes on (even if the file had errors) and 1 if it has to stop.
+ */
+int assembleCached(SourceFile *source, const char *file_name, const char *base_name, const Options *options,
+                   Arena *arena, LibraryCache *libraries) {
+    char key[KEY_LENGTH + 1];
+    ArtifactList artifacts, *queued;
+    FILE *previous, *errors, *messages;
+    char *messages_text = NULL;
+    size_t messages_length = 0, base_length = strlen(base_name);
+    int i, result, complete = 0;
+
+    sourceKey(source, file_name, options, key);
+    if (restoreEntry(source, key, base_name, options, arena) == 0) {
+        closeSource(source);
+        return 0;
+    }
+
+    artifacts.artifacts = NULL;
+    artifacts.count = 0;
+    artifacts.capacity = 0;
+    artifacts.arena = arena;
+    previous = messageStream();
+    errors = errorStream();
+    messages = open_memstream(&messages_text, &messages_length);
+    if (messages == NULL) {
+        perror("ERR: Unable to allocate memory for the diagnostics");
+        exit(EXIT_FAILURE);
+    }
+    setDiagnostics(messages, errors);
+    queued = captureOutputs(&artifacts);
+    /* assembleText only needs the text, the key was taken before the source is closed */
+    result = assembleText(source, base_name, options, arena, libraries);
+    captureOutputs(queued);
+    setDiagnostics(previous, errors);
+    fclose(messages);
+    fwrite(messages_text, 1, messages_length, previous);
+
+    /* Only a source that made its ".ob" file is stored, its outputs don't depend on anything else */
+    for (i = 0; i < artifacts.count; i++) {
+        if (strncmp(artifacts.artifacts[i].name, base_name, base_length) != 0) {
+            complete = 0;
+            break;
+        }
+        if (strcmp(artifacts.artifacts[i].name + base_length, ".ob") == 0) {
+            complete = 1;
+        }
+    }
+    if (result == 0 && complete) {
+        storeEntry(source, key, base_name, options, &artifacts, messages_text, (int)messages_length, libraries,
+                   arena);
+    } else {
+        for (i = 0; i < artifacts.count; i++) {
+            writeTextFile(artifacts.artifacts[i].name, artifacts.artifacts[i].text, artifacts.artifacts[i].length);
+        }
+    }
+    free(messages_text);
+    return result;
+}
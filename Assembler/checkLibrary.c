@@ -0,0 +1,281 @@
+/* pthread_create is POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "assembler.h"
+
+/*
+ * Checks libassembler.a through its public API only:
+ *     ./checkLibrary
+ * Every failed check is printed, and the exit status is 1 if any failed.
+ */
+
+#define THREAD_RUNS 200
+
+static int checks = 0;
+static int failures = 0;
+
+/* Data between two instructions, the words of V are at 103 and 104 */
+static const char interleaved[] =
+    "MAIN: mov #1, r1\n"
+    "V: .data 7, 8\n"
+    "inc r1\n"
+    "stop\n";
+
+static const char linked[] =
+    ".extern X\n"
+    ".entry MAIN\n"
+    "MAIN: jmp X\n"
+    "lea S, r2\n"
+    "stop\n"
+    "S: .string \"ab\"\n";
+
+static const char faulty[] =
+    "mov #5000, r1\n"
+    "L: .data 7, 99999\n"
+    "stop\n";
+
+typedef struct {
+    const char *source;
+    const AsmResult *expected;
+    int failed_runs;
+} ThreadCheck;
+
+/**
+ * @brief Counts a check and prints it if it failed.
+ * @param passed The outcome of the check.
+ * @param what What was checked.
+ */
+static void check(int passed, const char *what) {
+    checks++;
+    if (!passed) {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+/**
+ * @brief Assembles a null terminated source with a context.
+ * @param context The context.
+ * @param source The source.
+ * @param result The result.
+ * @return The return value of assembleSource.
+ */
+static int assemble(AssemblerContext *context, const char *source, AsmResult *result) {
+    return assembleSource(context, source, (int)strlen(source), result);
+}
+
+/**
+ * @brief Finds a symbol of a result by name.
+ * @param result The result.
+ * @param name The name of the symbol.
+ * @return The symbol, or NULL if the result has none by that name.
+ */
+static const AsmSymbol *findResultSymbol(const AsmResult *result, const char *name) {
+    int i;
+
+    for (i = 0; i < result->symbol_count; i++) {
+        if (strcmp(result->symbols[i].name, name) == 0) {
+            return &result->symbols[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Tells if two results hold the same image, symbols, references and messages.
+ * @param a The first result.
+ * @param b The second result.
+ * @return 1 if they are the same and 0 otherwise.
+ */
+static int sameResult(const AsmResult *a, const AsmResult *b) {
+    int i;
+
+    if (a->errors != b->errors || a->word_count != b->word_count || a->code_length != b->code_length ||
+        a->data_length != b->data_length || a->symbol_count != b->symbol_count ||
+        a->entry_count != b->entry_count || a->extern_count != b->extern_count ||
+        a->diagnostics_length != b->diagnostics_length) {
+        return 0;
+    }
+    if (memcmp(a->words, b->words, a->word_count * sizeof(unsigned short)) != 0 ||
+        memcmp(a->kinds, b->kinds, a->word_count) != 0 ||
+        memcmp(a->diagnostics, b->diagnostics, a->diagnostics_length) != 0) {
+        return 0;
+    }
+    for (i = 0; i < a->symbol_count; i++) {
+        if (strcmp(a->symbols[i].name, b->symbols[i].name) != 0 || a->symbols[i].address != b->symbols[i].address ||
+            a->symbols[i].flags != b->symbols[i].flags) {
+            return 0;
+        }
+    }
+    for (i = 0; i < a->extern_count; i++) {
+        if (strcmp(a->externs[i].name, b->externs[i].name) != 0 || a->externs[i].address != b->externs[i].address) {
+            return 0;
+        }
+    }
+    for (i = 0; i < a->entry_count; i++) {
+        if (strcmp(a->entries[i].name, b->entries[i].name) != 0 || a->entries[i].address != b->entries[i].address) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks the image of a source with data between its instructions.
+ * @param context The context.
+ */
+static void checkInterleaved(AssemblerContext *context) {
+    static const unsigned char kinds[] = {
+        ASM_WORD_CODE, ASM_WORD_CODE, ASM_WORD_CODE, ASM_WORD_DATA, ASM_WORD_DATA,
+        ASM_WORD_CODE, ASM_WORD_CODE, ASM_WORD_CODE
+    };
+    AsmResult result;
+    const AsmSymbol *symbol;
+
+    check(assemble(context, interleaved, &result) == 0, "interleaved: assembles");
+    check(result.word_count == 8, "interleaved: 8 words");
+    check(result.code_length == 6 && result.data_length == 2, "interleaved: 6 code and 2 data words");
+    if (result.word_count != 8) {
+        return;
+    }
+    check(memcmp(result.kinds, kinds, sizeof(kinds)) == 0, "interleaved: the words of V are data");
+    check(result.words[3] == 7 && result.words[4] == 8, "interleaved: V holds 7, 8 at 103 and 104");
+    check(result.words[7] == (15 << 11 | 4), "interleaved: stop is the last word");
+    symbol = findResultSymbol(&result, "V");
+    check(symbol != NULL && symbol->address == 103, "interleaved: V is at 103");
+    check(result.diagnostics_length == 0 && result.diagnostics[0] == '\0', "interleaved: no messages");
+}
+
+/**
+ * @brief Checks the symbols, entries and extern references of a source.
+ * @param context The context.
+ */
+static void checkLinked(AssemblerContext *context) {
+    AsmResult result;
+    const AsmSymbol *symbol;
+
+    check(assemble(context, linked, &result) == 0, "linked: assembles");
+    symbol = findResultSymbol(&result, "MAIN");
+    check(symbol != NULL && symbol->address == 100 &&
+          symbol->flags == (ASM_SYMBOL_DEFINED | ASM_SYMBOL_ENTRY), "linked: MAIN is a defined entry at 100");
+    symbol = findResultSymbol(&result, "X");
+    check(symbol != NULL && symbol->flags == ASM_SYMBOL_EXTERN, "linked: X is extern and not defined");
+    symbol = findResultSymbol(&result, "S");
+    check(symbol != NULL && symbol->address == 106 && symbol->flags == ASM_SYMBOL_DEFINED, "linked: S is at 106");
+    check(result.entry_count == 1 && strcmp(result.entries[0].name, "MAIN") == 0 &&
+          result.entries[0].address == 100, "linked: the entry is MAIN 100");
+    check(result.extern_count == 1 && strcmp(result.externs[0].name, "X") == 0 &&
+          result.externs[0].address == 101, "linked: the extern reference is X 101");
+    check(result.word_count > 1 && result.words[1] == 1, "linked: the word of X is external");
+    check(result.word_count > 3 && result.words[3] == (106 << 3 | 2), "linked: the word of S is relocatable");
+    check(result.word_count == 9 && result.kinds[5] == ASM_WORD_CODE && result.kinds[6] == ASM_WORD_DATA,
+          "linked: the string is data after stop");
+}
+
+/**
+ * @brief Checks the messages of a source with errors, and that the context recovers from it.
+ * @param context The context.
+ */
+static void checkDiagnostics(AssemblerContext *context) {
+    AsmResult result;
+
+    check(assemble(context, faulty, &result) == 1, "faulty: has errors");
+    check(result.errors == 1, "faulty: the result has errors");
+    check(strstr(result.diagnostics, "immediate value #5000 in line 1 is out of range") != NULL,
+          "faulty: the immediate is reported with its line");
+    check(strstr(result.diagnostics, "data value 99999 in line 2 is out of range") != NULL,
+          "faulty: the data value is reported with its line");
+    check((int)strlen(result.diagnostics) == result.diagnostics_length, "faulty: the messages are null terminated");
+
+    check(assemble(context, interleaved, &result) == 0 && result.diagnostics_length == 0,
+          "faulty: the next source of the context has no messages");
+}
+
+/**
+ * @brief Assembles a source many times with a context of its own and compares it with the expected result.
+ * @param argument The ThreadCheck of the thread.
+ * @return NULL.
+ */
+static void *assembleMany(void *argument) {
+    ThreadCheck *thread = (ThreadCheck *)argument;
+    AssemblerContext *context = createAssembler();
+    AsmResult result;
+    int i;
+
+    thread->failed_runs = 0;
+    if (context == NULL) {
+        thread->failed_runs = THREAD_RUNS;
+        return NULL;
+    }
+    for (i = 0; i < THREAD_RUNS; i++) {
+        assemble(context, thread->source, &result);
+        if (!sameResult(&result, thread->expected)) {
+            thread->failed_runs++;
+        }
+    }
+    destroyAssembler(context);
+    return NULL;
+}
+
+/**
+ * @brief Checks that two contexts assemble at the same time, each in its own thread.
+ */
+static void checkThreads(void) {
+    AssemblerContext *first = createAssembler();
+    AssemblerContext *second = createAssembler();
+    AsmResult first_result, second_result;
+    ThreadCheck threads[2];
+    pthread_t ids[2];
+    int i, started;
+
+    check(first != NULL && second != NULL, "threads: contexts are made");
+    if (first == NULL || second == NULL) {
+        destroyAssembler(first);
+        destroyAssembler(second);
+        return;
+    }
+    /* The expected results stay valid as long as their contexts assemble nothing else */
+    assemble(first, linked, &first_result);
+    assemble(second, faulty, &second_result);
+    threads[0].source = linked;
+    threads[0].expected = &first_result;
+    threads[1].source = faulty;
+    threads[1].expected = &second_result;
+
+    started = 0;
+    for (i = 0; i < 2; i++) {
+        if (pthread_create(&ids[i], NULL, assembleMany, &threads[i]) == 0) {
+            started++;
+        }
+    }
+    check(started == 2, "threads: two threads are started");
+    for (i = 0; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    if (started == 2) {
+        check(threads[0].failed_runs == 0, "threads: every run of the first thread is the same as alone");
+        check(threads[1].failed_runs == 0, "threads: every run of the second thread is the same as alone");
+    }
+    destroyAssembler(first);
+    destroyAssembler(second);
+}
+
+int main(void) {
+    AssemblerContext *context = createAssembler();
+
+    if (context == NULL) {
+        printf("FAIL: no memory for a context\n");
+        return 1;
+    }
+    checkInterleaved(context);
+    checkLinked(context);
+    checkDiagnostics(context);
+    destroyAssembler(context);
+    checkThreads();
+
+    printf("libassembler: %d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/* Sockets and getcwd are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/* What every request of the client shares */
+typedef struct {
+    int fd; /* The socket of the daemon */
+    int options; /* The REQUEST_* bits */
+    bool send_source; /* Read the files and send them, the outputs come back */
+    char directory[PATH_MAX];
+    Arena *arena; /* Reset for every file */
+} Client;
+
+/**
+ * @brief Receives the outputs of a source sent with its request, and writes them.
+ * @param client The client.
+ * @param count The number of outputs.
+ * @return 0 if succeded and 1 if the daemon is gone.
+ */
+static int receiveArtifacts(Client *client, int count) {
+    ArtifactHeader header;
+    char *name, *text;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (receiveAll(client->fd, &header, sizeof(header)) == 1 || header.name_length < 0 || header.length < 0) {
+            return 1;
+        }
+        name = (char *)arenaAlloc(client->arena, (size_t)header.name_length + 1);
+        text = (char *)arenaAlloc(client->arena, (size_t)header.length + 1);
+        if (receiveAll(client->fd, name, (size_t)header.name_length) == 1 ||
+            receiveAll(client->fd, text, (size_t)header.length) == 1) {
+            return 1;
+        }
+        name[header.name_length] = '\0';
+        writeTextFile(name, text, header.length);
+    }
+    return 0;
+}
+
+/**
+ * @brief Has the daemon assemble a file, and prints what it reports.
+ * @param client The client.
+ * @param file_name The name of the file, as given on the command line.
+ * @param result 0 if the batch goes on and 1 if it has to stop.
+ * @return 0 if succeded and 1 if the daemon is gone.
+ */
+static int requestFile(Client *client, const char *file_name, int *result) {
+    Request request;
+    Response response;
+    SourceFile source;
+    char *base_name, *text;
+
+    resetArena(client->arena);
+    memcpy(request.magic, REQUEST_MAGIC, 4);
+    request.options = client->options;
+    request.directory_length = (int)strlen(client->directory);
+    request.name_length = (int)strlen(file_name);
+    request.source_length = -1;
+    source.text = NULL;
+    source.mapped = false;
+    if (client->send_source) {
+        /* The file is found the way the assembler finds it */
+        base_name = baseName(file_name, client->arena);
+        if (openSource(&source, file_name, client->arena) == 1 &&
+            openSource(&source, outputName(client->arena, base_name, ".as"), client->arena) == 1) {
+            reportError("ERR: File does not exist");
+            *result = 0;
+            return 0;
+        }
+        request.source_length = source.length;
+    }
+
+    if (sendAll(client->fd, &request, sizeof(request)) == 1 ||
+        sendAll(client->fd, client->directory, (size_t)request.directory_length) == 1 ||
+        sendAll(client->fd, file_name, (size_t)request.name_length) == 1 ||
+        (source.text != NULL && sendAll(client->fd, source.text, (size_t)source.length) == 1)) {
+        closeSource(&source);
+        return 1;
+    }
+    closeSource(&source);
+
+    if (receiveAll(client->fd, &response, sizeof(response)) == 1 || memcmp(response.magic, RESPONSE_MAGIC, 4) != 0 ||
+        response.messages_length < 0 || response.errors_length < 0) {
+        return 1;
+    }
+    text = (char *)arenaAlloc(client->arena, (size_t)response.messages_length + response.errors_length + 1);
+    if (receiveAll(client->fd, text, (size_t)response.messages_length + response.errors_length) == 1) {
+        return 1;
+    }
+    fwrite(text + response.messages_length, 1, (size_t)response.errors_length, stderr);
+    fwrite(text, 1, (size_t)response.messages_length, stdout);
+    *result = response.result;
+    return receiveArtifacts(client, response.artifact_count);
+}
+
+/**
+ * @brief Assembles the files in this process, when there is no daemon to ask.
+ * @param files The names of the files.
+ * @param count The number of files.
+ * @param options The options of the command line.
+ * @return 0 if every file was assembled and 1 if the batch stopped.
+ */
+static int assembleHere(char **files, int count, const Options *options) {
+    Arena arena, library_arena;
+    LibraryCache libraries;
+    int i, result = 0;
+
+    initArena(&arena, ARENA_SIZE);
+    initArena(&library_arena, ARENA_SIZE);
+    initLibraryCache(&libraries, &library_arena, options->write_aml);
+    for (i = 0; i < count && result == 0; i++) {
+        result = assembleFile(files[i], NULL, options, &arena, &libraries);
+    }
+    freeLibraryCache(&libraries);
+    freeArena(&library_arena);
+    freeArena(&arena);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    Options options;
+    Client client;
+    Arena arena;
+    int i, result = 0;
+
+    options.write_am = false;
+    options.write_afp = false;
+    options.write_asp = false;
+    options.write_aml = false;
+    options.write_bo = false;
+    options.write_c = false;
+    options.jobs = 1;
+    options.cache = NULL;
+    options.batch_io = false;
+    client.send_source = false;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0) {
+            client.send_source = true;
+        } else if (parseOption(argv[i], &options) == 1) {
+            fprintf(stderr, "ERR: unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (i >= argc) {
+        fprintf(stderr, "Usage: %s [-am] [-afp] [-asp] [-aml] [-bo] [-c] [-i] [-s socket] <file1> [<file2> ...]\n",
+                argv[0]);
+        return 1;
+    }
+
+    client.fd = connectSocket(socketPath(path));
+    if (client.fd == -1 || getcwd(client.directory, sizeof(client.directory)) == NULL) {
+        return assembleHere(argv + i, argc - i, &options);
+    }
+    client.options = packOptions(&options);
+    initArena(&arena, ARENA_SIZE);
+    client.arena = &arena;
+
+    /* All the files go over one connection, one request at a time, in the order of the command line */
+    for (; i < argc && result == 0; i++) {
+        if (requestFile(&client, argv[i], &result) == 1) {
+            fprintf(stderr, "ERR: the daemon closed the connection\n");
+            result = 1;
+        }
+    }
+    fflush(stdout);
+    close(client.fd);
+    freeArena(&arena);
+    return result;
+}
@@ -0,0 +1,381 @@
+/* Sockets, poll, chdir and open_memstream are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/* Past this the libraries are dropped and loaded again, as replaced libraries stay in the arena */
+#define LIBRARY_ARENA_LIMIT (64 * 1024 * 1024)
+
+/* What is read of the request of a client, every client is read as its data comes */
+typedef struct {
+    int fd;
+    Request request;
+    size_t header_received;
+    bool in_body; /* The header is in, the directory, name and source are being received */
+    bool oversized; /* The request is over the limits, its body is dropped and it is answered with an error */
+    size_t body_length;
+    size_t body_received;
+    char *body; /* The directory and the name, null terminated, then the source */
+    size_t body_capacity;
+} Connection;
+
+/* What the daemon keeps warm between requests */
+typedef struct {
+    Arena arena; /* Reset for every file, it keeps the size of the largest one */
+    Arena library_arena;
+    LibraryCache libraries;
+    struct pollfd *polls; /* The listening socket, then the socket of every connection */
+    Connection *connections;
+    int connection_count;
+    int connection_capacity;
+} Server;
+
+/**
+ * @brief Sends the outputs captured for a source that came with its request.
+ * @param fd The socket.
+ * @param artifacts The outputs.
+ * @return 0 if succeded and 1 if the client is gone.
+ */
+static int sendArtifacts(int fd, const ArtifactList *artifacts) {
+    ArtifactHeader header;
+    int i;
+
+    for (i = 0; i < artifacts->count; i++) {
+        header.name_length = (int)strlen(artifacts->artifacts[i].name);
+        header.length = artifacts->artifacts[i].length;
+        if (sendAll(fd, &header, sizeof(header)) == 1 ||
+            sendAll(fd, artifacts->artifacts[i].name, (size_t)header.name_length) == 1 ||
+            sendAll(fd, artifacts->artifacts[i].text, (size_t)header.length) == 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Assembles the file of a request, the way the assembler does, and answers it.
+ *
+ * A file given by name is read and its outputs are written by the daemon,
+ * in the directory of the client. The outputs of a source sent with the
+ * request are sent back instead, but for the ".afp" table, which is always
+ * written where the client is.
+ *
+ * @param server The server.
+ * @param fd The socket of the client.
+ * @param request The request.
+ * @param directory The directory, name and source of the request.
+ * @return 0 if succeded and 1 if the client is gone.
+ */
+static int answerRequest(Server *server, int fd, const Request *request, const char *directory) {
+    const char *name = directory + request->directory_length + 1;
+    Options options;
+    SourceFile source;
+    ArtifactList artifacts;
+    Response response;
+    FILE *messages, *errors;
+    char *messages_text = NULL, *errors_text = NULL;
+    size_t messages_length = 0, errors_length = 0;
+    int failed;
+
+    unpackOptions(request->options, &options);
+    server->libraries.write_aml = options.write_aml;
+    expireLibraries(&server->libraries);
+    artifacts.artifacts = NULL;
+    artifacts.count = 0;
+    artifacts.capacity = 0;
+    artifacts.arena = &server->arena;
+
+    messages = open_memstream(&messages_text, &messages_length);
+    errors = open_memstream(&errors_text, &errors_length);
+    if (messages == NULL || errors == NULL) {
+        perror("ERR: Unable to allocate memory for the diagnostics");
+        exit(EXIT_FAILURE);
+    }
+    setDiagnostics(messages, errors);
+    if (chdir(directory) == -1) {
+        reportError("ERR: Failed to enter the directory of the client");
+        response.result = 1;
+    } else if (request->source_length == -1) {
+        response.result = assembleFile(name, NULL, &options, &server->arena, &server->libraries);
+    } else {
+        resetArena(&server->arena);
+        source.text = name + request->name_length + 1;
+        source.length = request->source_length;
+        source.mapped = false;
+        captureOutputs(&artifacts);
+        response.result = assembleText(&source, baseName(name, &server->arena), &options, &server->arena,
+                                       &server->libraries);
+        captureOutputs(NULL);
+    }
+    setDiagnostics(NULL, NULL);
+    fclose(messages);
+    fclose(errors);
+
+    memcpy(response.magic, RESPONSE_MAGIC, 4);
+    response.messages_length = (int)messages_length;
+    response.errors_length = (int)errors_length;
+    response.artifact_count = artifacts.count;
+    failed = sendAll(fd, &response, sizeof(response)) == 1 || sendAll(fd, messages_text, messages_length) == 1 ||
+             sendAll(fd, errors_text, errors_length) == 1 || sendArtifacts(fd, &artifacts) == 1;
+    free(messages_text);
+    free(errors_text);
+
+    if (server->library_arena.total_capacity > LIBRARY_ARENA_LIMIT) {
+        freeLibraryCache(&server->libraries);
+        resetArena(&server->library_arena);
+        initLibraryCache(&server->libraries, &server->library_arena, false);
+    }
+    return failed;
+}
+
+/**
+ * @brief Answers a request over the limits with an error, the way a missing file is answered.
+ * @param fd The socket of the client.
+ * @return 0 if succeded and 1 if the client is gone.
+ */
+static int refuseRequest(int fd) {
+    char message[128];
+    Response response;
+
+    sprintf(message, "ERR: the daemon takes names of up to %d bytes and sources of up to %d bytes\n",
+            REQUEST_NAME_LIMIT, REQUEST_SOURCE_LIMIT);
+    memcpy(response.magic, RESPONSE_MAGIC, 4);
+    response.result = 0;
+    response.messages_length = 0;
+    response.errors_length = (int)strlen(message);
+    response.artifact_count = 0;
+    return sendAll(fd, &response, sizeof(response)) == 1 || sendAll(fd, message, strlen(message)) == 1;
+}
+
+/**
+ * @brief Makes the reads and writes of a socket wait or not.
+ * @param fd The socket.
+ * @param blocking true to wait, false to return at once.
+ */
+static void setBlocking(int fd, bool blocking) {
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags != -1) {
+        fcntl(fd, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+    }
+}
+
+/**
+ * @brief Answers the request of a connection, once all of it is received.
+ *
+ * The answer is sent whole, so the socket waits while it is written.
+ *
+ * @param server The server.
+ * @param connection The connection.
+ * @return 0 if succeded and 1 if the client is gone.
+ */
+static int finishRequest(Server *server, Connection *connection) {
+    const Request *request = &connection->request;
+    int failed;
+
+    connection->in_body = false;
+    connection->header_received = 0;
+    setBlocking(connection->fd, true);
+    if (connection->oversized) {
+        failed = refuseRequest(connection->fd);
+    } else {
+        connection->body[request->directory_length] = '\0';
+        connection->body[request->directory_length + request->name_length + 1] = '\0';
+        failed = answerRequest(server, connection->fd, request, connection->body);
+    }
+    setBlocking(connection->fd, false);
+    return failed;
+}
+
+/**
+ * @brief Checks the header of a request and makes room for its body.
+ * @param server The server.
+ * @param connection The connection.
+ * @return 0 if succeded and 1 if the request is damaged or the client is gone.
+ */
+static int startBody(Server *server, Connection *connection) {
+    const Request *request = &connection->request;
+
+    if (memcmp(request->magic, REQUEST_MAGIC, 4) != 0 || request->directory_length < 0 ||
+        request->name_length < 0 || request->source_length < -1) {
+        fprintf(stderr, "ERR: a client sent a damaged request\n");
+        return 1;
+    }
+    connection->body_length = (size_t)request->directory_length + request->name_length +
+                              (request->source_length > 0 ? request->source_length : 0);
+    connection->body_received = 0;
+    connection->in_body = true;
+    /* A length from the socket is never allocated unchecked, a request over the limits is dropped */
+    connection->oversized = request->directory_length > REQUEST_NAME_LIMIT ||
+                            request->name_length > REQUEST_NAME_LIMIT || request->source_length > REQUEST_SOURCE_LIMIT;
+    if (!connection->oversized && connection->body_length + 3 > connection->body_capacity) {
+        free(connection->body);
+        connection->body = (char *)malloc(connection->body_length + 3);
+        if (connection->body == NULL) {
+            perror("ERR: Unable to allocate memory for a request");
+            exit(EXIT_FAILURE);
+        }
+        connection->body_capacity = connection->body_length + 3;
+    }
+    return connection->body_length == 0 ? finishRequest(server, connection) : 0;
+}
+
+/**
+ * @brief Reads what a client has sent, and answers its request once it is all in.
+ *
+ * Only what is already there is read, so a slow client holds up no other.
+ *
+ * @param server The server.
+ * @param connection The connection.
+ * @return 0 if succeded and 1 if the connection is to be closed.
+ */
+static int readConnection(Server *server, Connection *connection) {
+    static char dropped[4096];
+    size_t directory_length = (size_t)connection->request.directory_length;
+    size_t name_length = (size_t)connection->request.name_length;
+    size_t at = connection->body_received;
+    char *cursor;
+    size_t left;
+    ssize_t count;
+
+    if (!connection->in_body) {
+        cursor = (char *)&connection->request + connection->header_received;
+        left = sizeof(Request) - connection->header_received;
+    } else if (connection->oversized) {
+        cursor = dropped;
+        left = connection->body_length - at < sizeof(dropped) ? connection->body_length - at : sizeof(dropped);
+    } else if (at < directory_length) {
+        /* The directory and the name are kept null terminated, the source follows them */
+        cursor = connection->body + at;
+        left = directory_length - at;
+    } else if (at < directory_length + name_length) {
+        cursor = connection->body + at + 1;
+        left = directory_length + name_length - at;
+    } else {
+        cursor = connection->body + at + 2;
+        left = connection->body_length - at;
+    }
+
+    count = read(connection->fd, cursor, left);
+    if (count == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    if (count <= 0) {
+        return 1;
+    }
+    if (!connection->in_body) {
+        connection->header_received += (size_t)count;
+        return connection->header_received < sizeof(Request) ? 0 : startBody(server, connection);
+    }
+    connection->body_received += (size_t)count;
+    return connection->body_received < connection->body_length ? 0 : finishRequest(server, connection);
+}
+
+/**
+ * @brief Takes a new client, its socket is read without waiting.
+ * @param server The server.
+ * @param listener The listening socket.
+ */
+static void acceptClient(Server *server, int listener) {
+    Connection *connection;
+    int fd = accept(listener, NULL, NULL);
+
+    if (fd == -1) {
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("ERR: Unable to accept a client");
+        }
+        return;
+    }
+    if (server->connection_count == server->connection_capacity) {
+        server->connection_capacity *= 2;
+        server->connections = (Connection *)realloc(server->connections,
+                                                    server->connection_capacity * sizeof(Connection));
+        server->polls = (struct pollfd *)realloc(server->polls,
+                                                 (server->connection_capacity + 1) * sizeof(struct pollfd));
+        if (server->connections == NULL || server->polls == NULL) {
+            perror("ERR: Unable to allocate memory for a client");
+            exit(EXIT_FAILURE);
+        }
+    }
+    setBlocking(fd, false);
+    connection = &server->connections[server->connection_count];
+    memset(connection, 0, sizeof(*connection));
+    connection->fd = fd;
+    server->polls[server->connection_count + 1].fd = fd;
+    server->polls[server->connection_count + 1].events = POLLIN;
+    server->polls[server->connection_count + 1].revents = 0;
+    server->connection_count++;
+}
+
+/**
+ * @brief Closes a connection, the last one takes its place.
+ * @param server The server.
+ * @param index The index of the connection.
+ */
+static void closeConnection(Server *server, int index) {
+    close(server->connections[index].fd);
+    free(server->connections[index].body);
+    server->connection_count--;
+    server->connections[index] = server->connections[server->connection_count];
+    server->polls[index + 1] = server->polls[server->connection_count + 1];
+}
+
+int main(int argc, char **argv) {
+    const char *path;
+    Server server;
+    int listener, i;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [<socket>]\n", argv[0]);
+        return 1;
+    }
+    path = socketPath(argc == 2 ? argv[1] : NULL);
+
+    /* A client that goes away must not stop the daemon */
+    signal(SIGPIPE, SIG_IGN);
+    listener = listenSocket(path);
+    if (listener == -1) {
+        perror("ERR: Unable to listen on the socket");
+        return 1;
+    }
+
+    initArena(&server.arena, ARENA_SIZE);
+    initArena(&server.library_arena, ARENA_SIZE);
+    initLibraryCache(&server.libraries, &server.library_arena, false);
+    server.connection_count = 0;
+    server.connection_capacity = 16;
+    server.connections = (Connection *)malloc(server.connection_capacity * sizeof(Connection));
+    server.polls = (struct pollfd *)malloc((server.connection_capacity + 1) * sizeof(struct pollfd));
+    if (server.connections == NULL || server.polls == NULL) {
+        perror("ERR: Unable to allocate memory for the clients");
+        return 1;
+    }
+    server.polls[0].fd = listener;
+    server.polls[0].events = POLLIN;
+    initScanner();
+
+    /* Every client is served as its requests come, one request is assembled at a time */
+    for (;;) {
+        if (poll(server.polls, (nfds_t)server.connection_count + 1, -1) == -1) {
+            if (errno != EINTR) {
+                perror("ERR: Unable to wait for the clients");
+            }
+            continue;
+        }
+        /* From the last one down, so a closed connection is replaced by one already read */
+        for (i = server.connection_count - 1; i >= 0; i--) {
+            if (server.polls[i + 1].revents != 0 && readConnection(&server, &server.connections[i]) == 1) {
+                closeConnection(&server, i);
+            }
+        }
+        if (server.polls[0].revents & POLLIN) {
+            acceptClient(&server, listener);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <stdarg.h>
+#include "HEDER.h"
+
+/* Each thread assembles one file at a time, so each thread has its own streams */
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+static THREAD_LOCAL FILE *messages = NULL;
+static THREAD_LOCAL FILE *errors = NULL;
+static THREAD_LOCAL ArtifactList *outputs = NULL;
+
+/**
+ * @brief Sends the diagnostics of the calling thread to other streams.
+ *
+ * The parallel mode gives every file its own buffers, so the messages of a
+ * file are printed together and in the order of the command line.
+ *
+ * @param message_stream The stream of the ERR/WARN messages, or NULL for stdout.
+ * @param error_stream The stream of the system errors, or NULL for stderr.
+ */
+void setDiagnostics(FILE *message_stream, FILE *error_stream) {
+    messages = message_stream;
+    errors = error_stream;
+}
+
+/**
+ * @brief Prints a message about the source, the way printf does.
+ * @param format The format of the message.
+ */
+void report(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(messages ? messages : stdout, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Prints a message about a failed system call, the way perror does.
+ * @param message The message, followed by the description of errno.
+ */
+void reportError(const char *message) {
+    int error = errno;
+
+    fprintf(errors ? errors : stderr, "%s: %s\n", message, strerror(error));
+}
+
+/**
+ * @brief Gives the stream the messages of the calling thread go to.
+ * @return The stream set by setDiagnostics, or stdout.
+ */
+FILE *messageStream(void) {
+    return messages ? messages : stdout;
+}
+
+/**
+ * @brief Gives the stream the system errors of the calling thread go to.
+ * @return The stream set by setDiagnostics, or stderr.
+ */
+FILE *errorStream(void) {
+    return errors ? errors : stderr;
+}
+
+/**
+ * @brief Keeps the output files of the calling thread in memory instead of writing them.
+ *
+ * The daemon sends the outputs of a source it got over its socket back to
+ * the client, which writes them. The build cache stores them, and the
+ * batched I/O writes them many files at a time.
+ *
+ * @param list The list the files are added to, or NULL to write them again.
+ * @return The list the files were added to before, so it can be set back.
+ */
+ArtifactList *captureOutputs(ArtifactList *list) {
+    ArtifactList *previous = outputs;
+
+    outputs = list;
+    return previous;
+}
+
+/**
+ * @brief Adds an output file to the list of the calling thread, if it has one.
+ * @param name_of_file The name of the file.
+ * @param text The text of the file, copied into the arena of the list.
+ * @param length The length of the text.
+ * @return 1 if the file was captured and 0 if it has to be written.
+ */
+int captureOutput(const char *name_of_file, const char *text, int length) {
+    Artifact *artifact;
+    char *copy;
+
+    if (outputs == NULL) {
+        return 0;
+    }
+    if (outputs->count == outputs->capacity) {
+        outputs->artifacts = (Artifact *)arenaGrow(outputs->arena, outputs->artifacts,
+                                                   outputs->capacity * sizeof(Artifact),
+                                                   (outputs->capacity ? outputs->capacity * 2 : 8) * sizeof(Artifact));
+        outputs->capacity = outputs->capacity ? outputs->capacity * 2 : 8;
+    }
+    copy = (char *)arenaAlloc(outputs->arena, (size_t)length + 1);
+    memcpy(copy, text, (size_t)length);
+    copy[length] = '\0';
+    artifact = &outputs->artifacts[outputs->count++];
+    artifact->name = arenaString(outputs->arena, name_of_file, 0);
+    artifact->text = copy;
+    artifact->length = length;
+    return 1;
+}
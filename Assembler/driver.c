@@ -0,0 +1,106 @@
+#include "HEDER.h"
+
+/**
+ * @brief Reads an option of the command line.
+ * @param arg The argument, starting with '-'.
+ * @param options The options to update.
+ * @return 0 if the option is known and 1 otherwise.
+ */
+int parseOption(const char *arg, Options *options) {
+    if (strcmp(arg, "-am") == 0) {
+        options->write_am = true;
+    } else if (strcmp(arg, "-afp") == 0) {
+        options->write_afp = true;
+    } else if (strcmp(arg, "-asp") == 0) {
+        options->write_asp = true;
+    } else if (strcmp(arg, "-aml") == 0) {
+        options->write_aml = true;
+    } else if (strcmp(arg, "-bo") == 0) {
+        options->write_bo = true;
+    } else if (strcmp(arg, "-c") == 0) {
+        options->write_c = true;
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives the name of a source without its ".as" extension, the outputs are named after it.
+ * @param file_name The name of the file, as given on the command line.
+ * @param arena The per-file arena.
+ * @return The name, allocated from the arena.
+ */
+char *baseName(const char *file_name, Arena *arena) {
+    char *base_name = arenaString(arena, file_name, 0);
+    char *dot_pos = strrchr(base_name, '.');
+
+    if (dot_pos && strcmp(dot_pos, ".as") == 0) {
+        *dot_pos = '\0';
+    }
+    return base_name;
+}
+
+/**
+ * @brief Assembles a source that is already in memory, from the macro process to the outputs.
+ * @param source The source, it is closed once the macros are expanded.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The options of the command line.
+ * @param arena The per-file arena.
+ * @param libraries The macro libraries of the worker.
+ * @return 0 if the batch goes on (even if the file had errors) and 1 if it has to stop.
+ */
+int assembleText(SourceFile *source, const char *base_name, const Options *options, Arena *arena,
+                 LibraryCache *libraries) {
+    Span expanded;
+
+    if (preAss(source, libraries, arena, &expanded) == 1) {
+        closeSource(source);
+        report("ERR:Error at macro processing\n");
+        return 0;
+    }
+    closeSource(source);
+    if (options->write_am &&
+        writeTextFile(outputName(arena, base_name, ".am"), expanded.start, expanded.length) == 1) {
+        report("ERR:Error at macro processing\n");
+        return 1;
+    }
+
+    if (firstPass(expanded, base_name, options, arena) == 1) {
+        report("ERR:Error at first pass processing\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Assembles one file, from its source to its outputs.
+ * @param file_name The name of the file, as given on the command line.
+ * @param input The source if it was already read, or NULL to open the file.
+ * @param options The options of the command line.
+ * @param arena The arena of the worker, reset for the file.
+ * @param libraries The macro libraries of the worker.
+ * @return 0 if the batch goes on (even if the file had errors) and 1 if it has to stop.
+ */
+int assembleFile(const char *file_name, SourceFile *input, const Options *options, Arena *arena,
+                 LibraryCache *libraries) {
+    char *base_name;
+    SourceFile source;
+
+    resetArena(arena);
+    base_name = baseName(file_name, arena);
+
+    /* The source is mapped as given, or with ".as" added, and never modified */
+    if (input != NULL) {
+        source = *input;
+    } else if (openSource(&source, file_name, arena) == 1 &&
+               openSource(&source, outputName(arena, base_name, ".as"), arena) == 1) {
+        reportError("ERR: File does not exist");
+        return 0;
+    }
+    /* The ".afp" table is written as the passes go, so it can't come from the cache */
+    if (options->cache != NULL && !options->write_afp) {
+        return assembleCached(&source, file_name, base_name, options, arena, libraries);
+    }
+    return assembleText(&source, base_name, options, arena, libraries);
+}
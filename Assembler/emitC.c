@@ -0,0 +1,475 @@
+#include <stdarg.h>
+#include "HEDER.h"
+
+/* The opcodes, by value */
+enum {
+    OP_MOV, OP_CMP, OP_ADD, OP_SUB, OP_LEA, OP_CLR, OP_NOT, OP_INC,
+    OP_DEC, OP_JMP, OP_BNE, OP_RED, OP_PRN, OP_JSR, OP_RTS, OP_STOP
+};
+
+/* The method of the 4 method bits of a first word field, -1 for no operand and -2 if more than one is set */
+static const signed char field_methods[16] = {
+    -1, IMMEDIATE, DIRECT, -2, INDIRECT_REGISTER, -2, -2, -2,
+    DIRECT_REGISTER, -2, -2, -2, -2, -2, -2, -2
+};
+
+/* What the translated program starts with, the machine of the simulator and its I/O, line by line */
+static const char *const c_prologue[] = {
+    "#include <stdio.h>",
+    "#include <stdlib.h>",
+    "#include <string.h>",
+    "",
+    "#define MEMORY_SIZE 4096",
+    "#define STACK_SIZE 1024",
+    "",
+    "static unsigned short m[MEMORY_SIZE];",
+    "static int numbers; /* prn prints decimal numbers, with -d */",
+    "",
+    "static void fault(const char *format, int address) {",
+    "    fflush(stdout);",
+    "    fprintf(stderr, format, address);",
+    "    exit(1);",
+    "}",
+    "",
+    "static unsigned red(void) {",
+    "    int c = getchar();",
+    "    return c == EOF ? 0x7FFF : (unsigned)c;",
+    "}",
+    "",
+    "static void prn(unsigned value) {",
+    "    if (numbers) {",
+    "        printf(\"%d\\n\", value & 0x4000 ? (int)value - 0x8000 : (int)value);",
+    "    } else {",
+    "        putchar((int)(value & 0xFF));",
+    "    }",
+    "}",
+    "",
+    NULL
+};
+
+/* The start of main, before the instructions, the image is copied to MIN_MEM_VAL after it */
+static const char *const c_main[] = {
+    "int main(int argc, char **argv) {",
+    "    unsigned short r[8] = {0, 0, 0, 0, 0, 0, 0, 0};",
+    "    unsigned short stack[STACK_SIZE];",
+    "    unsigned t, a;",
+    "    int z = 0, depth = 0, pc = 0;",
+    "",
+    "    (void)t, (void)a, (void)z, (void)depth, (void)pc, (void)stack, (void)red, (void)prn;",
+    "    numbers = argc > 1 && strcmp(argv[1], \"-d\") == 0;",
+    NULL
+};
+
+/* The text of the operands of an instruction, as C expressions */
+typedef struct {
+    char source[64];
+    char destination[64]; /* A value that can be assigned to */
+    int target; /* The address jmp, bne and jsr go to, -1 if it is in a register */
+    char target_register[32];
+    bool external; /* An operand is an extern label */
+} COperands;
+
+/**
+ * @brief Appends formatted text to a buffer, the way printf does.
+ * @param buffer The text buffer.
+ * @param format The format, what it prints is shorter than 256 characters.
+ */
+static void appendFormat(TextBuffer *buffer, const char *format, ...) {
+    char text[256];
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsprintf(text, format, args);
+    va_end(args);
+    appendText(buffer, text, length);
+}
+
+/**
+ * @brief Appends a null terminated text to a buffer.
+ * @param buffer The text buffer.
+ * @param text The text.
+ */
+static void appendString(TextBuffer *buffer, const char *text) {
+    appendText(buffer, text, (int)strlen(text));
+}
+
+/**
+ * @brief Appends lines to a buffer.
+ * @param buffer The text buffer.
+ * @param lines The lines, without their newlines, NULL after the last.
+ */
+static void appendLines(TextBuffer *buffer, const char *const *lines) {
+    for (; *lines != NULL; lines++) {
+        appendString(buffer, *lines);
+        appendString(buffer, "\n");
+    }
+}
+
+/**
+ * @brief Gives an operand as a C expression, the way the simulator reads the word it was encoded into.
+ * @param program The program.
+ * @param method The addressing method.
+ * @param value The decoded operand: a number, a register number or a symbol id.
+ * @param address The instruction takes the address of the operand, not its value.
+ * @param text The expression.
+ * @return The address of a label operand, -1 if the operand is not a label and -2 if it is extern.
+ */
+static int operandExpression(Program *program, int method, int value, bool address, char *text) {
+    int word, label;
+
+    if (method == IMMEDIATE) {
+        /* 12 bits in the word, extended to the 15 of the machine */
+        word = ((value << 3) & 0x7FFF) >> 3;
+        sprintf(text, "0x%04X", word & 0x800 ? word | 0x7000 : word);
+        return -1;
+    }
+    if (method == DIRECT) {
+        if (program->symbols.symbols[value].flags & SYMBOL_EXTERN) {
+            return -2;
+        }
+        label = findLabelAddress(&program->symbols, value) >> 3;
+        sprintf(text, address ? "%d" : "m[%d]", label);
+        return label;
+    }
+    if (method == INDIRECT_REGISTER) {
+        sprintf(text, address ? "(r[%d] & 0xFFF)" : "m[r[%d] & 0xFFF]", value);
+    } else {
+        sprintf(text, "r[%d]", value);
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads the operands of an instruction line into C expressions.
+ * @param program The program.
+ * @param index The line.
+ * @param operands The expressions.
+ */
+static void readOperands(Program *program, int index, COperands *operands) {
+    LineTable *lines = &program->lines;
+    int opcode = lines->opcode_value[index];
+    bool jump = opcode == OP_JMP || opcode == OP_BNE || opcode == OP_JSR;
+    int label;
+
+    operands->source[0] = '\0';
+    operands->destination[0] = '\0';
+    operands->target = -1;
+    operands->external = false;
+    if (lines->source_method[index] != -1) {
+        label = operandExpression(program, lines->source_method[index], lines->source_value[index],
+                                  opcode == OP_LEA, operands->source);
+        operands->external |= label == -2;
+    }
+    if (lines->destination_method[index] != -1) {
+        label = operandExpression(program, lines->destination_method[index], lines->destination_value[index],
+                                  jump, operands->destination);
+        operands->external |= label == -2;
+        if (jump) {
+            operands->target = label;
+            strcpy(operands->target_register, operands->destination);
+        }
+    }
+}
+
+/**
+ * @brief Appends the end of the run when it reaches an address no instruction starts at.
+ *
+ * The simulator decodes the word there, which is data or an unused word, and
+ * the translation ends with the same fault. A data word that happens to be
+ * the first word of an instruction would be run by the simulator, but it was
+ * not translated, so the translation ends with a fault of its own.
+ *
+ * @param text The text of the program.
+ * @param object The object of the program.
+ * @param address The address.
+ */
+static void appendNotCode(TextBuffer *text, const ObjectImage *object, int address) {
+    int word = address - MIN_MEM_VAL < object->ic + object->dc ? object->words[address - MIN_MEM_VAL] & 0x7FFF : 0;
+    int source = field_methods[(word >> 7) & 0xF];
+    int destination = field_methods[(word >> 3) & 0xF];
+    InstructionForm form;
+
+    if (address >= MEMORY_SIZE) {
+        appendFormat(text, "fault(\"ERR: the program ran on to address %%d, past the end of memory\\n\", %d);",
+                     address);
+        return;
+    }
+    if (source != -2 && destination != -2) {
+        form = getInstructionForm(word >> 11, source, destination);
+        if (form.legal && form.first_word == word) {
+            appendFormat(text, "fault(\"ERR: the data at address %%d was not translated to be run\\n\", %d);",
+                         address);
+            return;
+        }
+    }
+    appendFormat(text, "fault(\"ERR: the word at address %%d is not an instruction\\n\", %d);", address);
+}
+
+/**
+ * @brief Appends a jump to an address: a goto if an instruction starts there, through the dispatch otherwise.
+ * @param text The text of the program.
+ * @param object The object of the program.
+ * @param operands The operands of the jump.
+ * @param starts Tells for every address if an instruction starts there.
+ */
+static void appendJump(TextBuffer *text, const ObjectImage *object, const COperands *operands, const bool *starts) {
+    if (operands->target < 0) {
+        appendFormat(text, "pc = %s; goto dispatch;", operands->target_register);
+    } else if (starts[operands->target]) {
+        appendFormat(text, "goto L%d;", operands->target);
+    } else {
+        appendNotCode(text, object, operands->target);
+    }
+}
+
+/**
+ * @brief Appends the write of the value in t to the destination of an instruction.
+ *
+ * The code was compiled ahead of time, so a write to a word of an instruction
+ * ends the program instead of changing it. The data may be between the
+ * instructions, so a write through a register is checked against the
+ * code_words table of the translation.
+ *
+ * @param text The text of the program.
+ * @param program The program.
+ * @param index The line.
+ * @param operands The operands.
+ * @param code_words Tells for every address if it is a word of an instruction.
+ */
+static void appendStore(TextBuffer *text, Program *program, int index, const COperands *operands,
+                        const bool *code_words) {
+    LineTable *lines = &program->lines;
+    int method = lines->destination_method[index];
+    int value = lines->destination_value[index];
+    int address = lines->memory_value[index];
+    int label;
+
+    if (method == INDIRECT_REGISTER) {
+        appendFormat(text, "a = r[%d] & 0xFFF;\n    if (a < sizeof(code_words) && code_words[a]) {\n        ",
+                     value);
+        appendFormat(text, "fault(\"ERR: the instruction at address %%d writes to the code\\n\", %d);\n    }\n",
+                     address);
+        appendString(text, "    m[a] = (unsigned short)t;");
+        return;
+    }
+    if (method == DIRECT) {
+        label = findLabelAddress(&program->symbols, value) >> 3;
+        if (code_words[label]) {
+            appendFormat(text, "fault(\"ERR: the instruction at address %%d writes to the code\\n\", %d);",
+                         address);
+            return;
+        }
+    }
+    appendFormat(text, "%s = (unsigned short)t;", operands->destination);
+}
+
+/**
+ * @brief Appends the C of one instruction.
+ * @param text The text of the program.
+ * @param program The program.
+ * @param index The line.
+ * @param object The object of the program.
+ * @param starts Tells for every address if an instruction starts there.
+ * @param code_words Tells for every address if it is a word of an instruction.
+ */
+static void appendInstruction(TextBuffer *text, Program *program, int index, const ObjectImage *object,
+                              const bool *starts, const bool *code_words) {
+    LineTable *lines = &program->lines;
+    int opcode = lines->opcode_value[index];
+    int address = lines->memory_value[index];
+    int next = address + lines->memory_cells[index];
+    COperands operands;
+
+    readOperands(program, index, &operands);
+    if (operands.external) {
+        appendFormat(text, "    fault(\"ERR: the instruction at address %%d refers to an extern label\\n\", %d);\n",
+                     address);
+        return;
+    }
+    appendString(text, "    ");
+    switch (opcode) {
+    case OP_MOV:
+    case OP_LEA:
+        appendFormat(text, "t = %s;\n    ", operands.source);
+        appendStore(text, program, index, &operands, code_words);
+        break;
+    case OP_CMP:
+        appendFormat(text, "z = %s == %s;", operands.destination, operands.source);
+        break;
+    case OP_ADD:
+    case OP_SUB:
+        appendFormat(text, "t = (%s %c %s) & 0x7FFF;\n    z = t == 0;\n    ", operands.destination,
+                     opcode == OP_ADD ? '+' : '-', operands.source);
+        appendStore(text, program, index, &operands, code_words);
+        break;
+    case OP_CLR:
+        appendString(text, "t = 0;\n    z = 1;\n    ");
+        appendStore(text, program, index, &operands, code_words);
+        break;
+    case OP_NOT:
+    case OP_INC:
+    case OP_DEC:
+        appendFormat(text, opcode == OP_NOT ? "t = ~%s & 0x7FFF;\n" : "t = (%s %s 1) & 0x7FFF;\n",
+                     operands.destination, opcode == OP_INC ? "+" : "-");
+        appendString(text, "    z = t == 0;\n    ");
+        appendStore(text, program, index, &operands, code_words);
+        break;
+    case OP_JMP:
+        appendJump(text, object, &operands, starts);
+        break;
+    case OP_BNE:
+        appendString(text, "if (!z) {\n        ");
+        appendJump(text, object, &operands, starts);
+        appendString(text, "\n    }");
+        break;
+    case OP_RED:
+        appendString(text, "t = red();\n    ");
+        appendStore(text, program, index, &operands, code_words);
+        break;
+    case OP_PRN:
+        appendFormat(text, "prn(%s);", operands.destination);
+        break;
+    case OP_JSR:
+        appendString(text, "if (depth == STACK_SIZE) {\n        ");
+        appendFormat(text, "fault(\"ERR: jsr at address %%d overflows the stack of return addresses\\n\", %d);\n",
+                     address);
+        appendFormat(text, "    }\n    stack[depth++] = %d;\n    ", next);
+        appendJump(text, object, &operands, starts);
+        break;
+    case OP_RTS:
+        appendString(text, "if (depth == 0) {\n        ");
+        appendFormat(text, "fault(\"ERR: rts at address %%d has no address to return to\\n\", %d);\n", address);
+        appendString(text, "    }\n    pc = stack[--depth];\n    goto dispatch;");
+        break;
+    default:
+        appendString(text, "return 0;");
+    }
+    appendString(text, "\n");
+    /* Where the next word is not an instruction the simulator faults on it */
+    if (opcode != OP_JMP && opcode != OP_JSR && opcode != OP_RTS && opcode != OP_STOP &&
+        (next >= MEMORY_SIZE || !starts[next])) {
+        appendString(text, "    ");
+        appendNotCode(text, object, next);
+        appendString(text, "\n");
+    }
+}
+
+/**
+ * @brief Generates a C translation unit that runs the program the way the simulator does (.c).
+ *
+ * Every instruction becomes a few lines of C, under a label that jumps go to.
+ * Jumps to an address that is only known when they run (rts and jmp *r) go
+ * through a switch over the addresses of the instructions. The memory starts
+ * as the words of the object, red and prn read and print through stdio.
+ *
+ * @param program The lines, symbols and data of the file after the first pass.
+ * @param object The object of the program, without errors.
+ * @param base_name The name of the source without its ".as" extension.
+ * @return 0 if succeded and 1 otherwise.
+ */
+int makeC(Program *program, const ObjectImage *object, const char *base_name) {
+    LineTable *lines = &program->lines;
+    int count = object->ic + object->dc;
+    int code_limit = 0; /* The address after the last word of an instruction */
+    bool dynamic = false, stores_through_registers = false;
+    bool *starts, *targets, *code_words;
+    COperands operands;
+    TextBuffer text;
+    int i, k, opcode;
+
+    if (count > MEMORY_SIZE - MIN_MEM_VAL) {
+        report("ERR: the program takes %d words and the memory holds %d\n", count, MEMORY_SIZE - MIN_MEM_VAL);
+        return 1;
+    }
+    starts = (bool *)arenaAlloc(program->arena, MEMORY_SIZE * sizeof(bool));
+    targets = (bool *)arenaAlloc(program->arena, MEMORY_SIZE * sizeof(bool));
+    code_words = (bool *)arenaAlloc(program->arena, MEMORY_SIZE * sizeof(bool));
+    memset(starts, 0, MEMORY_SIZE * sizeof(bool));
+    memset(targets, 0, MEMORY_SIZE * sizeof(bool));
+    memset(code_words, 0, MEMORY_SIZE * sizeof(bool));
+    /* The data is laid out in source order, so it may be between the instructions */
+    for (i = 0; i < lines->count; i++) {
+        opcode = lines->opcode_value[i];
+        if (opcode == -1) {
+            continue;
+        }
+        starts[lines->memory_value[i]] = true;
+        for (k = 0; k < lines->memory_cells[i]; k++) {
+            code_words[lines->memory_value[i] + k] = true;
+        }
+        code_limit = lines->memory_value[i] + lines->memory_cells[i];
+        if (lines->destination_method[i] == INDIRECT_REGISTER && opcode != OP_CMP && opcode != OP_PRN &&
+            opcode != OP_JMP && opcode != OP_BNE && opcode != OP_JSR) {
+            stores_through_registers = true;
+        }
+    }
+    /* Only the addresses that are jumped to get a label, so the C has no label that is not used */
+    for (i = 0; i < lines->count; i++) {
+        opcode = lines->opcode_value[i];
+        if (opcode == OP_RTS) {
+            dynamic = true;
+        } else if (opcode == OP_JMP || opcode == OP_BNE || opcode == OP_JSR) {
+            readOperands(program, i, &operands);
+            if (operands.target < 0 && !operands.external) {
+                dynamic = true;
+            } else if (operands.target >= 0 && starts[operands.target]) {
+                targets[operands.target] = true;
+            }
+        }
+    }
+    if (dynamic) {
+        memcpy(targets, starts, MEMORY_SIZE * sizeof(bool));
+    }
+
+    text.chars = NULL;
+    text.length = 0;
+    text.capacity = 0;
+    text.arena = program->arena;
+    appendFormat(&text, "/* %s.c, made by the assembler, runs like ./simulator [-d] %s */\n", base_name, base_name);
+    appendLines(&text, c_prologue);
+    appendFormat(&text, "static const unsigned short image[%d] = {", count > 0 ? count : 1);
+    for (i = 0; i < count; i++) {
+        appendFormat(&text, i % 8 == 0 ? "\n    0x%04X," : " 0x%04X,", object->words[i]);
+    }
+    appendString(&text, count > 0 ? "\n};\n\n" : " 0\n};\n\n");
+    if (stores_through_registers) {
+        appendString(&text, "/* The words of the instructions, a write to them ends the run */\n");
+        appendFormat(&text, "static const unsigned char code_words[%d] = {", code_limit);
+        for (i = 0; i < code_limit; i++) {
+            appendFormat(&text, i % 32 == 0 ? "\n    %d," : " %d,", code_words[i]);
+        }
+        appendString(&text, "\n};\n\n");
+    }
+    appendLines(&text, c_main);
+    appendFormat(&text, "    memcpy(m + %d, image, sizeof(image));\n\n", MIN_MEM_VAL);
+    if (!starts[MIN_MEM_VAL]) {
+        appendString(&text, "    ");
+        appendNotCode(&text, object, MIN_MEM_VAL);
+        appendString(&text, "\n");
+    }
+
+    for (i = 0; i < lines->count; i++) {
+        if (lines->opcode_value[i] == -1) {
+            continue;
+        }
+        if (targets[lines->memory_value[i]]) {
+            appendFormat(&text, "L%d:\n", lines->memory_value[i]);
+        }
+        appendFormat(&text, "    /* %d: %s */\n", lines->memory_value[i], getOpcodeName(lines->opcode_value[i]));
+        appendInstruction(&text, program, i, object, starts, code_words);
+    }
+
+    if (dynamic) {
+        appendString(&text, "dispatch:\n    switch (pc) {\n");
+        for (i = 0; i < MEMORY_SIZE; i++) {
+            if (starts[i]) {
+                appendFormat(&text, "    case %d: goto L%d;\n", i, i);
+            }
+        }
+        appendString(&text, "    }\n");
+        appendString(&text, "    fault(\"ERR: the word at address %d is not an instruction\\n\", pc);\n");
+    }
+    appendString(&text, "    return 1;\n}\n");
+    return writeTextFile(outputName(program->arena, base_name, ".c"), text.chars, text.length);
+}
@@ -4,133 +4,111 @@
 #include "HEDER.h"
 
 /**
- * @brief Initializes a LineInfo struct with default values.
+ * @brief Parses a decimal number with an optional '+' or '-' sign.
  *
- * This function sets default values for all fields in a LineInfo struct.
- * String fields are initialized to empty strings, integer and boolean fields 
- * are initialized to zero or false, and certain fields are set to specific 
- * default values, such as `-1` for invalid or uninitialized states.
+ * A number too long for any word stops growing past MAX_DATA + 1, so it
+ * can't overflow an int and is still out of every range the callers check.
  *
- * @param lineInfo A pointer to the `LineInfo` structure to be initialized.
+ * @param text The view of the number, without surrounding blanks.
+ * @param value A pointer to where the value is stored if the text is valid.
+ * @return 1 if the text is a valid number, otherwise 0.
  */
-void initializeLineInfo(LineInfo *lineInfo) {
-    /* Set all string fields to empty strings */
-    strcpy(lineInfo->label_name, "");
-    strcpy(lineInfo->opcode_name, "");
-    strcpy(lineInfo->source_method_value, "");
-    strcpy(lineInfo->destination_method_value, "");
-    strcpy(lineInfo->data_string_value, "");
-
-    /* Initialize all integer and boolean fields to zero or false */
-    lineInfo->source_method = -1;
-    lineInfo->destination_method = -1;
-    lineInfo->memory_cells = 0;
-    lineInfo->memory_value = 100;
-    lineInfo->opcode_value = -1; /* Invalid value as default */
-    lineInfo->is_data = false;
-    lineInfo->is_string = false;
-    lineInfo->is_entry = false;
-    lineInfo->is_extern = false;
-    lineInfo->count_op = -1;
-    lineInfo->flag = 0;
-}
-
-/**
- * @brief Maps an opcode name to its corresponding numeric value.
- *
- * This function takes an opcode name as a string and returns the corresponding numeric value.
- * It checks the opcode name against a list of known opcodes and returns the appropriate value.
- * If the opcode name is not recognized, the function returns -1.
- *
- * @param opcode_name A string representing the name of the opcode.
- * @return The numeric value of the opcode if found, otherwise -1 for an invalid opcode.
- */
-int getOpcodeValue(char *opcode_name) {
-    if (strcmp(opcode_name, "mov") == 0) return 0;
-    if (strcmp(opcode_name, "cmp") == 0) return 1;
-    if (strcmp(opcode_name, "add") == 0) return 2;
-    if (strcmp(opcode_name, "sub") == 0) return 3;
-    if (strcmp(opcode_name, "lea") == 0) return 4;
-    if (strcmp(opcode_name, "clr") == 0) return 5;
-    if (strcmp(opcode_name, "not") == 0) return 6;
-    if (strcmp(opcode_name, "inc") == 0) return 7;
-    if (strcmp(opcode_name, "dec") == 0) return 8;
-    if (strcmp(opcode_name, "jmp") == 0) return 9;
-    if (strcmp(opcode_name, "bne") == 0) return 10;
-    if (strcmp(opcode_name, "red") == 0) return 11;
-    if (strcmp(opcode_name, "prn") == 0) return 12;
-    if (strcmp(opcode_name, "jsr") == 0) return 13;
-    if (strcmp(opcode_name, "rts") == 0) return 14;
-    if (strcmp(opcode_name, "stop") == 0) return 15;
-    return -1; /* Invalid opcode */
-}
-
-/**
- * @brief Calculates the number of data elements in a comma-separated string.
- *
- * This function takes a comma-separated string and counts the number of data elements 
- * by counting the commas and adding one. It returns the total number of elements found.
- *
- * @param str A string containing comma-separated values.
- * @return The number of data elements in the string.
- */
-int calcData(char *str){
-    int count = 1;
-    while (*str) {
-        if (*str == ',') {
-            count++;
+int parseNumber(Span text, int *value) {
+    const char *digits = text.start;
+    const char *end = text.start + text.length;
+    int number = 0;
+    int negative = 0;
+
+    if (digits < end && (*digits == '+' || *digits == '-')) {
+        negative = (*digits == '-');
+        digits++;
+    }
+    if (digits == end) {
+        return 0;
+    }
+    while (digits < end) {
+        if (!isdigit((unsigned char)*digits)) {
+            return 0;
+        }
+        if (number <= MAX_DATA) {
+            number = number * 10 + (*digits - '0');
         }
-        str++;
+        digits++;
     }
-    return count;
+    *value = negative ? -number : number;
+    return 1;
 }
 
 /**
- * @brief Calculates the length of a string including the null terminator.
+ * @brief Splits the values of a `.data` statement and adds them to the data pool.
  *
- * This function takes a string and counts the number of characters, including the null terminator.
- * It starts counting from 1 to account for the null terminator at the end of the string.
+ * This function takes the comma-separated text of the statement, checks that every
+ * value is a valid number and stores the values in the data pool, so the second
+ * pass only copies them.
  *
- * @param str A pointer to the string whose length is to be calculated.
- * @return The length of the string including the null terminator.
+ * @param scan The scan of the text of the line.
+ * @param text The view of the comma-separated values.
+ * @param program The program that owns the line and the data pool.
+ * @param index The index of the statement line, the range of its values is stored in it.
+ * @return The number of values added.
  */
-int calcString(char *str){
-    int count = 1; /*we start at 1 becuse the null line at the end of the string*/
-    while (*str != '\0') {
-        count++;
-        str++;
+int parseData(const Scan *scan, Span text, Program *program, int index) {
+    const char *start = text.start;
+    const char *end = text.start + text.length;
+    const char *comma;
+    Span value_text;
+    int value;
+
+    program->lines.info[index].data_start = program->data.count;
+    while (1) {
+        value_text.start = start;
+        value_text.length = (int)(end - start);
+        comma = findDelimiter(scan, value_text, COMMAS);
+        value_text.length = (int)((comma ? comma : end) - start);
+        value_text = trimSpan(scan, value_text);
+
+        if (!parseNumber(value_text, &value)) {
+            report("ERR: '%.*s' is not a valid data value\n", value_text.length, value_text.start);
+            program->lines.info[index].flag = true;
+            value = 0;
+        } else if (value < MIN_DATA || value > MAX_DATA) {
+            report("ERR: the data value %.*s in line %d is out of range (%d to %d)\n", value_text.length,
+                   value_text.start, index + 1, MIN_DATA, MAX_DATA);
+            program->lines.info[index].flag = true;
+            value = 0;
+        }
+        addDataValue(program, value);
+
+        if (comma == NULL) {
+            break;
+        }
+        start = comma + 1;
     }
-    return count;
+    return program->data.count - program->lines.info[index].data_start;
 }
 
 /**
  * @brief Calculates the number of memory cells required by a given line of code.
  *
  * This function determines the number of memory cells used by a line based on its type.
- * It accounts for data lines, string lines, and operation lines, adjusting the count 
- * based on the addressing methods used. For data lines, it delegates to `calcData`, and 
- * for string lines, it delegates to `calcString`.
+ * It accounts for data lines, string lines, and operation lines, taking the count of an
+ * operation line from the opcode table by its addressing methods. Data and string lines
+ * take one cell for each word they added to the data pool.
  *
- * @param lineInfo A pointer to a `LineInfo` structure containing information about the line.
+ * @param program The program that owns the line.
+ * @param index The index of the line.
+ * @param data_count The number of words the line added to the data pool.
  * @return The number of memory cells required by the line.
  */
-int calculateMemoryCells(LineInfo *lineInfo) {
-    if (lineInfo->is_data){
-        return calcData(lineInfo->data_string_value);
-    }else if (lineInfo->is_string) {
-        return calcString(lineInfo->data_string_value);
+int calculateMemoryCells(Program *program, int index, int data_count) {
+    LineTable *lines = &program->lines;
+
+    if (lines->info[index].is_data || lines->info[index].is_string){
+        return data_count;
     }
-    else if(!lineInfo->is_extern && !lineInfo->is_entry){
-        if (lineInfo->source_method == -1 && lineInfo->destination_method == -1){
-            return 1;
-        }else if (lineInfo->source_method == -1){
-            return 2;
-        }else if ((lineInfo->destination_method == DIRECT_REGISTER || lineInfo->destination_method == INDIRECT_REGISTER) &&
-                (lineInfo->source_method == DIRECT_REGISTER || lineInfo->source_method == INDIRECT_REGISTER)){
-            return 2;
-        }else{
-            return 3;
-        }
+    else if (lines->opcode_value[index] != -1) {
+        return getInstructionForm(lines->opcode_value[index], lines->source_method[index],
+                                  lines->destination_method[index]).words;
     }
     return 0; /* Return a default value in case none of the conditions are met */
 }
@@ -142,27 +120,27 @@ int calculateMemoryCells(LineInfo *lineInfo) {
  *
  */
 
-int badLabel(char *token) {
+int badLabel(Span token) {
     int i;
     const char *registers[] = {"r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7"};        
     /* Check if the first character is an English letter */
-    if (!isalpha(token[0])) {
-        printf("Invalid label: %s (must start with a letter)\n", token);
+    if (token.length == 0 || !isalpha((unsigned char)token.start[0])) {
+        report("Invalid label: %.*s (must start with a letter)\n", token.length, token.start);
         return 1;
     }
 
     /* Check if the remaining characters are letters or digits */
-    for (i = 1; token[i] != '\0'; i++) {
-        if (!isalnum(token[i])) {
-            printf("Invalid label: %s (must contain only letters and digits)\n", token);
+    for (i = 1; i < token.length; i++) {
+        if (!isalnum((unsigned char)token.start[i])) {
+            report("Invalid label: %.*s (must contain only letters and digits)\n", token.length, token.start);
             return 1;
         }
     }
 
     /* Check if the label matches one of the register names */
     for (i = 0; i < 8; i++) {
-        if (strcmp(token, registers[i]) == 0) {
-            printf("Invalid label: %s (cannot be a register name)\n", token);
+        if (spanEquals(token, registers[i])) {
+            report("Invalid label: %.*s (cannot be a register name)\n", token.length, token.start);
             return 1;
         }
     }
@@ -171,268 +149,265 @@ int badLabel(char *token) {
 }
 
 /**
- * @brief Processes a single line of assembly code and populates the LineInfo structure.
+ * @brief Processes a single line of assembly code and populates its entry in the line table.
  *
  * This function parses a line of assembly code, extracting the label (if present), opcode, and operands.
  * It determines whether the line is a directive (.data, .string, .entry, .extern) or an instruction,
- * and populates the corresponding fields in the LineInfo struct.
+ * and populates the corresponding fields in the line table.
+ * Operands and data values are decoded here into numbers and symbol ids, so the second pass
+ * does not parse any text. The line is read through views and never changed.
  *
- * @param line A string containing the line of assembly code to process.
- * @param lineInfo A pointer to a LineInfo struct that will be populated with the parsed information.
+ * @param scan The scan of the source the line is in.
+ * @param line A view of the line of assembly code to process, without its newline.
+ * @param program The program that owns the line table, the symbol table and the pools.
+ * @param index The index of the line, already added with default values.
  */
-void processLine(char *line, LineInfo *lineInfo) {
-    char *token;
-    char *operands = NULL;
-    char *data_token; 
-    char *string_token; 
-    char *entry_token; 
-    char *extern_token;
-    char *src_operand; 
-    char *dest_operand; 
-    char *error_operand;
-
-    /* Initialize the LineInfo structure */
-    initializeLineInfo(lineInfo);
+void processLine(const Scan *scan, Span line, Program *program, int index) {
+    LineTable *lines = &program->lines;
+    LineInfo *lineInfo = &lines->info[index];
+    Span rest = line;
+    Span token;
+    Span text; /* The rest of the line after the directive or the opcode */
+    Span src_operand;
+    Span dest_operand;
+    Span error_operand;
+    int has_token, has_source, has_destination;
+    int i, method, value;
+    int data_count = 0;
 
     /* Check for label: a token ending with ':' */
-    token = strtok(line, " \r\t\n");
+    has_token = nextToken(scan, &rest, SPACES, &token);
     
-    if (token != NULL && token[strlen(token) - 1] == ':') {
-        token[strlen(token) - 1] = '\0'; /* Remove the colon */
+    if (has_token && token.start[token.length - 1] == ':') {
+        token.length--; /* Remove the colon */
         if (badLabel(token)==1) {
-            printf("ERR: label %s not legal\n", token);
+            report("ERR: label %.*s not legal\n", token.length, token.start);
             lineInfo->flag = true;
             return;
         }
-        strcpy(lineInfo->label_name, token);
-        token = strtok(NULL, " \t"); /* Move to the next token */
+        lineInfo->label = internSymbol(&program->symbols, token.start, token.length);
+        has_token = nextToken(scan, &rest, SPACES, &token); /* Move to the next token */
     }
 
     /* Process opcode or directive */
-    if (token) {
-        token[strcspn(token, "\r\t\n")] = '\0'; /* Canceling extra trims or spaces from token */
-
-        strcpy(lineInfo->opcode_name, token);
-        lineInfo->opcode_value = getOpcodeValue(token);
+    if (has_token) {
+        lines->opcode_value[index] = (signed char)getOpcodeValue(token);
+        text = trimSpan(scan, rest);
 
         /* Handle special directives */
-        if (lineInfo->opcode_value == -1) {
-            if (strcmp(token, ".data") == 0) {
+        if (lines->opcode_value[index] == -1) {
+            if (spanEquals(token, ".data")) {
                 lineInfo->is_data = true;
                 /* Process subsequent tokens as data values */
-                data_token = strtok(NULL, "\n");
-                if (data_token) {
-                    strcpy(lineInfo->data_string_value, data_token);
+                if (text.length > 0) {
+                    lineInfo->text = addString(program, text.start, text.length);
+                    data_count = parseData(scan, text, program, index);
                 }
-		        strcpy(lineInfo->opcode_name, ""); /* Set opcode name to NULL */
 
-            } else if (strcmp(token, ".string") == 0) {
+            } else if (spanEquals(token, ".string")) {
                 lineInfo->is_string = true;
-                /* Process subsequent tokens as string values */
-                string_token = strtok(NULL, "\n");
-                if (string_token) {
-                    size_t len = strlen(string_token);
-
-                    /* Check if the string starts and ends with a double quote */
-                    if (string_token[0] == '"' && string_token[len - 1] == '"') {
-                        string_token[len - 1] = '\0';  /* Remove the closing quote */
-                        string_token++;  /* Skip the opening quote */
-                    }
-
-                    strcpy(lineInfo->data_string_value, string_token);
+                /* Check if the string starts and ends with a double quote */
+                if (text.length > 0 && text.start[0] == '"' && text.start[text.length - 1] == '"') {
+                    text.start++; /* Skip the opening quote */
+                    text.length = text.length > 1 ? text.length - 2 : 0; /* Remove the closing quote */
                 }
-                strcpy(lineInfo->opcode_name, ""); /* Set opcode name to NULL */
+                lineInfo->text = addString(program, text.start, text.length);
+                /* The characters and the null at the end are stored as data words */
+                lineInfo->data_start = program->data.count;
+                for (i = 0; i < text.length; i++) {
+                    addDataValue(program, text.start[i]);
+                }
+                addDataValue(program, 0);
+                data_count = program->data.count - lineInfo->data_start;
                 
-            } else if (strcmp(token, ".entry") == 0) {
+            } else if (spanEquals(token, ".entry")) {
                 lineInfo->is_entry = true;
+                lineInfo->text = addString(program, text.start, text.length);
 
-                /* Process subsequent tokens as entry values */
-                entry_token = strtok(NULL, "\n");
-                if (entry_token) {
-                    strcpy(lineInfo->data_string_value, entry_token);
-                }
-                strcpy(lineInfo->opcode_name, ""); /* Set opcode name to NULL */
-
-            } else if (strcmp(token, ".extern") == 0) {
+            } else if (spanEquals(token, ".extern")) {
                 lineInfo->is_extern = true;
-                /* Process subsequent tokens as extern values */
-                extern_token = strtok(NULL, "\r\t\n");
-                if (extern_token) {
-                    strcpy(lineInfo->data_string_value, extern_token);
-                }
-                strcpy(lineInfo->opcode_name, ""); /* Set opcode name to NULL */
+                lineInfo->text = addString(program, text.start, text.length);
 
+            } else {
+                /* Not in the opcode table and not a directive, the line takes no memory */
+                report("WARN: '%.*s' is not a known instruction or directive, the line is ignored\n",
+                       token.length, token.start);
             }
 
         } else {
             /* If it's a valid opcode, process operands */
-            operands = strtok(NULL, "\n");
-
-            if (operands) {
-                src_operand = strtok(operands, " , ");
-                if (src_operand) {
-                    parseMethod(src_operand, &lineInfo->source_method, lineInfo->source_method_value);
+            has_source = nextToken(scan, &text, SPACES | COMMAS, &src_operand);
+            has_destination = nextToken(scan, &text, SPACES | COMMAS, &dest_operand);
+            if (has_destination) {
+                if (parseMethod(src_operand, &method, &value, &program->symbols, index) == 1) {
+                    lineInfo->flag = true;
+                }
+                lines->source_method[index] = (signed char)method;
+                lines->source_value[index] = value;
+                if (parseMethod(dest_operand, &method, &value, &program->symbols, index) == 1) {
+                    lineInfo->flag = true;
                 }
-                dest_operand = strtok(NULL, " , ");
-                if (dest_operand) {
-                    parseMethod(dest_operand, &lineInfo->destination_method, lineInfo->destination_method_value);
-                    lineInfo->count_op = 2;
-                    error_operand = strtok(NULL, " , ");
-                    if (error_operand) {
-                        printf("ERR: there are too many operands\n");
-                        lineInfo->flag = true;
-                        return;
-                    }
-                } else if (!dest_operand && src_operand) {
-                    /* If there's only one operand and no second operand put at destination blocks */
-                    parseMethod(src_operand, &lineInfo->destination_method, lineInfo->destination_method_value);
-                    lineInfo->source_method = -1;
-                    strcpy(lineInfo->source_method_value, "");
-                    lineInfo->count_op = 1;
+                lines->destination_method[index] = (signed char)method;
+                lines->destination_value[index] = value;
+                lineInfo->count_op = 2;
+                if (nextToken(scan, &text, SPACES | COMMAS, &error_operand)) {
+                    report("ERR: there are too many operands\n");
+                    lineInfo->flag = true;
+                    return;
                 }
+            } else if (has_source) {
+                /* If there's only one operand and no second operand put at destination blocks */
+                if (parseMethod(src_operand, &method, &value, &program->symbols, index) == 1) {
+                    lineInfo->flag = true;
+                }
+                lines->destination_method[index] = (signed char)method;
+                lines->destination_value[index] = value;
+                lineInfo->count_op = 1;
             }
         }
-        lineInfo->memory_cells = calculateMemoryCells(lineInfo);
+        lines->memory_cells[index] = calculateMemoryCells(program, index, data_count);
     }
 }
 
 /**
- * @brief Parses an addressing method and assigns the appropriate method type and value.
+ * @brief Parses an addressing method and decodes the operand value.
  *
  * This function determines the addressing method based on the first character of the operand string 
- * and assigns the corresponding method type to the provided pointer. It also copies the operand value 
- * into the provided value string.
+ * and assigns the corresponding method type to the provided pointer. The operand is decoded once:
+ * an immediate operand to its number, a register operand to the register number and a direct
+ * operand to the id of its label in the symbol table.
  *
- * @param method_name A string representing the operand, which could be an immediate value, register, 
+ * @param method_name A view of the operand, which could be an immediate value, register, 
  * indirect register, or direct address.
  * @param method A pointer to an integer where the method type will be stored (0 for immediate, 1 for direct, 
  * 2 for indirect register, 3 for register).
- * @param value A string where the operand's value will be copied.
+ * @param value A pointer to an integer where the decoded operand will be stored.
+ * @param symbols The symbol table of the file.
+ * @param line The index of the line, for the messages.
+ * @return 0 if the operand is valid and 1 otherwise.
+ */
+int parseMethod(Span method_name, int *method, int *value, SymbolTable *symbols, int line) {
+    const char *name = method_name.start;
+    Span number;
+
+    *value = 0;
+    if (name[0] == '#') {
+        *method = IMMEDIATE;
+        number.start = name + 1;
+        number.length = method_name.length - 1;
+        if (!parseNumber(number, value)) {
+            report("ERR: '%.*s' is not a valid immediate value\n", method_name.length, name);
+            return 1;
+        }
+        if (*value < MIN_IMMEDIATE || *value > MAX_IMMEDIATE) {
+            report("ERR: the immediate value %.*s in line %d is out of range (%d to %d)\n", method_name.length,
+                   name, line + 1, MIN_IMMEDIATE, MAX_IMMEDIATE);
+            *value = 0;
+            return 1;
+        }
+    } else if (name[0] == '*') {
+        *method = INDIRECT_REGISTER;
+        if (method_name.length != 3 || name[1] != 'r' || name[2] < '0' || name[2] > '7') {
+            report("ERR: '%.*s' is not a valid indirect register\n", method_name.length, name);
+            return 1;
+        }
+        *value = name[2] - '0';
+    } else if (method_name.length == 2 && name[0] == 'r' && name[1] >= '0' && name[1] <= '7') {
+        *method = DIRECT_REGISTER;
+        *value = name[1] - '0';
+    } else {
+        *method = DIRECT;
+        *value = internSymbol(symbols, name, method_name.length);
+    }
+    return 0;
+}
+
+/**
+ * @brief Formats a decoded operand back to assembly text for the .afp table.
+ * @param symbols The symbol table of the file.
+ * @param method The addressing method of the operand, -1 if there is none.
+ * @param value The decoded operand.
+ * @param text A buffer of at least MAX_LINE_LENGTH characters for the text.
  */
-void parseMethod(const char *method_name, int *method, char *value) {
-    if (method_name[0] == '#') {
-        *method = 0;  /* Immediate method */
-        strcpy(value, method_name);  /* Copy the full value, including the minus sign */
-    } else if (method_name[0] == 'r') {
-        *method = 3;  /* Register method */
-        strcpy(value, method_name);
-    } else if (method_name[0] == '*') {
-        *method = 2;  /* Indirect register method */
-        strcpy(value, method_name);
+void formatOperand(const SymbolTable *symbols, int method, int value, char *text) {
+    if (method == IMMEDIATE) {
+        sprintf(text, "#%d", value);
+    } else if (method == DIRECT) {
+        sprintf(text, "%.*s", MAX_LINE_LENGTH - 1, symbolName(symbols, value));
+    } else if (method == INDIRECT_REGISTER) {
+        sprintf(text, "*r%d", value);
+    } else if (method == DIRECT_REGISTER) {
+        sprintf(text, "r%d", value);
     } else {
-        *method = 1;  /* Direct method */
-        strcpy(value, method_name);
+        text[0] = '\0';
     }
 }
 
 /**
- * @brief Processes the input assembly file and fills an array of LineInfo structures.
+ * @brief Processes the input assembly file and fills the line table of the program.
  *
- * This function reads each line from the provided file, processes it to extract relevant information, 
- * and fills the corresponding LineInfo struct. It also assigns memory addresses to each line, 
+ * This function reads each line of the expanded source, processes it to extract relevant information, 
+ * and fills the corresponding entry of the line table. It also assigns memory addresses to each line, 
  * and handles `.entry` and `.extern` directives by marking the corresponding lines accordingly.
  *
- * @param file A pointer to the input file to be processed.
- * @param lines An array of `LineInfo` structures that will be populated with the parsed data from the file.
- * @param line_count A pointer to an integer where the total number of processed lines will be stored.
+ * @param source The view of the source after the macro process.
+ * @param program An empty program that is filled with the lines, symbols, data words and texts of the file.
+ * @return 0 on success.
  */
-void processInputFile(FILE *file, LineInfo *lines, int *line_count) {
-    char line[MAX_LINE_LENGTH];
+int processInputFile(Span source, Program *program) {
+    const char *cursor = source.start;
+    Scan scan;
+    Span line;
     int current_address = 100; /* starting point address in memory */
-    int k, j;
+    int index;
 
-    *line_count = 0;
+    scanText(&scan, source.start, source.length, program->arena);
 
-    /* Read each line from the file */
-    while (fgets(line, sizeof(line), file)) {
-        /* Initialize the current LineInfo struct */
-        initializeLineInfo(&lines[*line_count]);
+    /* Read each line of the source */
+    while (nextLine(&scan, &cursor, &line)) {
+        /* Add a line with default values to the table */
+        index = addLine(program);
 
-        /* Process the line and fill the struct */
-        processLine(line, &lines[*line_count]);
+        /* Process the line and fill the table */
+        processLine(&scan, line, program, index);
 
         /* Set the memory address for this line */
-        lines[*line_count].memory_value = current_address;
+        program->lines.memory_value[index] = current_address;
 
         /* Increment the current address by the number of memory cells used by this line */
-        current_address += lines[*line_count].memory_cells;
-
-        /* Increment the line count */
-        (*line_count)++;
+        current_address += program->lines.memory_cells[index];
     }
 
-    for (k = 0; k < *line_count; k++) {
-        if (lines[k].is_entry && lines[k].opcode_value == -1) { /*if entry statement*/
-            for (j = 0; j < *line_count; j++) {
-                if (strcmp(lines[k].data_string_value, lines[j].label_name) == 0) {
-                    lines[j].is_entry = 1;
-                }
-            }
-        } 
-        else if (lines[k].is_extern && lines[k].opcode_value == -1) { /*if extern statement*/
-            for (j = 0; j < *line_count; j++) {
-                if (strcmp(lines[k].data_string_value, lines[j].label_name) == 0) {
-                    if (lines[j].is_entry == 1) { /*return error if label is entry and extern*/
-                        printf("ERR: label '%s' is stated entry and extern\n", lines[j].label_name);
-                        lines[j].flag = true;
-                        return; /*stopping the code because of a non-handled input*/
-                    }
-                    lines[j].is_extern = 1;
-                }
-            }
-        }
-    }
+    /* Fill the symbol table, then check every entry/extern statement against its symbol and mark its lines */
+    buildSymbolTable(program);
+    resolveSymbols(program);
+    return 0;
 }
 
 /**
- * @brief Performs the first pass on an assembly source file, generating an intermediate file and preparing for the second pass.
+ * @brief Writes the line table of the first pass to the ".afp" file.
  *
- * This function processes the input assembly file during the first pass. It reads and parses the file, 
- * filling a LineInfo struct with relevant information. The function then generates an 
- * intermediate file (.afp) that includes a detailed breakdown of each line, such as labels, opcodes, 
- * memory addresses, and directive flags. After generating the .afp file, the function initiates the 
- * second pass by calling `secondPass`.
+ * The file includes a detailed breakdown of each line, such as labels, opcodes,
+ * memory addresses, and directive flags. It is only written when it is asked for.
  *
- * @param name_of_file The name of the input assembly file to be processed.
- * @param lines A LineInfo struct that will be populated during the first pass.
- * @param line_count The initial count of lines, which will be updated during processing.
- * @return 0 on success, or 1 if an error occurs.
+ * @param program The program filled by the first pass.
+ * @param base_name The name of the source without its ".as" extension.
  */
-int firstPass(char *name_of_file, LineInfo *lines, int line_count) {
-    FILE *file;
+void makeAfp(Program *program, const char *base_name) {
     int j;
-    char *dot_pos;
-    char output_filename[80];
+    char source_text[MAX_LINE_LENGTH];
+    char destination_text[MAX_LINE_LENGTH];
     FILE *outputFile;
+    LineTable *lines = &program->lines;
+    LineInfo *info;
 
-    if (!name_of_file)
-        return 1;
-
-    file = fopen(name_of_file, "r");
-    if (!file) {
-        perror("ERR: Error opening file");
-        return 1;
-    }
-
-    processInputFile(file, lines, &line_count);
-    fclose(file);
-
-    strcpy(output_filename, name_of_file);
-    dot_pos = strrchr(output_filename, '.');
-    if (dot_pos && strcmp(dot_pos, ".am") == 0) {
-        strcpy(dot_pos, ".afp");
-    } else {
-        printf("ERR: no '.am' file to proceed");
-        return 1;
-    }
-
-    outputFile = fopen(output_filename, "a"); /* Open in append mode */
+    outputFile = fopen(outputName(program->arena, base_name, ".afp"), "w");
     if (!outputFile) {
-        perror("ERR: Error creating output file");
-        return 1;
+        reportError("ERR: Error creating output file");
+        return;
     }
 
-    fprintf(outputFile, "File: %s\n", name_of_file);
+    fprintf(outputFile, "File: %s.am\n", base_name);
     fprintf(outputFile, "----------------------------------------------------------------------------------------------------------------------------------------------------------\n");
     fprintf(outputFile, "| %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s | %-22s|%-22s\n", 
             "Line", "Label", "Opcode", "Opcode Value", "Source Method", "Source Method Value", 
@@ -440,29 +415,52 @@ int firstPass(char *name_of_file, LineInfo *lines, int line_count) {
             "Is String", "Is Entry", "Is Extern", "Data/String Value");
     fprintf(outputFile, "----------------------------------------------------------------------------------------------------------------------------------------------------------\n");
 
-    for (j = 0; j < line_count; j++) {
+    for (j = 0; j < lines->count; j++) {
+        info = &lines->info[j];
+        formatOperand(&program->symbols, lines->source_method[j], lines->source_value[j], source_text);
+        formatOperand(&program->symbols, lines->destination_method[j], lines->destination_value[j], destination_text);
         fprintf(outputFile, "| %-22d | %-22s | %-22s | %-22d | %-22d | %-22s | %-22d | %-22s | %-22d | %-22d | %-22d | %-22d | %-22d | %-22d | %-22d|%-22s\n",
-                j + 1, lines[j].label_name, lines[j].opcode_name, lines[j].opcode_value,
-                lines[j].source_method, lines[j].source_method_value, lines[j].destination_method,
-                lines[j].destination_method_value, lines[j].count_op, lines[j].memory_cells, lines[j].memory_value,
-                lines[j].is_data, lines[j].is_string, lines[j].is_entry, lines[j].is_extern,
-                lines[j].data_string_value);
+                j + 1, info->label == -1 ? "" : symbolName(&program->symbols, info->label),
+                getOpcodeName(lines->opcode_value[j]), lines->opcode_value[j],
+                lines->source_method[j], source_text, lines->destination_method[j],
+                destination_text, info->count_op, lines->memory_cells[j], lines->memory_value[j],
+                info->is_data, info->is_string, info->is_entry, info->is_extern,
+                lineText(program, j));
     }
     fprintf(outputFile, "----------------------------------------------------------------------------------------------------------------------------------------------------------\n\n");
 
     fclose(outputFile);
+}
+
+/**
+ * @brief Performs the first pass on an assembly source and hands the program to the second pass.
+ *
+ * This function processes the expanded source during the first pass. It parses the source in memory,
+ * filling the line table of a program with relevant information. The line table is written to the
+ * ".afp" file only if it was asked for, and then the function initiates the second pass by calling `secondPass`.
+ *
+ * @param source The view of the source after the macro process.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The intermediate files that were asked for.
+ * @param arena The per-file arena that owns the program.
+ * @return 0 on success, or 1 if an error occurs.
+ */
+int firstPass(Span source, const char *base_name, const Options *options, Arena *arena) {
+    Program program;
 
-    dot_pos = strrchr(output_filename, '.');
-    if (dot_pos) {
-        strcpy(dot_pos, ".afp");
+    initProgram(&program, arena);
+    if (processInputFile(source, &program) == 1) {
+        return 1;
+    }
+
+    if (options->write_afp) {
+        makeAfp(&program, base_name);
     }
 
     /* Call secondPass */
-    if (secondPass(output_filename, lines, line_count) == 1) {
-        printf("ERR: Error at second pass processing\n");
+    if (secondPass(base_name, &program, options) == 1) {
+        report("ERR: Error at second pass processing\n");
         return 1;
     }
     return 0;
 }
-
-
@@ -0,0 +1,525 @@
+/* syscall, openat and the io_uring interface are Linux, not ANSI C */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+#if defined(__linux__) && defined(__GNUC__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/stat.h>
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+
+#define RING_ENTRIES 256 /* Submission entries, two per file of a phase */
+#define PREFETCH_FILES 32 /* Sources read ahead by one worker */
+#define QUEUE_BYTES (8 * 1024 * 1024) /* Outputs kept before they are written */
+#define QUEUE_FILES 256
+
+#ifdef HAVE_IO_URING
+
+/* The rings shared with the kernel, only this thread submits and reaps */
+struct IoRing {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_size;
+    void *cq_ring;
+    size_t cq_size;
+    size_t sqes_size;
+    unsigned entries;
+    unsigned tail; /* Entries filled, published to the kernel on submit */
+};
+
+/**
+ * @brief Sets up a ring, mapping its queues.
+ * @param ring The ring.
+ * @return 0 if succeded and 1 if the kernel has no io_uring.
+ */
+static int setupRing(IoRing *ring) {
+    struct io_uring_params params;
+    char *sq, *cq;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        return 1;
+    }
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_size = ring->cq_size = ring->sq_size > ring->cq_size ? ring->sq_size : ring->cq_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return 1;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_ring = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_size);
+            close(ring->fd);
+            return 1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        /* The queues mapped so far are unmapped with the ring */
+        if (ring->cq_ring != ring->sq_ring) {
+            munmap(ring->cq_ring, ring->cq_size);
+        }
+        munmap(ring->sq_ring, ring->sq_size);
+        close(ring->fd);
+        return 1;
+    }
+
+    sq = (char *)ring->sq_ring;
+    cq = (char *)ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring->entries = params.sq_entries;
+    ring->tail = *ring->sq_tail;
+    return 0;
+}
+
+/**
+ * @brief Unmaps the queues of a ring and closes it.
+ * @param ring The ring.
+ */
+static void closeRing(IoRing *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_size);
+    }
+    munmap(ring->sq_ring, ring->sq_size);
+    close(ring->fd);
+}
+
+/**
+ * @brief Takes the next submission entry, cleared.
+ * @param ring The ring.
+ * @param user_data What the completion of the entry gives back.
+ * @return The entry, the caller never fills more than RING_ENTRIES between submits.
+ */
+static struct io_uring_sqe *nextEntry(IoRing *ring, unsigned long user_data) {
+    unsigned index = ring->tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->tail++;
+    return sqe;
+}
+
+/**
+ * @brief Submits the filled entries with one system call, and waits for all of them.
+ * @param ring The ring.
+ * @param results The result of every entry, by its user data.
+ * @return 0 if succeded and 1 if the ring failed.
+ */
+static int submitAndWait(IoRing *ring, int *results) {
+    unsigned count = ring->tail - *ring->sq_tail;
+    unsigned to_submit = count;
+    unsigned head, done = 0;
+    long submitted;
+
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+    while (done < count) {
+        submitted = syscall(__NR_io_uring_enter, ring->fd, to_submit, count - done, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0 && errno != EINTR) {
+            return 1;
+        }
+        if (submitted > 0) {
+            to_submit -= (unsigned)submitted;
+        }
+        head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            results[ring->cqes[head & *ring->cq_mask].user_data] = ring->cqes[head & *ring->cq_mask].res;
+            head++;
+            done++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+#else
+
+struct IoRing {
+    int fd;
+};
+
+static int setupRing(IoRing *ring) {
+    (void)ring;
+    return 1;
+}
+
+static void closeRing(IoRing *ring) {
+    (void)ring;
+}
+
+#endif
+
+/**
+ * @brief Initializes the batched I/O of a worker.
+ *
+ * ASSEMBLER_IO=plain in the environment writes the queue with plain system
+ * calls even if the kernel has io_uring.
+ *
+ * @param io The batched I/O.
+ */
+void initIoBatch(IoBatch *io) {
+    const char *forced = getenv("ASSEMBLER_IO");
+
+    io->ring = NULL;
+    if (forced == NULL || strcmp(forced, "plain") != 0) {
+        io->ring = (IoRing *)malloc(sizeof(IoRing));
+        if (io->ring == NULL) {
+            perror("ERR: Unable to allocate memory for the I/O ring");
+            exit(EXIT_FAILURE);
+        }
+        if (setupRing(io->ring) == 1) {
+            free(io->ring);
+            io->ring = NULL;
+        }
+    }
+    initArena(&io->arena, ARENA_SIZE);
+    io->queue.artifacts = NULL;
+    io->queue.count = 0;
+    io->queue.capacity = 0;
+    io->queue.arena = &io->arena;
+    io->queued_bytes = 0;
+    io->inputs = NULL;
+    io->sources = NULL;
+    io->first = 0;
+    io->count = 0;
+}
+
+/**
+ * @brief Writes outputs with plain system calls, the fallback without io_uring.
+ * @param artifact The output.
+ * @return 0 if succeded and the errno of the failure otherwise.
+ */
+static int writeOutput(const Artifact *artifact) {
+    ssize_t count = 0;
+    int fd, error, written = 0;
+
+    unlink(artifact->name);
+    fd = open(artifact->name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        return errno;
+    }
+    while (written < artifact->length &&
+           (count = write(fd, artifact->text + written, (size_t)(artifact->length - written))) > 0) {
+        written += (int)count;
+    }
+    if (written < artifact->length) {
+        error = count < 0 ? errno : EIO;
+        close(fd);
+        return error;
+    }
+    return close(fd) == -1 ? errno : 0;
+}
+
+#ifdef HAVE_IO_URING
+/**
+ * @brief Writes up to RING_ENTRIES / 2 outputs with two submissions.
+ *
+ * The first one removes and creates every file, the second one writes and
+ * closes them. Each pair is hard linked, so the second runs even if the
+ * first fails, and a file is closed even if it could not be written.
+ *
+ * @param ring The ring.
+ * @param artifacts The outputs.
+ * @param count The number of outputs.
+ * @param results The errno of every output, 0 if it was written.
+ */
+static void writeOutputsRing(IoRing *ring, const Artifact *artifacts, int count, int *results) {
+    int status[RING_ENTRIES];
+    struct io_uring_sqe *sqe;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        sqe = nextEntry(ring, (unsigned long)(2 * i));
+        sqe->opcode = IORING_OP_UNLINKAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)artifacts[i].name;
+        sqe->flags = IOSQE_IO_HARDLINK;
+        sqe = nextEntry(ring, (unsigned long)(2 * i + 1));
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)artifacts[i].name;
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+        sqe->len = 0666;
+    }
+    if (submitAndWait(ring, status) == 1) {
+        for (i = 0; i < count; i++) {
+            results[i] = EIO;
+        }
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        results[i] = status[2 * i + 1] < 0 ? -status[2 * i + 1] : 0;
+        if (results[i] != 0) {
+            continue;
+        }
+        sqe = nextEntry(ring, (unsigned long)(2 * i));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = status[2 * i + 1];
+        sqe->addr = (unsigned long)artifacts[i].text;
+        sqe->len = (unsigned)artifacts[i].length;
+        sqe->flags = IOSQE_IO_HARDLINK;
+        sqe = nextEntry(ring, (unsigned long)(2 * i + 1));
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = status[2 * i + 1];
+    }
+    for (i = 0; i < 2 * count; i++) {
+        status[i] = 0;
+    }
+    if (submitAndWait(ring, status) == 1) {
+        for (i = 0; i < count; i++) {
+            results[i] = EIO;
+        }
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        if (results[i] == 0 && status[2 * i] != artifacts[i].length) {
+            /* A short write is written again with the fallback */
+            results[i] = status[2 * i] < 0 ? -status[2 * i] : writeOutput(&artifacts[i]);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Writes every queued output, and empties the queue.
+ * @param io The batched I/O.
+ */
+void flushOutputs(IoBatch *io) {
+    int results[RING_ENTRIES / 2];
+    int first, count, i;
+
+    for (first = 0; first < io->queue.count; first += count) {
+        count = io->queue.count - first < RING_ENTRIES / 2 ? io->queue.count - first : RING_ENTRIES / 2;
+#ifdef HAVE_IO_URING
+        if (io->ring != NULL) {
+            writeOutputsRing(io->ring, io->queue.artifacts + first, count, results);
+        } else
+#endif
+        {
+            for (i = 0; i < count; i++) {
+                results[i] = writeOutput(&io->queue.artifacts[first + i]);
+            }
+        }
+        for (i = 0; i < count; i++) {
+            if (results[i] != 0) {
+                fprintf(errorStream(), "ERR: Failed to write file %s: %s\n", io->queue.artifacts[first + i].name,
+                        strerror(results[i]));
+            }
+        }
+    }
+    resetArena(&io->arena);
+    io->queue.artifacts = NULL;
+    io->queue.count = 0;
+    io->queue.capacity = 0;
+    io->queued_bytes = 0;
+}
+
+/**
+ * @brief Starts queueing the outputs of a file, instead of writing them one by one.
+ * @param io The batched I/O.
+ * @return The list the outputs were captured by before.
+ */
+ArtifactList *queueOutputs(IoBatch *io) {
+    return captureOutputs(&io->queue);
+}
+
+/**
+ * @brief Stops queueing the outputs of a file, and writes the queue once it is large.
+ * @param io The batched I/O.
+ * @param previous The list returned by queueOutputs.
+ */
+void endQueue(IoBatch *io, ArtifactList *previous) {
+    int i;
+
+    captureOutputs(previous);
+    io->queued_bytes = 0;
+    for (i = 0; i < io->queue.count; i++) {
+        io->queued_bytes += io->queue.artifacts[i].length;
+    }
+    if (io->queue.count >= QUEUE_FILES || io->queued_bytes >= QUEUE_BYTES) {
+        flushOutputs(io);
+    }
+}
+
+/**
+ * @brief Reads the sources of the next files with two submissions.
+ *
+ * The first one opens and sizes every file, the second one reads and closes
+ * them. A source that can't be read ahead is left to openSource, which also
+ * tries the name with ".as" added.
+ *
+ * @param io The batched I/O.
+ * @param files The names of the files of the batch.
+ * @param first The first file to read.
+ * @param count The number of files to read.
+ */
+void prefetchInputs(IoBatch *io, char **files, int first, int count) {
+#ifdef HAVE_IO_URING
+    struct statx *sizes;
+    struct io_uring_sqe *sqe;
+    int status[RING_ENTRIES];
+    size_t total = 0;
+    char *cursor;
+    int i;
+#endif
+
+    free(io->inputs);
+    free(io->sources);
+    io->inputs = NULL;
+    io->first = first;
+    io->count = count < PREFETCH_FILES ? count : PREFETCH_FILES;
+    io->sources = (SourceFile *)calloc((size_t)io->count + 1, sizeof(SourceFile));
+    if (io->sources == NULL) {
+        perror("ERR: Unable to allocate memory for the sources");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < io->count; i++) {
+        io->sources[i].length = -1;
+    }
+#ifdef HAVE_IO_URING
+    if (io->ring == NULL) {
+        return;
+    }
+    sizes = (struct statx *)malloc((size_t)io->count * sizeof(struct statx));
+    if (sizes == NULL) {
+        perror("ERR: Unable to allocate memory for the sources");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < io->count; i++) {
+        sqe = nextEntry(io->ring, (unsigned long)(2 * i));
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)files[first + i];
+        sqe->open_flags = O_RDONLY;
+        sqe = nextEntry(io->ring, (unsigned long)(2 * i + 1));
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)files[first + i];
+        sqe->len = STATX_SIZE;
+        sqe->off = (unsigned long)&sizes[i];
+    }
+    if (submitAndWait(io->ring, status) == 1) {
+        free(sizes);
+        return;
+    }
+
+    for (i = 0; i < io->count; i++) {
+        if (status[2 * i] >= 0 && status[2 * i + 1] == 0 && sizes[i].stx_size < (unsigned long)INT_MAX) {
+            total += (size_t)sizes[i].stx_size + 1;
+        }
+    }
+    io->inputs = (char *)malloc(total + 1);
+    if (io->inputs == NULL) {
+        perror("ERR: Unable to allocate memory for the sources");
+        exit(EXIT_FAILURE);
+    }
+    cursor = io->inputs;
+    for (i = 0; i < io->count; i++) {
+        if (status[2 * i] < 0) {
+            continue;
+        }
+        if (status[2 * i + 1] == 0 && sizes[i].stx_size < (unsigned long)INT_MAX) {
+            io->sources[i].text = cursor;
+            io->sources[i].length = (int)sizes[i].stx_size;
+            sqe = nextEntry(io->ring, (unsigned long)(2 * i));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = status[2 * i];
+            sqe->addr = (unsigned long)cursor;
+            sqe->len = (unsigned)sizes[i].stx_size;
+            sqe->flags = IOSQE_IO_HARDLINK;
+            cursor += sizes[i].stx_size + 1;
+        }
+        sqe = nextEntry(io->ring, (unsigned long)(2 * i + 1));
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = status[2 * i];
+    }
+    free(sizes);
+    for (i = 0; i < 2 * io->count; i++) {
+        status[i] = 0;
+    }
+    if (submitAndWait(io->ring, status) == 1) {
+        for (i = 0; i < io->count; i++) {
+            io->sources[i].length = -1;
+        }
+        return;
+    }
+    for (i = 0; i < io->count; i++) {
+        /* A file that changed size since it was sized is read again by openSource */
+        if (io->sources[i].length >= 0 && status[2 * i] != io->sources[i].length) {
+            io->sources[i].length = -1;
+        }
+    }
+#else
+    (void)files;
+#endif
+}
+
+/**
+ * @brief Gives the source of a file if it was read ahead.
+ * @param io The batched I/O.
+ * @param files The names of the files of the batch.
+ * @param task The number of the file.
+ * @param task_count The number of files of the batch.
+ * @return The source, or NULL if it has to be opened.
+ */
+SourceFile *takeInput(IoBatch *io, char **files, int task, int task_count) {
+    if (io->ring == NULL) {
+        return NULL;
+    }
+    if (task < io->first || task >= io->first + io->count) {
+        prefetchInputs(io, files, task, task_count - task);
+    }
+    return io->sources[task - io->first].length >= 0 ? &io->sources[task - io->first] : NULL;
+}
+
+/**
+ * @brief Writes the outputs still queued and frees the batched I/O.
+ * @param io The batched I/O.
+ */
+void freeIoBatch(IoBatch *io) {
+    flushOutputs(io);
+    if (io->ring != NULL) {
+        closeRing(io->ring);
+        free(io->ring);
+    }
+    freeArena(&io->arena);
+    free(io->inputs);
+    free(io->sources);
+}
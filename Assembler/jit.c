@@ -0,0 +1,667 @@
+/* mmap and MAP_ANONYMOUS are POSIX and BSD, not ANSI C */
+#define _DEFAULT_SOURCE
+
+#include <limits.h>
+#include <stddef.h>
+#include "HEDER.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define HAVE_JIT 1
+#endif
+
+#define JIT_BUFFER_SIZE (4 * 1024 * 1024)
+#define BLOCK_LENGTH 64 /* Instructions translated into one block at most */
+#define BLOCK_BYTES 32768 /* Room a block may take with its exits, more than the longest one does */
+#define MAX_EXITS (2 * BLOCK_LENGTH + 3)
+
+/* What runJit gives back when it ran one instruction and the run goes on */
+#define RUNNING -1
+
+/* Why the translated code returned to runJit */
+enum {
+    EXIT_CHAIN, /* To an address that had no block, the jump to it is linked once it has one */
+    EXIT_DISPATCH, /* To the address rts returned to */
+    EXIT_INTERPRET, /* The instruction at pc is run by the interpreter */
+    EXIT_STORE, /* A write to memory, that may change a translated instruction */
+    EXIT_BUDGET /* The block has more instructions than the step limit leaves */
+};
+
+/* The x86-64 registers of the operands of the generated code */
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+#ifdef HAVE_JIT
+
+/* What the translated code reads when it is entered and writes back when it returns */
+typedef struct {
+    Machine *machine; /* In rbx, the cells, the micro-ops and the stack are found from it */
+    unsigned char *guard; /* In r13 */
+    unsigned long budget; /* In r14, the instructions that can run before the step limit */
+    int zero; /* In r15d */
+    int depth; /* In ebp */
+    int pc; /* Where the run goes on, set by the exit */
+    int at; /* The address written, for EXIT_STORE */
+    int patch; /* The offset of the jump to link, for EXIT_CHAIN */
+} JitContext;
+
+typedef int (*JitEntry)(JitContext *context, const unsigned char *block);
+
+/* An exit of a block, emitted after its code and reached by a forward jump */
+typedef struct {
+    int position; /* The offset of the rel32 of the jump */
+    int reason;
+    int pc;
+    int refund; /* Instructions of the block that were counted and not run */
+    int at; /* The address written, -1 if it is in ecx */
+} BlockExit;
+
+struct Jit {
+    unsigned char *buffer; /* Readable and writable while code is written, readable and executable while it runs */
+    bool writable;
+    int used;
+    int exit_code; /* The code every exit ends in, it returns to runJit */
+    int blocks_start; /* The blocks follow the entry and the exit code */
+    unsigned long generation; /* Counts the flushes, a link asked for before one is not made */
+    unsigned char *blocks[MEMORY_SIZE + 1]; /* The block that starts at every address, NULL if none */
+    unsigned char guard[MEMORY_SIZE]; /* Set for the words of every translated instruction */
+    BlockExit exits[MAX_EXITS];
+    int exit_count;
+};
+
+static void emitCode(Jit *jit, const char *bytes, int count) {
+    memcpy(jit->buffer + jit->used, bytes, (size_t)count);
+    jit->used += count;
+}
+
+static void emitByte(Jit *jit, int byte) {
+    jit->buffer[jit->used++] = (unsigned char)byte;
+}
+
+static void patch32(unsigned char *at, long value) {
+    at[0] = (unsigned char)(value & 0xFF);
+    at[1] = (unsigned char)((value >> 8) & 0xFF);
+    at[2] = (unsigned char)((value >> 16) & 0xFF);
+    at[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static void emit32(Jit *jit, long value) {
+    patch32(jit->buffer + jit->used, value);
+    jit->used += 4;
+}
+
+/* Points the rel32 at an offset of the buffer to another offset */
+static void linkJump(Jit *jit, int position, int target) {
+    patch32(jit->buffer + position, (long)target - (position + 4));
+}
+
+/* The displacement from rbx of a cell, of the kind of a micro-op and of the stack */
+#define CELL_DISP(cell) ((long)(offsetof(Machine, cells) + 2 * (size_t)(cell)))
+#define KIND_DISP(address) \
+    ((long)(offsetof(Machine, code) + (size_t)(address) * sizeof(MicroOp) + offsetof(MicroOp, kind)))
+#define STACK_DISP ((long)offsetof(Machine, stack))
+#define CONTEXT_DISP(field) ((long)offsetof(JitContext, field))
+
+/**
+ * @brief Emits the entry of the translated code and the exit every block returns through.
+ *
+ * The entry keeps the context in r12 and the state of the machine in
+ * registers, and jumps to the block given. The exit writes the state back and
+ * returns the reason in eax.
+ *
+ * @param jit The translator, its buffer empty.
+ */
+static void emitEntryAndExit(Jit *jit) {
+    /* push rbx, rbp, r12, r13, r14, r15 and mov r12, rdi */
+    emitCode(jit, "\x53\x55\x41\x54\x41\x55\x41\x56\x41\x57\x49\x89\xFC", 13);
+    emitCode(jit, "\x49\x8B\x9C\x24", 4); /* mov rbx, [r12 + machine] */
+    emit32(jit, CONTEXT_DISP(machine));
+    emitCode(jit, "\x4D\x8B\xAC\x24", 4); /* mov r13, [r12 + guard] */
+    emit32(jit, CONTEXT_DISP(guard));
+    emitCode(jit, "\x4D\x8B\xB4\x24", 4); /* mov r14, [r12 + budget] */
+    emit32(jit, CONTEXT_DISP(budget));
+    emitCode(jit, "\x45\x8B\xBC\x24", 4); /* mov r15d, [r12 + zero] */
+    emit32(jit, CONTEXT_DISP(zero));
+    emitCode(jit, "\x41\x8B\xAC\x24", 4); /* mov ebp, [r12 + depth] */
+    emit32(jit, CONTEXT_DISP(depth));
+    emitCode(jit, "\xFF\xE6", 2); /* jmp rsi */
+
+    jit->exit_code = jit->used;
+    emitCode(jit, "\x4D\x89\xB4\x24", 4); /* mov [r12 + budget], r14 */
+    emit32(jit, CONTEXT_DISP(budget));
+    emitCode(jit, "\x45\x89\xBC\x24", 4); /* mov [r12 + zero], r15d */
+    emit32(jit, CONTEXT_DISP(zero));
+    emitCode(jit, "\x41\x89\xAC\x24", 4); /* mov [r12 + depth], ebp */
+    emit32(jit, CONTEXT_DISP(depth));
+    /* pop r15, r14, r13, r12, rbp, rbx and ret */
+    emitCode(jit, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5D\x5B\xC3", 11);
+    jit->blocks_start = jit->used;
+}
+
+/**
+ * @brief Maps the buffer writable to write code, or executable to run it, never both at once.
+ * @param jit The translator.
+ * @param writable true to write and false to run.
+ */
+static void setWritable(Jit *jit, bool writable) {
+    if (jit->writable == writable) {
+        return;
+    }
+    if (mprotect(jit->buffer, JIT_BUFFER_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == -1) {
+        perror("ERR: Unable to change the protection of the translated code");
+        exit(EXIT_FAILURE);
+    }
+    jit->writable = writable;
+}
+
+/**
+ * @brief Drops every block, after code they were made of was written or when the buffer is full.
+ * @param jit The translator.
+ */
+static void flushJit(Jit *jit) {
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->guard, 0, sizeof(jit->guard));
+    jit->used = jit->blocks_start;
+    jit->generation++;
+}
+
+/**
+ * @brief Makes a translator, with a buffer of code mapped writable until it runs.
+ * @return The translator, or NULL if the machine or the system can't run generated code.
+ */
+Jit *createJit(void) {
+    Jit *jit = (Jit *)malloc(sizeof(Jit));
+    void *buffer;
+
+    if (jit == NULL) {
+        return NULL;
+    }
+    buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+    jit->buffer = (unsigned char *)buffer;
+    jit->writable = true;
+    jit->used = 0;
+    jit->generation = 0;
+    jit->exit_count = 0;
+    emitEntryAndExit(jit);
+    flushJit(jit);
+    return jit;
+}
+
+/**
+ * @brief Unmaps the code of a translator and frees it.
+ * @param jit The translator, or NULL.
+ */
+void freeJit(Jit *jit) {
+    if (jit == NULL) {
+        return;
+    }
+    munmap(jit->buffer, JIT_BUFFER_SIZE);
+    free(jit);
+}
+
+/**
+ * @brief Emits a jump to an exit of the block, that is emitted after its code.
+ * @param jit The translator.
+ * @param opcode The jump, a jcc (2 bytes) or jmp (1 byte) with a rel32.
+ * @param length The length of the opcode.
+ * @param reason Why the code returns.
+ * @param pc Where the run goes on.
+ * @param refund Instructions of the block that were counted and not run.
+ * @param at The address written for EXIT_STORE, -1 if it is in ecx.
+ */
+static void emitExit(Jit *jit, const char *opcode, int length, int reason, int pc, int refund, int at) {
+    BlockExit *exit = &jit->exits[jit->exit_count++];
+
+    emitCode(jit, opcode, length);
+    exit->position = jit->used;
+    emit32(jit, 0);
+    exit->reason = reason;
+    exit->pc = pc;
+    exit->refund = refund;
+    exit->at = at;
+}
+
+/**
+ * @brief Emits the exits of a block, after its code.
+ * @param jit The translator.
+ */
+static void emitExits(Jit *jit) {
+    const BlockExit *exit;
+    int i;
+
+    for (i = 0; i < jit->exit_count; i++) {
+        exit = &jit->exits[i];
+        linkJump(jit, exit->position, jit->used);
+        if (exit->refund != 0) {
+            emitCode(jit, "\x49\x81\xC6", 3); /* add r14, refund */
+            emit32(jit, exit->refund);
+        }
+        if (exit->reason == EXIT_STORE && exit->at == -1) {
+            emitCode(jit, "\x41\x89\x8C\x24", 4); /* mov [r12 + at], ecx */
+            emit32(jit, CONTEXT_DISP(at));
+        } else if (exit->reason == EXIT_STORE) {
+            emitCode(jit, "\x41\xC7\x84\x24", 4); /* mov dword [r12 + at], address */
+            emit32(jit, CONTEXT_DISP(at));
+            emit32(jit, exit->at);
+        } else if (exit->reason == EXIT_CHAIN) {
+            emitCode(jit, "\x41\xC7\x84\x24", 4); /* mov dword [r12 + patch], position */
+            emit32(jit, CONTEXT_DISP(patch));
+            emit32(jit, exit->position);
+        }
+        emitCode(jit, "\x41\xC7\x84\x24", 4); /* mov dword [r12 + pc], pc */
+        emit32(jit, CONTEXT_DISP(pc));
+        emit32(jit, exit->pc);
+        emitByte(jit, 0xB8); /* mov eax, reason */
+        emit32(jit, exit->reason);
+        emitByte(jit, 0xE9); /* jmp exit_code */
+        emit32(jit, 0);
+        linkJump(jit, jit->used - 4, jit->exit_code);
+    }
+    jit->exit_count = 0;
+}
+
+/**
+ * @brief Emits a jump to the block of an address, or to an exit that links it once the block is made.
+ * @param jit The translator.
+ * @param opcode The jump, a jcc (2 bytes) or jmp (1 byte) with a rel32.
+ * @param length The length of the opcode.
+ * @param target The address.
+ */
+static void emitChain(Jit *jit, const char *opcode, int length, int target) {
+    if (jit->blocks[target] != NULL) {
+        emitCode(jit, opcode, length);
+        emit32(jit, 0);
+        linkJump(jit, jit->used - 4, (int)(jit->blocks[target] - jit->buffer));
+        return;
+    }
+    emitExit(jit, opcode, length, EXIT_CHAIN, target, 0, 0);
+}
+
+/* movzx reg, word [rbx + cell] */
+static void emitLoadCell(Jit *jit, int reg, int cell) {
+    emitCode(jit, "\x0F\xB7", 2);
+    emitByte(jit, 0x83 | reg << 3);
+    emit32(jit, CELL_DISP(cell));
+}
+
+/* movzx reg, word [rbx + rcx * 2 + cells], the memory cell at the address in ecx */
+static void emitLoadAddressed(Jit *jit, int reg) {
+    emitCode(jit, "\x0F\xB7", 2);
+    emitByte(jit, 0x84 | reg << 3);
+    emitByte(jit, 0x4B);
+    emit32(jit, CELL_DISP(0));
+}
+
+/* ecx = the address in a register cell */
+static void emitAddress(Jit *jit, int cell) {
+    emitLoadCell(jit, ECX, cell);
+    emitCode(jit, "\x81\xE1", 2); /* and ecx, ADDRESS_MASK */
+    emit32(jit, ADDRESS_MASK);
+}
+
+/* eax & WORD_MASK, and the Z flag of the result */
+static void emitResult(Jit *jit) {
+    emitByte(jit, 0x25); /* and eax, WORD_MASK */
+    emit32(jit, WORD_MASK);
+    emitCode(jit, "\x41\x0F\x94\xC7\x45\x0F\xB6\xFF", 8); /* sete r15b and movzx r15d, r15b */
+}
+
+/**
+ * @brief Emits the write of ax to the destination of an instruction.
+ *
+ * A write to memory marks the micro-ops it may change the way the interpreter
+ * does, and leaves the block if it wrote a word of a translated instruction.
+ *
+ * @param jit The translator.
+ * @param cell The destination cell, or the register cell that holds its address (in ecx).
+ * @param indirect The destination is the memory cell whose address is in ecx.
+ * @param pc The address of the next instruction.
+ * @param refund Instructions of the block after this one.
+ */
+static void emitStore(Jit *jit, int cell, bool indirect, int pc, int refund) {
+    int address;
+
+    if (!indirect) {
+        emitCode(jit, "\x66\x89\x83", 3); /* mov [rbx + cell], ax */
+        emit32(jit, CELL_DISP(cell));
+        if (cell >= MEMORY_SIZE) {
+            return;
+        }
+        for (address = cell >= 2 ? cell - 2 : 0; address <= cell; address++) {
+            emitCode(jit, "\xC6\x83", 2); /* mov byte [rbx + kind], MICRO_DECODE */
+            emit32(jit, KIND_DISP(address));
+            emitByte(jit, MICRO_DECODE);
+        }
+        emitCode(jit, "\x41\x80\xBD", 3); /* cmp byte [r13 + cell], 0 */
+        emit32(jit, cell);
+        emitByte(jit, 0);
+        emitExit(jit, "\x0F\x85", 2, EXIT_STORE, pc, refund, cell); /* jne */
+        return;
+    }
+    emitCode(jit, "\x66\x89\x84\x4B", 4); /* mov [rbx + rcx * 2 + cells], ax */
+    emit32(jit, CELL_DISP(0));
+    /* Below address 2 not all three micro-ops exist, runJit marks them */
+    emitCode(jit, "\x83\xF9\x02", 3); /* cmp ecx, 2 */
+    emitExit(jit, "\x0F\x82", 2, EXIT_STORE, pc, refund, -1); /* jb */
+    emitCode(jit, "\x69\xD1", 2); /* imul edx, ecx, sizeof(MicroOp) */
+    emit32(jit, (long)sizeof(MicroOp));
+    for (address = 0; address >= -2; address--) {
+        emitCode(jit, "\xC6\x84\x13", 3); /* mov byte [rbx + rdx + kind], MICRO_DECODE */
+        emit32(jit, KIND_DISP(0) + address * (long)sizeof(MicroOp));
+        emitByte(jit, MICRO_DECODE);
+    }
+    emitCode(jit, "\x41\x80\x7C\x0D\x00\x00", 6); /* cmp byte [r13 + rcx], 0 */
+    emitExit(jit, "\x0F\x85", 2, EXIT_STORE, pc, refund, -1); /* jne */
+}
+
+/**
+ * @brief Emits an instruction that reads and writes cells, mov to dec.
+ * @param jit The translator.
+ * @param op The micro-op.
+ * @param pc The address of the next instruction.
+ * @param refund Instructions of the block after this one.
+ */
+static void emitOperation(Jit *jit, const MicroOp *op, int pc, int refund) {
+    int kind = op->kind;
+    int operation;
+    bool indirect;
+
+    if (kind < MICRO_CLR_C) {
+        operation = kind & ~3;
+        indirect = (kind & 1) != 0;
+        if (kind & 2) {
+            emitAddress(jit, op->source);
+            emitLoadAddressed(jit, EDX);
+        } else {
+            emitLoadCell(jit, EDX, op->source);
+        }
+        if (indirect) {
+            emitAddress(jit, op->destination);
+        }
+        if (operation != MICRO_MOV_CC) {
+            if (indirect) {
+                emitLoadAddressed(jit, EAX);
+            } else {
+                emitLoadCell(jit, EAX, op->destination);
+            }
+        }
+        if (operation == MICRO_CMP_CC) {
+            /* xor r15d, r15d, cmp eax, edx and sete r15b */
+            emitCode(jit, "\x45\x31\xFF\x39\xD0\x41\x0F\x94\xC7", 9);
+            return;
+        }
+        if (operation == MICRO_MOV_CC) {
+            emitCode(jit, "\x89\xD0", 2); /* mov eax, edx */
+        } else {
+            emitCode(jit, operation == MICRO_ADD_CC ? "\x01\xD0" : "\x29\xD0", 2); /* add or sub eax, edx */
+            emitResult(jit);
+        }
+    } else {
+        operation = kind & ~1;
+        indirect = (kind & 1) != 0;
+        if (indirect) {
+            emitAddress(jit, op->destination);
+        }
+        if (operation == MICRO_CLR_C) {
+            emitCode(jit, "\x31\xC0", 2); /* xor eax, eax */
+        } else {
+            if (indirect) {
+                emitLoadAddressed(jit, EAX);
+            } else {
+                emitLoadCell(jit, EAX, op->destination);
+            }
+            /* not, inc or dec eax */
+            emitCode(jit, operation == MICRO_NOT_C ? "\xF7\xD0" : operation == MICRO_INC_C ? "\xFF\xC0" : "\xFF\xC8",
+                     2);
+        }
+        emitResult(jit);
+    }
+    emitStore(jit, op->destination, indirect, pc, refund);
+}
+
+/**
+ * @brief Tells if an instruction is translated. red and prn, the jumps to the address in a register, and
+ * what ends the run are left to the interpreter.
+ * @param op The micro-op, decoded.
+ * @return true if it is translated.
+ */
+static bool isTranslated(const MicroOp *op) {
+    if (op->kind <= MICRO_DEC_I || op->kind == MICRO_RTS) {
+        return true;
+    }
+    return (op->kind == MICRO_JMP || op->kind == MICRO_BNE || op->kind == MICRO_JSR) &&
+           op->destination >= CONSTANT_CELLS;
+}
+
+/**
+ * @brief Decodes the instruction at an address if it was written since it was decoded.
+ * @param machine The machine.
+ * @param pc The address.
+ * @return The micro-op.
+ */
+static const MicroOp *decodedOp(Machine *machine, int pc) {
+    if (machine->code[pc].kind == MICRO_DECODE) {
+        decodeInstruction(machine, pc);
+    }
+    return &machine->code[pc];
+}
+
+/**
+ * @brief Translates the instructions from an address up to a jump, or to one that is not translated.
+ *
+ * The block takes its instructions from the step budget when it starts and
+ * gives back the ones it didn't run when it leaves early. A jump to a
+ * known address goes straight to the block there once it is made.
+ *
+ * @param jit The translator, with room for a block.
+ * @param machine The machine.
+ * @param start The address.
+ * @return The block, or NULL if the instruction at the address is not translated.
+ */
+static unsigned char *translateBlock(Jit *jit, Machine *machine, int start) {
+    const MicroOp *op;
+    unsigned char *block;
+    int count = 0, index, pc, target;
+
+    /* How many instructions, they are all counted when the block starts */
+    for (pc = start; count < BLOCK_LENGTH; pc += op->size) {
+        op = decodedOp(machine, pc);
+        if (!isTranslated(op)) {
+            break;
+        }
+        count++;
+        if (op->kind >= MICRO_JMP) {
+            break;
+        }
+    }
+    if (count == 0) {
+        return NULL;
+    }
+
+    block = jit->buffer + jit->used;
+    jit->blocks[start] = block;
+    emitCode(jit, "\x49\x81\xEE", 3); /* sub r14, count */
+    emit32(jit, count);
+    emitExit(jit, "\x0F\x82", 2, EXIT_BUDGET, start, count, 0); /* jb */
+    for (index = 0, pc = start; index < count; index++, pc += op->size) {
+        op = &machine->code[pc];
+        memset(jit->guard + pc, 1, op->size);
+        target = machine->cells[op->destination] & ADDRESS_MASK;
+        switch (op->kind) {
+        case MICRO_JMP:
+            emitChain(jit, "\xE9", 1, target);
+            break;
+        case MICRO_BNE:
+            emitCode(jit, "\x45\x85\xFF", 3); /* test r15d, r15d */
+            emitChain(jit, "\x0F\x85", 2, pc + op->size); /* jnz */
+            emitChain(jit, "\xE9", 1, target);
+            break;
+        case MICRO_JSR:
+            emitCode(jit, "\x81\xFD", 2); /* cmp ebp, STACK_SIZE */
+            emit32(jit, STACK_SIZE);
+            emitExit(jit, "\x0F\x84", 2, EXIT_INTERPRET, pc, count - index, 0); /* je */
+            emitCode(jit, "\x66\xC7\x84\x6B", 4); /* mov word [rbx + rbp * 2 + stack], return address */
+            emit32(jit, STACK_DISP);
+            emitByte(jit, (pc + op->size) & 0xFF);
+            emitByte(jit, (pc + op->size) >> 8);
+            emitCode(jit, "\xFF\xC5", 2); /* inc ebp */
+            emitChain(jit, "\xE9", 1, target);
+            break;
+        case MICRO_RTS:
+            emitCode(jit, "\x85\xED", 2); /* test ebp, ebp */
+            emitExit(jit, "\x0F\x84", 2, EXIT_INTERPRET, pc, count - index, 0); /* je */
+            /* dec ebp and movzx eax, word [rbx + rbp * 2 + stack] */
+            emitCode(jit, "\xFF\xCD\x0F\xB7\x84\x6B", 6);
+            emit32(jit, STACK_DISP);
+            emitCode(jit, "\x41\x89\x84\x24", 4); /* mov [r12 + pc], eax */
+            emit32(jit, CONTEXT_DISP(pc));
+            emitByte(jit, 0xB8); /* mov eax, EXIT_DISPATCH */
+            emit32(jit, EXIT_DISPATCH);
+            emitByte(jit, 0xE9); /* jmp exit_code */
+            emit32(jit, 0);
+            linkJump(jit, jit->used - 4, jit->exit_code);
+            break;
+        default:
+            emitOperation(jit, op, pc + op->size, count - index - 1);
+        }
+    }
+    if (op->kind < MICRO_JMP) {
+        /* The block ended before an instruction that is not translated, or at its length */
+        if (count < BLOCK_LENGTH) {
+            emitExit(jit, "\xE9", 1, EXIT_INTERPRET, pc, 0, 0);
+        } else {
+            emitChain(jit, "\xE9", 1, pc);
+        }
+    }
+    emitExits(jit);
+    return block;
+}
+
+/**
+ * @brief Finds the block that starts at an address, translating it if there is none.
+ * @param jit The translator.
+ * @param machine The machine.
+ * @param pc The address.
+ * @return The block, or NULL if the instruction at the address is not translated.
+ */
+static unsigned char *findBlock(Jit *jit, Machine *machine, int pc) {
+    if (jit->blocks[pc] != NULL) {
+        return jit->blocks[pc];
+    }
+    setWritable(jit, true);
+    if (jit->used > JIT_BUFFER_SIZE - BLOCK_BYTES) {
+        flushJit(jit);
+    }
+    return translateBlock(jit, machine, pc);
+}
+
+/**
+ * @brief Runs the instruction at the pc of a machine in the interpreter.
+ * @param jit The translator, its blocks are dropped if red wrote a translated word.
+ * @param machine The machine.
+ * @param limit The step limit of the run.
+ * @return RUNNING if the run goes on, or how it ended.
+ */
+static int interpretOne(Jit *jit, Machine *machine, unsigned long limit) {
+    const MicroOp *op;
+    int at = -1, status;
+
+    if (machine->steps == limit) {
+        return MACHINE_OUT_OF_STEPS;
+    }
+    op = decodedOp(machine, machine->pc);
+    /* red is the only instruction left to the interpreter that writes */
+    if (op->kind == MICRO_RED_C) {
+        at = op->destination;
+    } else if (op->kind == MICRO_RED_I) {
+        at = machine->cells[op->destination] & ADDRESS_MASK;
+    }
+    status = stepMachine(machine, 1);
+    if (at >= 0 && at < MEMORY_SIZE && jit->guard[at]) {
+        flushJit(jit);
+    }
+    return status == MACHINE_OUT_OF_STEPS ? RUNNING : status;
+}
+
+/**
+ * @brief Runs the program of a machine from its pc, through blocks translated to x86-64.
+ *
+ * A block is translated the first time it is reached and is entered again
+ * through the jumps that are linked to it. What is not translated is run by
+ * the interpreter, one instruction at a time, and a write to a translated
+ * instruction drops every block.
+ *
+ * @param machine The machine, loaded by loadMachine.
+ * @param jit The translator.
+ * @return MACHINE_STOPPED, MACHINE_FAULT or MACHINE_OUT_OF_STEPS.
+ */
+int runJit(Machine *machine, Jit *jit) {
+    unsigned long limit = machine->step_limit != 0 ? machine->step_limit : ULONG_MAX;
+    unsigned long generation;
+    unsigned char *block;
+    JitContext context;
+    JitEntry enter;
+    int reason, status = RUNNING;
+
+    /* The object pointer is copied into the function pointer, ISO C has no conversion between them */
+    memcpy(&enter, &jit->buffer, sizeof(enter));
+    context.machine = machine;
+    context.guard = jit->guard;
+    while (status == RUNNING) {
+        block = findBlock(jit, machine, machine->pc);
+        if (block == NULL) {
+            status = interpretOne(jit, machine, limit);
+            continue;
+        }
+        context.budget = limit - machine->steps;
+        context.zero = machine->zero;
+        context.depth = machine->stack_depth;
+        setWritable(jit, false);
+        reason = enter(&context, block);
+        machine->steps = limit - context.budget;
+        machine->zero = context.zero != 0;
+        machine->stack_depth = context.depth;
+        machine->pc = context.pc;
+
+        if (reason == EXIT_BUDGET) {
+            status = stepMachine(machine, limit - machine->steps);
+        } else if (reason == EXIT_INTERPRET) {
+            status = interpretOne(jit, machine, limit);
+        } else if (reason == EXIT_STORE) {
+            markWritten(machine, context.at);
+            if (jit->guard[context.at]) {
+                flushJit(jit);
+            }
+        } else if (reason == EXIT_CHAIN) {
+            generation = jit->generation;
+            block = findBlock(jit, machine, machine->pc);
+            if (block != NULL && generation == jit->generation) {
+                setWritable(jit, true);
+                linkJump(jit, context.patch, (int)(block - jit->buffer));
+            }
+        }
+    }
+    return endRun(machine, status);
+}
+
+#else
+
+Jit *createJit(void) {
+    return NULL;
+}
+
+void freeJit(Jit *jit) {
+    (void)jit;
+}
+
+int runJit(Machine *machine, Jit *jit) {
+    (void)jit;
+    return runMachine(machine);
+}
+
+#endif
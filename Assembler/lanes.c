@@ -0,0 +1,668 @@
+/* open, lseek and close are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+#define LANES 16 /* Instances run in lockstep, one per lane of a row */
+#define ALL_LANES ((1U << LANES) - 1)
+
+/* A row holds one cell of every lane, and is worked on as one vector */
+#if defined(__GNUC__)
+typedef unsigned short LaneVector __attribute__((vector_size(LANES * sizeof(unsigned short))));
+#define VECTOR_LANES 1
+#endif
+
+/* One instance of the program, with its own input and output */
+typedef struct {
+    const char *name; /* The input file, the output is written to name.out */
+    SourceFile input;
+    int input_position;
+    TextBuffer output;
+    int status; /* How the run of the instance ended */
+    const char *fault;
+    int pc;
+    unsigned long steps;
+    bool scalar; /* It left its group and was finished by the interpreter */
+} Lane;
+
+/* Instances that run in lockstep: one pc, one stack, and every cell of theirs in a row */
+typedef struct {
+    unsigned short cells[(MEMORY_SIZE + REGISTER_COUNT) * LANES]; /* The memory and the registers, by row */
+    unsigned short zero[LANES]; /* The Z flag of every lane, all bits set or clear */
+    Lane *lanes[LANES];
+    unsigned int active; /* A bit for every lane that still runs in the group */
+    unsigned short active_row[LANES]; /* All bits set in the lanes that still run */
+    int leader; /* The first lane that still runs */
+    int width; /* The number of lanes that still run */
+    int pc;
+    int depth;
+    unsigned short stack[STACK_SIZE];
+    unsigned long steps;
+} LaneGroup;
+
+typedef struct {
+    const Machine *base; /* The program loaded and decoded, the lanes share its code and constants */
+    Machine *scalar; /* A lane that leaves its group is finished on it */
+    bool code_words[MEMORY_SIZE]; /* The words of the instructions decoded in the shared code */
+    unsigned long limit;
+    unsigned long lockstep_steps; /* Instructions run in lockstep, counted once for every lane */
+    unsigned long scalar_steps; /* Instructions run by lanes that left their group */
+} LaneRun;
+
+/**
+ * @brief Reads a cell of every lane into a row.
+ * @param run The run.
+ * @param group The group.
+ * @param cell The cell, a constant cell is the same in every lane.
+ * @param indirect Read the memory cell whose address is in the cell, the address of each lane.
+ * @param row The row.
+ */
+static void loadRow(const LaneRun *run, const LaneGroup *group, int cell, bool indirect, unsigned short *row) {
+    const unsigned short *cells = group->cells;
+    int lane;
+
+    if (cell >= CONSTANT_CELLS) {
+        for (lane = 0; lane < LANES; lane++) {
+            row[lane] = run->base->cells[cell];
+        }
+    } else if (!indirect) {
+        memcpy(row, cells + cell * LANES, LANES * sizeof(unsigned short));
+    } else {
+        for (lane = 0; lane < LANES; lane++) {
+            row[lane] = cells[(cells[cell * LANES + lane] & ADDRESS_MASK) * LANES + lane];
+        }
+    }
+}
+
+/**
+ * @brief Writes a row to a cell of every lane.
+ * @param group The group.
+ * @param cell The cell.
+ * @param indirect Write the memory cell whose address is in the cell, the address of each lane.
+ * @param row The row.
+ */
+static void storeRow(LaneGroup *group, int cell, bool indirect, const unsigned short *row) {
+    unsigned short *cells = group->cells;
+    int lane;
+
+    if (!indirect) {
+        memcpy(cells + cell * LANES, row, LANES * sizeof(unsigned short));
+        return;
+    }
+    for (lane = 0; lane < LANES; lane++) {
+        cells[(cells[cell * LANES + lane] & ADDRESS_MASK) * LANES + lane] = row[lane];
+    }
+}
+
+/**
+ * @brief Does an operation, mov to dec, on every lane at once.
+ * @param operation The first kind of the operation, the one with cell operands.
+ * @param target The destination of every lane.
+ * @param source The source of every lane, unused by the operations with one operand.
+ * @param result The value to write to the destination, unused by cmp.
+ * @param zero The Z flags, set by all but mov.
+ */
+static void laneOperation(int operation, const unsigned short *target, const unsigned short *source,
+                          unsigned short *result, unsigned short *zero) {
+#ifdef VECTOR_LANES
+    LaneVector a, b, r;
+
+    memcpy(&a, target, sizeof(a));
+    memcpy(&b, source, sizeof(b));
+    switch (operation) {
+    case MICRO_MOV_CC:
+        memcpy(result, &b, sizeof(b));
+        return;
+    case MICRO_CMP_CC:
+        r = (LaneVector)(a == b);
+        memcpy(zero, &r, sizeof(r));
+        return;
+    case MICRO_ADD_CC:
+        r = (a + b) & WORD_MASK;
+        break;
+    case MICRO_SUB_CC:
+        r = (a - b) & WORD_MASK;
+        break;
+    case MICRO_CLR_C:
+        r = a ^ a;
+        break;
+    case MICRO_NOT_C:
+        r = ~a & WORD_MASK;
+        break;
+    case MICRO_INC_C:
+        r = (a + 1) & WORD_MASK;
+        break;
+    default:
+        r = (a - 1) & WORD_MASK;
+    }
+    memcpy(result, &r, sizeof(r));
+    r = (LaneVector)(r == 0);
+    memcpy(zero, &r, sizeof(r));
+#else
+    int lane, value = 0;
+
+    for (lane = 0; lane < LANES; lane++) {
+        switch (operation) {
+        case MICRO_MOV_CC:
+            result[lane] = source[lane];
+            continue;
+        case MICRO_CMP_CC:
+            zero[lane] = target[lane] == source[lane] ? 0xFFFF : 0;
+            continue;
+        case MICRO_ADD_CC:
+            value = (target[lane] + source[lane]) & WORD_MASK;
+            break;
+        case MICRO_SUB_CC:
+            value = (target[lane] - source[lane]) & WORD_MASK;
+            break;
+        case MICRO_CLR_C:
+            value = 0;
+            break;
+        case MICRO_NOT_C:
+            value = ~target[lane] & WORD_MASK;
+            break;
+        case MICRO_INC_C:
+            value = (target[lane] + 1) & WORD_MASK;
+            break;
+        default:
+            value = (target[lane] - 1) & WORD_MASK;
+        }
+        result[lane] = (unsigned short)value;
+        zero[lane] = value == 0 ? 0xFFFF : 0;
+    }
+#endif
+}
+
+/**
+ * @brief Sets the lanes that run in a group.
+ * @param group The group.
+ * @param active A bit for every lane that runs.
+ */
+static void setActive(LaneGroup *group, unsigned int active) {
+    int lane;
+
+    group->active = active;
+    group->leader = LANES;
+    group->width = 0;
+    for (lane = LANES - 1; lane >= 0; lane--) {
+        group->active_row[lane] = active & (1U << lane) ? 0xFFFF : 0;
+        if (active & (1U << lane)) {
+            group->leader = lane;
+            group->width++;
+        }
+    }
+}
+
+/**
+ * @brief Tells if every lane that runs has the same value in a row.
+ *
+ * The lanes that left the group are still computed with it, so they are
+ * masked out.
+ *
+ * @param group The group, with at least one lane that runs.
+ * @param row The row.
+ * @return true if they do.
+ */
+static bool sameInLanes(const LaneGroup *group, const unsigned short *row) {
+#ifdef VECTOR_LANES
+    LaneVector values, active;
+    unsigned long words[sizeof(LaneVector) / sizeof(unsigned long)];
+    unsigned long differ = 0;
+    int i;
+
+    memcpy(&values, row, sizeof(values));
+    memcpy(&active, group->active_row, sizeof(active));
+    values = (values ^ row[group->leader]) & active;
+    memcpy(words, &values, sizeof(words));
+    for (i = 0; i < (int)(sizeof(words) / sizeof(words[0])); i++) {
+        differ |= words[i];
+    }
+    return differ == 0;
+#else
+    int lane;
+
+    for (lane = group->leader + 1; lane < LANES; lane++) {
+        if ((group->active & (1U << lane)) && row[lane] != row[group->leader]) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+/**
+ * @brief Finishes the run of a lane that leaves its group on the interpreter, from the pc of the group.
+ *
+ * The memory of the lane starts as the decoded program, and the words the
+ * lane changed are decoded again. The output so far is written to its file
+ * and the interpreter goes on writing there, and reading the input from
+ * where the lane got to.
+ *
+ * @param run The run.
+ * @param group The group.
+ * @param lane The lane.
+ */
+static void leaveGroup(LaneRun *run, LaneGroup *group, int lane) {
+    Machine *machine = run->scalar;
+    const Machine *base = run->base;
+    Lane *instance = group->lanes[lane];
+    char *output_name;
+    int address, output_fd;
+
+    memcpy(machine->code, base->code, sizeof(machine->code));
+    memcpy(machine->cells + CONSTANT_CELLS, base->cells + CONSTANT_CELLS, MEMORY_SIZE * sizeof(unsigned short));
+    for (address = 0; address < CONSTANT_CELLS; address++) {
+        machine->cells[address] = group->cells[address * LANES + lane];
+        if (address < MEMORY_SIZE && machine->cells[address] != base->cells[address]) {
+            markWritten(machine, address);
+        }
+    }
+    memcpy(machine->stack, group->stack, (size_t)group->depth * sizeof(unsigned short));
+    machine->stack_depth = group->depth;
+    machine->pc = group->pc;
+    machine->zero = group->zero[lane] != 0;
+    machine->steps = group->steps;
+    machine->fault = NULL;
+    machine->input_length = 0;
+    machine->input_position = 0;
+    machine->output_length = 0;
+
+    machine->input_fd = open(instance->name, O_RDONLY);
+    if (machine->input_fd != -1) {
+        lseek(machine->input_fd, instance->input_position, SEEK_SET);
+    }
+    output_name = outputName(instance->output.arena, instance->name, ".out");
+    remove(output_name);
+    output_fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd == -1) {
+        reportError("ERR: Failed to open file");
+    } else if (instance->output.length > 0 &&
+               write(output_fd, instance->output.chars, (size_t)instance->output.length) != instance->output.length) {
+        reportError("ERR: Failed to write file");
+    }
+    machine->output_fd = output_fd;
+
+    instance->status = stepMachine(machine, run->limit - machine->steps);
+    flushMachineOutput(machine);
+    instance->fault = machine->fault;
+    instance->pc = machine->pc;
+    instance->steps = machine->steps;
+    instance->scalar = true;
+    run->scalar_steps += machine->steps - group->steps;
+    if (machine->input_fd != -1) {
+        close(machine->input_fd);
+    }
+    if (output_fd != -1) {
+        close(output_fd);
+    }
+    setActive(group, group->active & ~(1U << lane));
+}
+
+/**
+ * @brief Finishes the lanes that leave their group on the interpreter, at the instruction the group is at.
+ * @param run The run.
+ * @param group The group.
+ * @param lanes A bit for every lane that leaves.
+ */
+static void leaveGroupLanes(LaneRun *run, LaneGroup *group, unsigned int lanes) {
+    int lane;
+
+    for (lane = 0; lane < LANES; lane++) {
+        if (lanes & group->active & (1U << lane)) {
+            leaveGroup(run, group, lane);
+        }
+    }
+}
+
+/**
+ * @brief Ends the run of the lanes that are still in the group, all the same way.
+ * @param group The group.
+ * @param status How they ended.
+ */
+static void endGroup(LaneGroup *group, int status) {
+    int lane;
+
+    for (lane = 0; lane < LANES; lane++) {
+        if (group->active & (1U << lane)) {
+            group->lanes[lane]->status = status;
+            group->lanes[lane]->fault = NULL;
+            group->lanes[lane]->pc = group->pc;
+            group->lanes[lane]->steps = group->steps;
+        }
+    }
+    setActive(group, 0);
+}
+
+/**
+ * @brief Counts the lanes of a mask.
+ * @param lanes A bit for every lane.
+ * @return The number of lanes.
+ */
+static int countLanes(unsigned int lanes) {
+    int count = 0;
+
+    for (; lanes != 0; lanes &= lanes - 1) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Keeps in the group the most lanes that go on to the same address, the others leave it.
+ * @param run The run.
+ * @param group The group.
+ * @param next The address every lane goes on to.
+ * @return The address the group goes on to.
+ */
+static int divergeGroup(LaneRun *run, LaneGroup *group, const unsigned short *next) {
+    unsigned int same, kept = 0;
+    int lane, other, best = 0;
+
+    /* Most of the time the whole group goes the same way */
+    if (sameInLanes(group, next)) {
+        return next[group->leader];
+    }
+    for (lane = 0; lane < LANES; lane++) {
+        if (!(group->active & (1U << lane)) || (kept & (1U << lane))) {
+            continue;
+        }
+        same = 0;
+        for (other = lane; other < LANES; other++) {
+            if ((group->active & (1U << other)) && next[other] == next[lane]) {
+                same |= 1U << other;
+            }
+        }
+        if (countLanes(same) > countLanes(kept)) {
+            kept = same;
+            best = lane;
+        }
+    }
+    if (kept != group->active) {
+        leaveGroupLanes(run, group, group->active & ~kept);
+    }
+    return next[best];
+}
+
+/**
+ * @brief Tells if an instruction writes to a word of the code in some lane.
+ *
+ * The lanes share the decoded code, so such an instruction is left to the
+ * interpreter of each lane. The data may be between the instructions, so
+ * the words are told apart one by one.
+ *
+ * @param run The run.
+ * @param group The group.
+ * @param op The micro-op.
+ * @return true if it does.
+ */
+static bool writesCode(const LaneRun *run, const LaneGroup *group, const MicroOp *op) {
+    int kind = op->kind;
+    int lane, address;
+
+    if (kind > MICRO_RED_I || (kind >= MICRO_CMP_CC && kind <= MICRO_CMP_II)) {
+        return false;
+    }
+    if (!(kind & 1)) {
+        return op->destination < MEMORY_SIZE && run->code_words[op->destination];
+    }
+    for (lane = 0; lane < LANES; lane++) {
+        address = group->cells[op->destination * LANES + lane] & ADDRESS_MASK;
+        if ((group->active & (1U << lane)) && run->code_words[address]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads a character of the input of a lane for red.
+ * @param instance The lane.
+ * @return The character, or -1 at the end of the input.
+ */
+static int readLane(Lane *instance) {
+    if (instance->input_position >= instance->input.length) {
+        return -1;
+    }
+    return (unsigned char)instance->input.text[instance->input_position++];
+}
+
+/**
+ * @brief Prints the operand of prn to the output of a lane.
+ * @param instance The lane.
+ * @param value The operand.
+ * @param numbers Print a decimal number and a newline, not a character.
+ */
+static void printLane(Lane *instance, int value, bool numbers) {
+    char text[MAX_NUMBER_DIGITS + 1];
+    int length;
+
+    if (numbers) {
+        length = formatDecimal(value & 0x4000 ? value - 0x8000 : value, 1, text);
+        text[length++] = '\n';
+    } else {
+        text[0] = (char)value;
+        length = 1;
+    }
+    appendText(&instance->output, text, length);
+}
+
+/**
+ * @brief Runs a group of lanes in lockstep, while they are at the same instruction.
+ *
+ * Every instruction is done once for the whole group, on rows of cells. A
+ * lane that goes to another address than the most of the group, and every
+ * lane at an instruction that faults or writes to the code, leaves the
+ * group and is finished by the interpreter.
+ *
+ * @param run The run.
+ * @param group The group, with its lanes loaded.
+ */
+static void runGroup(LaneRun *run, LaneGroup *group) {
+    const Machine *base = run->base;
+    unsigned short source[LANES], target[LANES], result[LANES], next[LANES];
+    const MicroOp *op;
+    bool numbers = base->print_numbers;
+    int kind, operation, lane, value;
+
+    while (group->active != 0) {
+        if (group->steps == run->limit) {
+            endGroup(group, MACHINE_OUT_OF_STEPS);
+            break;
+        }
+        op = &base->code[group->pc];
+        kind = op->kind;
+        /* What faults, and what was not decoded to an instruction, is left to the interpreter */
+        if (kind > MICRO_STOP ||
+            (kind == MICRO_JSR && group->depth == STACK_SIZE) || (kind == MICRO_RTS && group->depth == 0) ||
+            writesCode(run, group, op)) {
+            leaveGroupLanes(run, group, ALL_LANES);
+            break;
+        }
+
+        if (kind <= MICRO_DEC_I) {
+            operation = kind < MICRO_CLR_C ? kind & ~3 : kind & ~1;
+            if (kind < MICRO_CLR_C) {
+                loadRow(run, group, op->source, (kind & 2) != 0, source);
+            }
+            loadRow(run, group, op->destination, (kind & 1) != 0, target);
+            laneOperation(operation, target, source, result, group->zero);
+            if (operation != MICRO_CMP_CC) {
+                storeRow(group, op->destination, (kind & 1) != 0, result);
+            }
+            group->pc += op->size;
+        } else if (kind == MICRO_RED_C || kind == MICRO_RED_I) {
+            for (lane = 0; lane < LANES; lane++) {
+                result[lane] = group->active & (1U << lane) ? (unsigned short)(readLane(group->lanes[lane]) & WORD_MASK)
+                                                             : 0;
+            }
+            storeRow(group, op->destination, kind == MICRO_RED_I, result);
+            group->pc += op->size;
+        } else if (kind == MICRO_PRN_C || kind == MICRO_PRN_I) {
+            loadRow(run, group, op->destination, kind == MICRO_PRN_I, target);
+            for (lane = 0; lane < LANES; lane++) {
+                if (group->active & (1U << lane)) {
+                    printLane(group->lanes[lane], target[lane], numbers);
+                }
+            }
+            group->pc += op->size;
+        } else if (kind == MICRO_RTS) {
+            group->pc = group->stack[--group->depth];
+        } else if (kind == MICRO_STOP) {
+            group->steps++;
+            run->lockstep_steps += (unsigned long)group->width;
+            endGroup(group, MACHINE_STOPPED);
+            break;
+        } else {
+            /* jmp, bne and jsr, to a label or to the address in a register of each lane */
+            if (op->destination >= CONSTANT_CELLS && (kind != MICRO_BNE || sameInLanes(group, group->zero))) {
+                /* To a label, and every lane jumps or none does */
+                value = kind == MICRO_BNE && group->zero[group->leader] ? group->pc + op->size
+                                                                        : base->cells[op->destination] & ADDRESS_MASK;
+            } else {
+                loadRow(run, group, op->destination, false, target);
+                for (lane = 0; lane < LANES; lane++) {
+                    value = target[lane] & ADDRESS_MASK;
+                    next[lane] = (unsigned short)(kind == MICRO_BNE && group->zero[lane] ? group->pc + op->size
+                                                                                         : value);
+                }
+                value = divergeGroup(run, group, next);
+            }
+            if (kind == MICRO_JSR) {
+                group->stack[group->depth++] = (unsigned short)(group->pc + op->size);
+            }
+            group->pc = value;
+        }
+        group->steps++;
+        run->lockstep_steps += (unsigned long)group->width;
+    }
+}
+
+/**
+ * @brief Runs one program over many inputs, LANES instances at a time in lockstep.
+ *
+ * Every instance reads its own input file with red, and what it prints with
+ * prn is written to the input name with ".out" added. The instances of a
+ * group do every instruction together, on a row of cells at a time, for as
+ * long as they take the same jumps; an instance that goes its own way is
+ * finished alone by the interpreter. How an instance ended, if not by stop,
+ * is reported after its name.
+ *
+ * @param base The machine with the program loaded, it is not run.
+ * @param names The input files.
+ * @param count The number of input files.
+ * @param statistics Print how many instructions were run in lockstep and alone, and how long it took.
+ * @return 0 if every instance stopped and 1 otherwise.
+ */
+int runLanes(const Machine *base, char **names, int count, bool statistics) {
+    LaneGroup *group = (LaneGroup *)malloc(sizeof(LaneGroup));
+    Lane *lanes = (Lane *)malloc((size_t)count * sizeof(Lane));
+    LaneRun run;
+    Arena arena;
+    Lane *instance;
+    clock_t start = clock();
+    double seconds;
+    unsigned int opened;
+    int first, lane, cell, address, failed = 0;
+
+    run.scalar = (Machine *)malloc(sizeof(Machine));
+    if (group == NULL || lanes == NULL || run.scalar == NULL) {
+        perror("ERR: Unable to allocate memory for the lanes");
+        free(group);
+        free(lanes);
+        free(run.scalar);
+        return 1;
+    }
+    initMachine(run.scalar, -1, -1);
+    run.scalar->print_numbers = base->print_numbers;
+    run.base = base;
+    /* A write to a word of a decoded instruction would leave the shared code stale */
+    memset(run.code_words, 0, sizeof(run.code_words));
+    for (address = 0; address < MEMORY_SIZE; address++) {
+        if (base->code[address].kind <= MICRO_STOP) {
+            memset(run.code_words + address, true, base->code[address].size);
+        }
+    }
+    run.limit = base->step_limit != 0 ? base->step_limit : ULONG_MAX;
+    run.lockstep_steps = 0;
+    run.scalar_steps = 0;
+    initArena(&arena, ARENA_SIZE);
+
+    for (first = 0; first < count; first += LANES) {
+        resetArena(&arena);
+        opened = 0;
+        for (lane = 0; lane < LANES && first + lane < count; lane++) {
+            instance = &lanes[first + lane];
+            instance->name = names[first + lane];
+            instance->input_position = 0;
+            instance->output.chars = NULL;
+            instance->output.length = 0;
+            instance->output.capacity = 0;
+            instance->output.arena = &arena;
+            instance->scalar = false;
+            if (openSource(&instance->input, instance->name, &arena) == 1) {
+                report("ERR: '%s' does not exist\n", instance->name);
+                failed = 1;
+                continue;
+            }
+            group->lanes[lane] = instance;
+            opened |= 1U << lane;
+        }
+        setActive(group, opened);
+        /* Every lane starts from the loaded memory and registers */
+        for (cell = 0; cell < CONSTANT_CELLS; cell++) {
+            for (lane = 0; lane < LANES; lane++) {
+                group->cells[cell * LANES + lane] = base->cells[cell];
+            }
+        }
+        for (lane = 0; lane < LANES; lane++) {
+            group->zero[lane] = base->zero ? 0xFFFF : 0;
+        }
+        group->pc = base->pc;
+        group->depth = base->stack_depth;
+        memcpy(group->stack, base->stack, (size_t)base->stack_depth * sizeof(unsigned short));
+        group->steps = base->steps;
+
+        runGroup(&run, group);
+
+        for (lane = 0; lane < LANES && first + lane < count; lane++) {
+            instance = &lanes[first + lane];
+            if (!(opened & (1U << lane))) {
+                continue;
+            }
+            if (!instance->scalar) {
+                writeTextFile(outputName(&arena, instance->name, ".out"), instance->output.chars,
+                              instance->output.length);
+            }
+            closeSource(&instance->input);
+            if (instance->status == MACHINE_FAULT && instance->fault != NULL) {
+                report("%s: ", instance->name);
+                report(instance->fault, instance->pc);
+            } else if (instance->status == MACHINE_OUT_OF_STEPS) {
+                report("%s: ERR: the program was stopped after %lu instructions\n", instance->name,
+                       instance->steps);
+            }
+            if (instance->status != MACHINE_STOPPED) {
+                failed = 1;
+            }
+        }
+    }
+
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (statistics) {
+        fprintf(stderr, "%d runs, %lu instructions in lockstep and %lu alone in %.3f seconds", count,
+                run.lockstep_steps, run.scalar_steps, seconds);
+        if (seconds > 0) {
+            fprintf(stderr, ", %.1f million per second", (run.lockstep_steps + run.scalar_steps) / seconds / 1e6);
+        }
+        fprintf(stderr, "\n");
+    }
+    freeArena(&arena);
+    free(run.scalar);
+    free(lanes);
+    free(group);
+    return failed;
+}
@@ -0,0 +1,338 @@
+/* mmap, open, fstat and mkstemp are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/**
+ * @brief Opens a source file and maps it into memory.
+ *
+ * The text is read in place, nothing is copied. If the file can't be mapped
+ * (an empty file, or a file system without mmap), it is read into the arena.
+ * The text is not null terminated, it ends at text + length.
+ *
+ * @param source The source file to fill.
+ * @param name_of_file The name of the source file.
+ * @param arena The per-file arena, used only if the file can't be mapped.
+ * @return 0 if succeded and 1 if the file can't be opened.
+ */
+int openSource(SourceFile *source, const char *name_of_file, Arena *arena) {
+    struct stat info;
+    int fd;
+    void *mapping;
+    char *text;
+    ssize_t count;
+    size_t total = 0;
+
+    fd = open(name_of_file, O_RDONLY);
+    if (fd == -1) {
+        return 1;
+    }
+    if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode) || info.st_size > INT_MAX) {
+        close(fd);
+        return 1;
+    }
+    source->length = (int)info.st_size;
+    source->mapped = false;
+
+    if (source->length > 0) {
+        mapping = mmap(NULL, (size_t)source->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            source->text = (const char *)mapping;
+            source->mapped = true;
+            close(fd);
+            return 0;
+        }
+    }
+
+    text = (char *)arenaAlloc(arena, (size_t)source->length + 1);
+    while (total < (size_t)source->length &&
+           (count = read(fd, text + total, (size_t)source->length - total)) > 0) {
+        total += (size_t)count;
+    }
+    source->text = text;
+    source->length = (int)total;
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief Releases the mapping of a source file.
+ * @param source The source file opened by openSource.
+ */
+void closeSource(SourceFile *source) {
+    if (source->mapped) {
+        munmap((void *)source->text, (size_t)source->length);
+        source->mapped = false;
+    }
+}
+
+/**
+ * @brief Replaces a file with a new text, at once.
+ *
+ * The text is written to a new file next to it, which is then renamed over
+ * the old one. A reader that mapped the old file keeps it, and no reader
+ * ever sees a file that is half written.
+ *
+ * @param name_of_file The name of the file.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return 0 if succeded and 1 otherwise.
+ */
+int replaceFile(const char *name_of_file, const char *text, int length) {
+    char *temporary = (char *)malloc(strlen(name_of_file) + sizeof(".XXXXXX"));
+    ssize_t count;
+    int fd, written = 0;
+
+    if (temporary == NULL) {
+        perror("ERR: Unable to allocate memory for a file name");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(temporary, name_of_file);
+    strcat(temporary, ".XXXXXX");
+    fd = mkstemp(temporary);
+    if (fd == -1) {
+        reportError("ERR: Failed to open file");
+        free(temporary);
+        return 1;
+    }
+    fchmod(fd, 0644);
+    while (written < length && (count = write(fd, text + written, (size_t)(length - written))) > 0) {
+        written += (int)count;
+    }
+    if (close(fd) == -1 || written < length || rename(temporary, name_of_file) == -1) {
+        reportError("ERR: Failed to write file");
+        unlink(temporary);
+        free(temporary);
+        return 1;
+    }
+    free(temporary);
+    return 0;
+}
+
+/* The bits of a mask that belong to a block */
+#define BLOCK_BITS 0xFFFFFFFFU
+
+/**
+ * @brief Gives back the index of the lowest set bit of a mask that is not 0.
+ * @param mask The mask.
+ * @return The index of the bit.
+ */
+static int lowestBit(unsigned int mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1U)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * @brief Gives back the index of the highest set bit of a mask that is not 0.
+ * @param mask The mask, only its lower SCAN_BLOCK bits may be set.
+ * @return The index of the bit.
+ */
+static int highestBit(unsigned int mask) {
+#ifdef __GNUC__
+    return (int)(sizeof(unsigned int) * CHAR_BIT) - 1 - __builtin_clz(mask);
+#else
+    int bit = 0;
+    while (mask >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * @brief Gives back the masks of a set of delimiters.
+ * @param scan The scan of the text.
+ * @param delimiters SPACES, COMMAS, SPACES | COMMAS or NEWLINES.
+ * @return The masks, one per block.
+ */
+static const unsigned int *delimiterMasks(const Scan *scan, int delimiters) {
+    switch (delimiters) {
+        case SPACES:
+            return scan->spaces;
+        case COMMAS:
+            return scan->commas;
+        case NEWLINES:
+            return scan->newlines;
+        default:
+            return scan->separators;
+    }
+}
+
+/**
+ * @brief Finds the first character in a range that is a delimiter, or that is not one.
+ * @param masks The delimiter masks of the text.
+ * @param from The position the range starts at.
+ * @param to The position the range ends before.
+ * @param flip 0 to find a delimiter and BLOCK_BITS to find another character.
+ * @return The position of the character, or to if there is none.
+ */
+static int findFirst(const unsigned int *masks, int from, int to, unsigned int flip) {
+    int block = from / SCAN_BLOCK;
+    unsigned int mask;
+    int position;
+
+    if (from >= to) {
+        return to;
+    }
+    mask = (masks[block] ^ flip) & (BLOCK_BITS << (from % SCAN_BLOCK));
+    while (mask == 0) {
+        block++;
+        if (block * SCAN_BLOCK >= to) {
+            return to;
+        }
+        mask = masks[block] ^ flip;
+    }
+    position = block * SCAN_BLOCK + lowestBit(mask);
+    return position < to ? position : to;
+}
+
+/**
+ * @brief Finds the last character in a range that is a delimiter, or that is not one.
+ * @param masks The delimiter masks of the text.
+ * @param from The position the range starts at.
+ * @param to The position the range ends before.
+ * @param flip 0 to find a delimiter and BLOCK_BITS to find another character.
+ * @return The position of the character, or from - 1 if there is none.
+ */
+static int findLast(const unsigned int *masks, int from, int to, unsigned int flip) {
+    int block = (to - 1) / SCAN_BLOCK;
+    unsigned int mask;
+    int position;
+
+    if (from >= to) {
+        return from - 1;
+    }
+    mask = (masks[block] ^ flip) & (BLOCK_BITS >> (SCAN_BLOCK - 1 - (to - 1) % SCAN_BLOCK));
+    while (mask == 0) {
+        block--;
+        if (block < 0 || (block + 1) * SCAN_BLOCK <= from) {
+            return from - 1;
+        }
+        mask = masks[block] ^ flip;
+    }
+    position = block * SCAN_BLOCK + highestBit(mask);
+    return position >= from ? position : from - 1;
+}
+
+/**
+ * @brief Gives back the next line of a scanned text as a view, without its newline.
+ * @param scan The scan of the text.
+ * @param cursor The position in the text, moved past the line and its newline.
+ * @param line The view of the line.
+ * @return 1 if a line was found and 0 at the end of the text.
+ */
+int nextLine(const Scan *scan, const char **cursor, Span *line) {
+    int start = (int)(*cursor - scan->text);
+    int newline;
+
+    if (start >= scan->length) {
+        return 0;
+    }
+    newline = findFirst(scan->newlines, start, scan->length, 0);
+    line->start = *cursor;
+    line->length = newline - start;
+    *cursor = scan->text + (newline < scan->length ? newline + 1 : newline);
+    return 1;
+}
+
+/**
+ * @brief Removes the whitespace at both ends of a view.
+ * @param scan The scan of the text the view is in.
+ * @param span The view to trim.
+ * @return The trimmed view.
+ */
+Span trimSpan(const Scan *scan, Span span) {
+    int from = (int)(span.start - scan->text);
+    int to = from + span.length;
+    unsigned int mask = (scan->spaces[from / SCAN_BLOCK] ^ BLOCK_BITS) >> (from % SCAN_BLOCK);
+    int first, last;
+
+    first = mask != 0 ? from + lowestBit(mask) : findFirst(scan->spaces, from, to, BLOCK_BITS);
+    if (first > to) {
+        first = to;
+    }
+    last = findLast(scan->spaces, first, to, BLOCK_BITS);
+
+    span.start = scan->text + first;
+    span.length = last + 1 - first;
+    return span;
+}
+
+/**
+ * @brief Takes the next token of a view, the way strtok does but without changing the text.
+ *
+ * Leading delimiters are skipped, the token ends at the next delimiter, and
+ * the rest of the view starts right after that delimiter.
+ *
+ * @param scan The scan of the text the view is in.
+ * @param rest The part of the text that was not read yet, moved past the token.
+ * @param delimiters The characters that separate tokens: SPACES, COMMAS, or both.
+ * @param token The view of the token.
+ * @return 1 if a token was found and 0 if only delimiters were left.
+ */
+int nextToken(const Scan *scan, Span *rest, int delimiters, Span *token) {
+    int from = (int)(rest->start - scan->text);
+    int to = from + rest->length;
+    const unsigned int *masks = delimiterMasks(scan, delimiters);
+    unsigned int mask;
+    int start, end;
+
+    /* Tokens are short, so the common case is answered by the block of the start alone */
+    mask = (masks[from / SCAN_BLOCK] ^ BLOCK_BITS) >> (from % SCAN_BLOCK);
+    start = mask != 0 ? from + lowestBit(mask) : findFirst(masks, from, to, BLOCK_BITS);
+    if (start >= to) {
+        rest->start = scan->text + to;
+        rest->length = 0;
+        return 0;
+    }
+    mask = masks[start / SCAN_BLOCK] >> (start % SCAN_BLOCK);
+    end = mask != 0 ? start + lowestBit(mask) : findFirst(masks, start, to, 0);
+    if (end > to) {
+        end = to;
+    }
+    token->start = scan->text + start;
+    token->length = end - start;
+    if (end < to) {
+        end++; /* Skip the delimiter that ended the token */
+    }
+    rest->start = scan->text + end;
+    rest->length = to - end;
+    return 1;
+}
+
+/**
+ * @brief Finds the first delimiter in a view.
+ * @param scan The scan of the text the view is in.
+ * @param span The view.
+ * @param delimiters The delimiters to look for.
+ * @return A pointer to the delimiter, or NULL if the view has none.
+ */
+const char *findDelimiter(const Scan *scan, Span span, int delimiters) {
+    int from = (int)(span.start - scan->text);
+    int position = findFirst(delimiterMasks(scan, delimiters), from, from + span.length, 0);
+
+    return position < from + span.length ? scan->text + position : NULL;
+}
+
+/**
+ * @brief Compares a view with a string.
+ * @param span The view.
+ * @param str The null terminated string.
+ * @return 1 if they hold the same text and 0 otherwise.
+ */
+int spanEquals(Span span, const char *str) {
+    return strncmp(span.start, str, (size_t)span.length) == 0 && str[span.length] == '\0';
+}
@@ -0,0 +1,176 @@
+/* open_memstream and pthread_once are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include "HEDER.h"
+#include "assembler.h"
+
+struct AssemblerContext {
+    Arena arena; /* Reset for every source */
+    Arena library_arena; /* Kept for the macro libraries of the context */
+    LibraryCache libraries;
+    char *diagnostics; /* The messages of the last source, from open_memstream */
+    size_t diagnostics_length;
+};
+
+static pthread_once_t scanner_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Creates a context, with its own arenas and macro libraries.
+ * @return The context, or NULL if there is no memory for it.
+ */
+AssemblerContext *createAssembler(void) {
+    AssemblerContext *context = (AssemblerContext *)malloc(sizeof(AssemblerContext));
+
+    if (context == NULL) {
+        return NULL;
+    }
+    /* The scanner kernel is picked once for the whole process */
+    pthread_once(&scanner_once, initScanner);
+    initArena(&context->arena, ARENA_SIZE);
+    initArena(&context->library_arena, ARENA_SIZE);
+    initLibraryCache(&context->libraries, &context->library_arena, false);
+    context->diagnostics = NULL;
+    context->diagnostics_length = 0;
+    return context;
+}
+
+/**
+ * @brief Copies the symbols, entries and externs of an assembled source into the result.
+ * @param program The program after the second pass.
+ * @param object The object of the program.
+ * @param result The result to fill.
+ */
+static void fillSymbols(const Program *program, const ObjectImage *object, AsmResult *result) {
+    const SymbolTable *symbols = &program->symbols;
+    AsmSymbol *labels;
+    AsmReference *entries, *externs;
+    int i;
+
+    labels = (AsmSymbol *)arenaAlloc(program->arena, (symbols->count + 1) * sizeof(AsmSymbol));
+    for (i = 0; i < symbols->count; i++) {
+        labels[i].name = symbols->names + symbols->symbols[i].name;
+        labels[i].address = symbols->symbols[i].address;
+        labels[i].flags = symbols->symbols[i].flags;
+    }
+    entries = (AsmReference *)arenaAlloc(program->arena, (object->export_count + 1) * sizeof(AsmReference));
+    for (i = 0; i < object->export_count; i++) {
+        entries[i].name = object->names + object->exports[i].name;
+        entries[i].address = object->exports[i].address;
+    }
+    externs = (AsmReference *)arenaAlloc(program->arena, (object->extern_count + 1) * sizeof(AsmReference));
+    for (i = 0; i < object->extern_count; i++) {
+        externs[i].name = object->names + object->externs[i].name;
+        externs[i].address = object->externs[i].address;
+    }
+    result->symbols = labels;
+    result->symbol_count = symbols->count;
+    result->entries = entries;
+    result->entry_count = object->export_count;
+    result->externs = externs;
+    result->extern_count = object->extern_count;
+}
+
+/**
+ * @brief Marks every word of the image as code or data.
+ *
+ * The data is laid out in source order, between the instructions, so the
+ * kind of a word comes from the line it was made by.
+ *
+ * @param program The program after the second pass.
+ * @param object The object of the program.
+ * @param result The result to fill.
+ */
+static void fillKinds(const Program *program, const ObjectImage *object, AsmResult *result) {
+    const LineTable *lines = &program->lines;
+    unsigned char *kinds;
+    int i, k, at;
+    int count = object->ic + object->dc;
+
+    kinds = (unsigned char *)arenaAlloc(program->arena, count + 1);
+    memset(kinds, ASM_WORD_DATA, count + 1);
+    for (i = 0; i < lines->count; i++) {
+        if (lines->opcode_value[i] == -1) {
+            continue;
+        }
+        for (k = 0; k < lines->memory_cells[i]; k++) {
+            at = lines->memory_value[i] + k - MIN_MEM_VAL;
+            if (at >= 0 && at < count) {
+                kinds[at] = ASM_WORD_CODE;
+            }
+        }
+    }
+    result->words = object->words;
+    result->kinds = kinds;
+    result->word_count = count;
+    result->code_length = object->ic;
+    result->data_length = object->dc;
+}
+
+/**
+ * @brief Assembles a source buffer into memory.
+ *
+ * The passes are those of the assembler, but the outputs are kept in the
+ * context instead of being written, and the messages of the source are
+ * collected into the result instead of being printed.
+ *
+ * @param context The context, the result of its previous source is released.
+ * @param source The source, not null terminated and never modified.
+ * @param length The length of the source.
+ * @param result The result, it points into the context.
+ * @return 0 if the source was assembled and 1 if it has errors.
+ */
+int assembleSource(AssemblerContext *context, const char *source, int length, AsmResult *result) {
+    FILE *messages;
+    SourceFile file;
+    Span expanded;
+    Program program;
+    ObjectImage object;
+
+    resetArena(&context->arena);
+    free(context->diagnostics);
+    context->diagnostics = NULL;
+    context->diagnostics_length = 0;
+    messages = open_memstream(&context->diagnostics, &context->diagnostics_length);
+    if (messages == NULL) {
+        perror("ERR: Unable to allocate memory for the diagnostics");
+        exit(EXIT_FAILURE);
+    }
+    setDiagnostics(messages, messages);
+
+    memset(result, 0, sizeof(AsmResult));
+    file.text = source;
+    file.length = length;
+    file.mapped = false;
+    if (preAss(&file, &context->libraries, &context->arena, &expanded) == 1) {
+        report("ERR:Error at macro processing\n");
+        result->errors = 1;
+    } else {
+        initProgram(&program, &context->arena);
+        processInputFile(expanded, &program);
+        result->errors = encodeProgram(&program, &object);
+        fillKinds(&program, &object, result);
+        fillSymbols(&program, &object, result);
+    }
+
+    setDiagnostics(NULL, NULL);
+    fclose(messages);
+    result->diagnostics = context->diagnostics ? context->diagnostics : "";
+    result->diagnostics_length = (int)context->diagnostics_length;
+    return result->errors;
+}
+
+/**
+ * @brief Frees a context and everything it assembled.
+ * @param context The context, or NULL.
+ */
+void destroyAssembler(AssemblerContext *context) {
+    if (context == NULL) {
+        return;
+    }
+    freeLibraryCache(&context->libraries);
+    freeArena(&context->library_arena);
+    freeArena(&context->arena);
+    free(context->diagnostics);
+    free(context);
+}
@@ -0,0 +1,611 @@
+/* read and write are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stddef.h>
+#include <limits.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/* The handlers are reached through a table of label addresses, a GCC extension */
+#if defined(__GNUC__)
+#define COMPUTED_GOTO 1
+#endif
+
+#define LEA_OPCODE 4
+
+/* What decodeOperand gives back for a word the instruction can't use */
+#define OPERAND_ILLEGAL -1
+#define OPERAND_EXTERN -2
+
+/* The first kind of every opcode, its variants follow it */
+static const unsigned char first_kinds[16] = {
+    MICRO_MOV_CC, MICRO_CMP_CC, MICRO_ADD_CC, MICRO_SUB_CC, MICRO_MOV_CC,
+    MICRO_CLR_C, MICRO_NOT_C, MICRO_INC_C, MICRO_DEC_C,
+    MICRO_JMP, MICRO_BNE, MICRO_RED_C, MICRO_PRN_C, MICRO_JSR,
+    MICRO_RTS, MICRO_STOP
+};
+
+/* The method of the 4 method bits of a first word field, -1 for no operand and -2 if more than one is set */
+static const signed char field_methods[16] = {
+    -1, IMMEDIATE, DIRECT, -2, INDIRECT_REGISTER, -2, -2, -2,
+    DIRECT_REGISTER, -2, -2, -2, -2, -2, -2, -2
+};
+
+/**
+ * @brief Sets a machine up with no program, reading and printing through two files.
+ * @param machine The machine.
+ * @param input_fd The file red reads from.
+ * @param output_fd The file prn prints to.
+ */
+void initMachine(Machine *machine, int input_fd, int output_fd) {
+    int address;
+
+    memset(machine->cells, 0, sizeof(machine->cells));
+    for (address = 0; address <= MEMORY_SIZE; address++) {
+        machine->code[address].kind = MICRO_DECODE;
+        machine->code[address].size = 1;
+        machine->code[address].source = 0;
+        machine->code[address].destination = 0;
+    }
+    machine->code[MEMORY_SIZE].kind = MICRO_END;
+    machine->stack_depth = 0;
+    machine->pc = MIN_MEM_VAL;
+    machine->zero = false;
+    machine->steps = 0;
+    machine->step_limit = 0;
+    machine->fault = NULL;
+    machine->print_numbers = false;
+    machine->input_fd = input_fd;
+    machine->output_fd = output_fd;
+    machine->input_length = 0;
+    machine->input_position = 0;
+    machine->output_length = 0;
+    memset(machine->dirty, 0, sizeof(machine->dirty));
+}
+
+/**
+ * @brief Puts the words of an object in memory, from MIN_MEM_VAL, and decodes every address.
+ * @param machine The machine, set up by initMachine.
+ * @param object The object.
+ * @return 0 if succeded and 1 if the program does not fit in memory.
+ */
+int loadMachine(Machine *machine, const ObjectImage *object) {
+    int count = object->ic + object->dc;
+    int address;
+
+    if (count > MEMORY_SIZE - MIN_MEM_VAL) {
+        report("ERR: the program takes %d words and the memory holds %d\n", count, MEMORY_SIZE - MIN_MEM_VAL);
+        return 1;
+    }
+    memset(machine->cells, 0, sizeof(machine->cells));
+    for (address = 0; address < count; address++) {
+        machine->cells[MIN_MEM_VAL + address] = (unsigned short)(object->words[address] & WORD_MASK);
+    }
+    /* Every word is decoded as if it started an instruction, data words decode to illegal ones */
+    for (address = 0; address < MEMORY_SIZE; address++) {
+        decodeInstruction(machine, address);
+    }
+    machine->stack_depth = 0;
+    machine->pc = MIN_MEM_VAL;
+    machine->zero = false;
+    machine->steps = 0;
+    return 0;
+}
+
+/**
+ * @brief Decodes the extra word of an operand into the cell the instruction uses.
+ *
+ * The value of an immediate, and the address of a label that is jumped to or
+ * loaded by lea, is kept in the constant cell of the word. It depends only on
+ * the word, so instructions that share the word never disagree on it.
+ *
+ * @param machine The machine.
+ * @param method The addressing method of the operand.
+ * @param at The address of the word.
+ * @param shift The position of the register field, 6 for a source and 3 for a destination.
+ * @param address The instruction takes the address of the operand, not its value.
+ * @param indirect Set if the cell holds the address of the operand.
+ * @return The cell, OPERAND_ILLEGAL or OPERAND_EXTERN.
+ */
+static int decodeOperand(Machine *machine, int method, int at, int shift, bool address, bool *indirect) {
+    int word = machine->cells[at];
+    int value = word >> 3;
+
+    *indirect = false;
+    if (method == IMMEDIATE) {
+        if ((word & 7) != A) {
+            return OPERAND_ILLEGAL;
+        }
+        machine->cells[CONSTANT_CELLS + at] = (unsigned short)(value & 0x800 ? value | 0x7000 : value);
+        return CONSTANT_CELLS + at;
+    }
+    if (method == DIRECT) {
+        if ((word & 7) == E) {
+            return OPERAND_EXTERN;
+        }
+        if ((word & 7) != R) {
+            return OPERAND_ILLEGAL;
+        }
+        if (!address) {
+            return value;
+        }
+        machine->cells[CONSTANT_CELLS + at] = (unsigned short)value;
+        return CONSTANT_CELLS + at;
+    }
+    if ((word & ~(7 << shift)) != A) {
+        return OPERAND_ILLEGAL;
+    }
+    /* A jump to *r goes to the address in r, so r is read as it is */
+    *indirect = method == INDIRECT_REGISTER && !address;
+    return REGISTER_CELLS + ((word >> shift) & 7);
+}
+
+/**
+ * @brief Decodes the instruction that starts at an address into its micro-op.
+ *
+ * The opcode, the methods, the register fields and the A/R/E fields are read
+ * once, and checked against the opcode table the way the assembler encodes
+ * them, so every word that the assembler would not make is illegal.
+ *
+ * @param machine The machine.
+ * @param address The address.
+ */
+void decodeInstruction(Machine *machine, int address) {
+    MicroOp *op = &machine->code[address];
+    int word = machine->cells[address];
+    int opcode = word >> 11;
+    int source_method = field_methods[(word >> 7) & 0xF];
+    int destination_method = field_methods[(word >> 3) & 0xF];
+    int kind = first_kinds[opcode];
+    bool jump = kind == MICRO_JMP || kind == MICRO_BNE || kind == MICRO_JSR;
+    bool source_indirect = false, destination_indirect = false;
+    int source = 0, destination = 0;
+    int registers;
+    InstructionForm form;
+
+    op->kind = MICRO_ILLEGAL;
+    op->size = 1;
+    op->source = 0;
+    op->destination = 0;
+    if (source_method == -2 || destination_method == -2) {
+        return;
+    }
+    form = getInstructionForm(opcode, source_method, destination_method);
+    if (!form.legal || form.first_word != word || address + form.words > MEMORY_SIZE) {
+        return;
+    }
+
+    if (source_method >= INDIRECT_REGISTER && destination_method >= INDIRECT_REGISTER) {
+        /* Two register operands share one word */
+        registers = machine->cells[address + 1];
+        if ((registers & ~(077 << 3)) != A) {
+            return;
+        }
+        source = REGISTER_CELLS + ((registers >> 6) & 7);
+        destination = REGISTER_CELLS + ((registers >> 3) & 7);
+        source_indirect = source_method == INDIRECT_REGISTER;
+        destination_indirect = destination_method == INDIRECT_REGISTER;
+    } else {
+        if (source_method != -1) {
+            source = decodeOperand(machine, source_method, address + 1, 6, opcode == LEA_OPCODE, &source_indirect);
+        }
+        if (destination_method != -1) {
+            destination = decodeOperand(machine, destination_method, address + form.words - 1, 3, jump,
+                                        &destination_indirect);
+        }
+    }
+    if (source == OPERAND_EXTERN || destination == OPERAND_EXTERN) {
+        op->kind = MICRO_EXTERN;
+        return;
+    }
+    if (source == OPERAND_ILLEGAL || destination == OPERAND_ILLEGAL) {
+        return;
+    }
+
+    if (getOperandCount(opcode) == 2) {
+        kind += 2 * source_indirect + destination_indirect;
+    } else if (destination_method != -1 && !jump) {
+        kind += destination_indirect;
+    }
+    op->kind = (unsigned char)kind;
+    op->size = (unsigned char)form.words;
+    op->source = (unsigned short)source;
+    op->destination = (unsigned short)destination;
+}
+
+/**
+ * @brief Reads more of the input of red, printing what prn buffered first so a prompt is seen.
+ * @param machine The machine, its input buffer is used up.
+ * @return The next character, or -1 at the end of the input.
+ */
+int fillMachineInput(Machine *machine) {
+    ssize_t length;
+
+    flushMachineOutput(machine);
+    do {
+        length = read(machine->input_fd, machine->input, sizeof(machine->input));
+    } while (length == -1 && errno == EINTR);
+    machine->input_position = 0;
+    machine->input_length = length > 0 ? (int)length : 0;
+    if (machine->input_length == 0) {
+        return -1;
+    }
+    return (unsigned char)machine->input[machine->input_position++];
+}
+
+/**
+ * @brief Writes what prn buffered.
+ * @param machine The machine.
+ */
+void flushMachineOutput(Machine *machine) {
+    ssize_t written;
+    int offset = 0;
+
+    while (offset < machine->output_length) {
+        written = write(machine->output_fd, machine->output + offset, (size_t)(machine->output_length - offset));
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            reportError("ERR: Failed to write the output of the program");
+            break;
+        }
+        offset += (int)written;
+    }
+    machine->output_length = 0;
+}
+
+/**
+ * @brief Prints the operand of prn, as a character or as a decimal number and a newline.
+ * @param machine The machine.
+ * @param value The operand, 15 bits.
+ */
+static void printValue(Machine *machine, int value) {
+    if (machine->output_length > MACHINE_BUFFER_SIZE - MAX_NUMBER_DIGITS - 1) {
+        flushMachineOutput(machine);
+    }
+    if (machine->print_numbers) {
+        machine->output_length += formatDecimal(value & 0x4000 ? value - 0x8000 : value, 1,
+                                                machine->output + machine->output_length);
+        machine->output[machine->output_length++] = '\n';
+    } else {
+        machine->output[machine->output_length++] = (char)value;
+    }
+}
+
+/* The cell an operand is read from or written to */
+#define CELL(index) (index)
+#define INDIRECT(index) (cells[index] & ADDRESS_MASK)
+
+/* A write to memory may change an instruction that starts up to two words before it */
+#define STORE(at, value) \
+    do { \
+        cells[at] = (unsigned short)(value); \
+        if ((at) < MEMORY_SIZE) { \
+            dirty[(at) >> MACHINE_PAGE_SHIFT] = 1; \
+            code[at].kind = MICRO_DECODE; \
+            if ((at) >= 2) { \
+                code[(at) - 1].kind = MICRO_DECODE; \
+                code[(at) - 2].kind = MICRO_DECODE; \
+            } else if ((at) == 1) { \
+                code[0].kind = MICRO_DECODE; \
+            } \
+        } \
+    } while (0)
+
+#ifdef COMPUTED_GOTO
+#define HANDLER(kind) handle_##kind
+#define NEXT() \
+    do { \
+        op = &code[pc]; \
+        if (steps++ == limit) { \
+            goto out_of_steps; \
+        } \
+        __extension__({ goto *handlers[op->kind]; }); \
+    } while (0)
+#else
+#define HANDLER(kind) case kind
+#define NEXT() goto dispatch
+#endif
+
+#define MOVE(kind, SOURCE, TARGET) \
+    HANDLER(kind): \
+        at = TARGET(op->destination); \
+        STORE(at, cells[SOURCE(op->source)]); \
+        pc += op->size; \
+        NEXT();
+
+#define COMPARE(kind, SOURCE, TARGET) \
+    HANDLER(kind): \
+        zero = cells[TARGET(op->destination)] == cells[SOURCE(op->source)]; \
+        pc += op->size; \
+        NEXT();
+
+#define ARITHMETIC(kind, SOURCE, TARGET, operator) \
+    HANDLER(kind): \
+        at = TARGET(op->destination); \
+        value = (cells[at] operator cells[SOURCE(op->source)]) & WORD_MASK; \
+        zero = value == 0; \
+        STORE(at, value); \
+        pc += op->size; \
+        NEXT();
+
+#define UNARY(kind, TARGET, expression) \
+    HANDLER(kind): \
+        at = TARGET(op->destination); \
+        value = (expression) & WORD_MASK; \
+        zero = value == 0; \
+        STORE(at, value); \
+        pc += op->size; \
+        NEXT();
+
+#define READ(kind, TARGET) \
+    HANDLER(kind): \
+        at = TARGET(op->destination); \
+        value = machine->input_position < machine->input_length ? \
+                (unsigned char)machine->input[machine->input_position++] : fillMachineInput(machine); \
+        STORE(at, value & WORD_MASK); \
+        pc += op->size; \
+        NEXT();
+
+#define PRINT(kind, TARGET) \
+    HANDLER(kind): \
+        printValue(machine, cells[TARGET(op->destination)]); \
+        pc += op->size; \
+        NEXT();
+
+/**
+ * @brief Marks the instructions a write to memory may change, to be decoded again when they are reached.
+ * @param machine The machine.
+ * @param at The address that was written.
+ */
+void markWritten(Machine *machine, int at) {
+    int address;
+
+    if (at < MEMORY_SIZE) {
+        machine->dirty[at >> MACHINE_PAGE_SHIFT] = 1;
+    }
+    for (address = at >= 2 ? at - 2 : 0; address <= at && address < MEMORY_SIZE; address++) {
+        machine->code[address].kind = MICRO_DECODE;
+    }
+}
+
+/**
+ * @brief Keeps the state of a machine, to start runs from it again with restoreMachine.
+ *
+ * The memory, the registers, the decoded code and the stack are copied, and
+ * from then on the machine tracks the pages of memory its runs write to.
+ *
+ * @param machine The machine, loaded and maybe run for a while.
+ * @param snapshot The copy, it is never run.
+ */
+void snapshotMachine(Machine *machine, Machine *snapshot) {
+    memset(machine->dirty, 0, sizeof(machine->dirty));
+    /* The buffers of red and prn are not part of the state */
+    memcpy(snapshot, machine, offsetof(Machine, input));
+}
+
+/**
+ * @brief Puts a machine back to the state of its snapshot, copying only the pages of memory it wrote to.
+ *
+ * A write may change the instructions that start up to two words before it,
+ * so the decoded code of a page is restored with the two words before it.
+ * The constants of a word depend only on the word, so they are restored
+ * with its page. The files of red and prn, the step limit and how prn
+ * prints are left as they are, and the buffers are emptied.
+ *
+ * @param machine The machine, run by the interpreter since snapshotMachine.
+ * @param snapshot The snapshot.
+ * @return The number of pages restored.
+ */
+int restoreMachine(Machine *machine, const Machine *snapshot) {
+    int page, first, from, pages = 0;
+
+    for (page = 0; page < MACHINE_PAGES; page++) {
+        if (!machine->dirty[page]) {
+            continue;
+        }
+        first = page << MACHINE_PAGE_SHIFT;
+        from = first >= 2 ? first - 2 : 0;
+        memcpy(machine->cells + first, snapshot->cells + first, sizeof(machine->cells[0]) << MACHINE_PAGE_SHIFT);
+        memcpy(machine->cells + CONSTANT_CELLS + first, snapshot->cells + CONSTANT_CELLS + first,
+               sizeof(machine->cells[0]) << MACHINE_PAGE_SHIFT);
+        memcpy(machine->code + from, snapshot->code + from, (size_t)(first + (1 << MACHINE_PAGE_SHIFT) - from) *
+                                                                sizeof(MicroOp));
+        machine->dirty[page] = 0;
+        pages++;
+    }
+    memcpy(machine->cells + REGISTER_CELLS, snapshot->cells + REGISTER_CELLS,
+           REGISTER_COUNT * sizeof(machine->cells[0]));
+    memcpy(machine->stack, snapshot->stack, (size_t)snapshot->stack_depth * sizeof(machine->stack[0]));
+    machine->stack_depth = snapshot->stack_depth;
+    machine->pc = snapshot->pc;
+    machine->zero = snapshot->zero;
+    machine->steps = snapshot->steps;
+    machine->fault = NULL;
+    machine->input_length = 0;
+    machine->input_position = 0;
+    machine->output_length = 0;
+    return pages;
+}
+
+/**
+ * @brief Runs the program of a machine from its pc, until stop, a fault or a number of instructions.
+ *
+ * Every instruction was decoded into a micro-op when the program was loaded,
+ * so an instruction is one jump to the handler of its kind, with its operands
+ * as cells. A write to memory marks the instructions it may change, which are
+ * decoded again when they are reached.
+ *
+ * @param machine The machine, loaded by loadMachine. A fault is kept in its fault.
+ * @param limit The run stops when steps reaches it.
+ * @return MACHINE_STOPPED, MACHINE_FAULT or MACHINE_OUT_OF_STEPS.
+ */
+static int executeMachine(Machine *machine, unsigned long limit) {
+#ifdef COMPUTED_GOTO
+    static const void *const handlers[MICRO_KINDS] = {
+        __extension__ &&handle_MICRO_MOV_CC, __extension__ &&handle_MICRO_MOV_CI,
+        __extension__ &&handle_MICRO_MOV_IC, __extension__ &&handle_MICRO_MOV_II,
+        __extension__ &&handle_MICRO_CMP_CC, __extension__ &&handle_MICRO_CMP_CI,
+        __extension__ &&handle_MICRO_CMP_IC, __extension__ &&handle_MICRO_CMP_II,
+        __extension__ &&handle_MICRO_ADD_CC, __extension__ &&handle_MICRO_ADD_CI,
+        __extension__ &&handle_MICRO_ADD_IC, __extension__ &&handle_MICRO_ADD_II,
+        __extension__ &&handle_MICRO_SUB_CC, __extension__ &&handle_MICRO_SUB_CI,
+        __extension__ &&handle_MICRO_SUB_IC, __extension__ &&handle_MICRO_SUB_II,
+        __extension__ &&handle_MICRO_CLR_C, __extension__ &&handle_MICRO_CLR_I,
+        __extension__ &&handle_MICRO_NOT_C, __extension__ &&handle_MICRO_NOT_I,
+        __extension__ &&handle_MICRO_INC_C, __extension__ &&handle_MICRO_INC_I,
+        __extension__ &&handle_MICRO_DEC_C, __extension__ &&handle_MICRO_DEC_I,
+        __extension__ &&handle_MICRO_RED_C, __extension__ &&handle_MICRO_RED_I,
+        __extension__ &&handle_MICRO_PRN_C, __extension__ &&handle_MICRO_PRN_I,
+        __extension__ &&handle_MICRO_JMP, __extension__ &&handle_MICRO_BNE, __extension__ &&handle_MICRO_JSR,
+        __extension__ &&handle_MICRO_RTS,
+        __extension__ &&handle_MICRO_STOP,
+        __extension__ &&handle_MICRO_DECODE,
+        __extension__ &&handle_MICRO_ILLEGAL,
+        __extension__ &&handle_MICRO_EXTERN,
+        __extension__ &&handle_MICRO_END
+    };
+#endif
+    unsigned short *cells = machine->cells;
+    unsigned short *stack = machine->stack;
+    unsigned char *dirty = machine->dirty;
+    MicroOp *code = machine->code;
+    const MicroOp *op;
+    int pc = machine->pc;
+    int depth = machine->stack_depth;
+    bool zero = machine->zero;
+    unsigned long steps = machine->steps;
+    int status = MACHINE_FAULT;
+    const char *fault = NULL;
+    int at, value;
+
+    NEXT();
+#ifndef COMPUTED_GOTO
+dispatch:
+    op = &code[pc];
+    if (steps++ == limit) {
+        goto out_of_steps;
+    }
+    switch (op->kind) {
+#endif
+
+    MOVE(MICRO_MOV_CC, CELL, CELL)
+    MOVE(MICRO_MOV_CI, CELL, INDIRECT)
+    MOVE(MICRO_MOV_IC, INDIRECT, CELL)
+    MOVE(MICRO_MOV_II, INDIRECT, INDIRECT)
+    COMPARE(MICRO_CMP_CC, CELL, CELL)
+    COMPARE(MICRO_CMP_CI, CELL, INDIRECT)
+    COMPARE(MICRO_CMP_IC, INDIRECT, CELL)
+    COMPARE(MICRO_CMP_II, INDIRECT, INDIRECT)
+    ARITHMETIC(MICRO_ADD_CC, CELL, CELL, +)
+    ARITHMETIC(MICRO_ADD_CI, CELL, INDIRECT, +)
+    ARITHMETIC(MICRO_ADD_IC, INDIRECT, CELL, +)
+    ARITHMETIC(MICRO_ADD_II, INDIRECT, INDIRECT, +)
+    ARITHMETIC(MICRO_SUB_CC, CELL, CELL, -)
+    ARITHMETIC(MICRO_SUB_CI, CELL, INDIRECT, -)
+    ARITHMETIC(MICRO_SUB_IC, INDIRECT, CELL, -)
+    ARITHMETIC(MICRO_SUB_II, INDIRECT, INDIRECT, -)
+    UNARY(MICRO_CLR_C, CELL, 0)
+    UNARY(MICRO_CLR_I, INDIRECT, 0)
+    UNARY(MICRO_NOT_C, CELL, ~cells[at])
+    UNARY(MICRO_NOT_I, INDIRECT, ~cells[at])
+    UNARY(MICRO_INC_C, CELL, cells[at] + 1)
+    UNARY(MICRO_INC_I, INDIRECT, cells[at] + 1)
+    UNARY(MICRO_DEC_C, CELL, cells[at] - 1)
+    UNARY(MICRO_DEC_I, INDIRECT, cells[at] - 1)
+    READ(MICRO_RED_C, CELL)
+    READ(MICRO_RED_I, INDIRECT)
+    PRINT(MICRO_PRN_C, CELL)
+    PRINT(MICRO_PRN_I, INDIRECT)
+
+    HANDLER(MICRO_JMP):
+        pc = cells[op->destination] & ADDRESS_MASK;
+        NEXT();
+    HANDLER(MICRO_BNE):
+        pc = zero ? pc + op->size : cells[op->destination] & ADDRESS_MASK;
+        NEXT();
+    HANDLER(MICRO_JSR):
+        if (depth == STACK_SIZE) {
+            fault = "ERR: jsr at address %d overflows the stack of return addresses\n";
+            goto finish;
+        }
+        stack[depth++] = (unsigned short)(pc + op->size);
+        pc = cells[op->destination] & ADDRESS_MASK;
+        NEXT();
+    HANDLER(MICRO_RTS):
+        if (depth == 0) {
+            fault = "ERR: rts at address %d has no address to return to\n";
+            goto finish;
+        }
+        pc = stack[--depth];
+        NEXT();
+    HANDLER(MICRO_STOP):
+        status = MACHINE_STOPPED;
+        goto finish;
+    HANDLER(MICRO_DECODE):
+        decodeInstruction(machine, pc);
+        steps--; /* Counted when it is dispatched again */
+        NEXT();
+    HANDLER(MICRO_ILLEGAL):
+        fault = "ERR: the word at address %d is not an instruction\n";
+        goto finish;
+    HANDLER(MICRO_EXTERN):
+        fault = "ERR: the instruction at address %d refers to an extern label\n";
+        goto finish;
+    HANDLER(MICRO_END):
+        fault = "ERR: the program ran on to address %d, past the end of memory\n";
+        goto finish;
+
+#ifndef COMPUTED_GOTO
+    }
+#endif
+
+out_of_steps:
+    steps--;
+    status = MACHINE_OUT_OF_STEPS;
+finish:
+    machine->pc = pc;
+    machine->stack_depth = depth;
+    machine->zero = zero;
+    machine->steps = steps;
+    machine->fault = fault;
+    return status;
+}
+
+/**
+ * @brief Runs at most a number of instructions of the program of a machine, from its pc.
+ * @param machine The machine, loaded by loadMachine.
+ * @param count The instructions.
+ * @return MACHINE_STOPPED, MACHINE_FAULT, or MACHINE_OUT_OF_STEPS if it ran all of them.
+ */
+int stepMachine(Machine *machine, unsigned long count) {
+    return executeMachine(machine, machine->steps + count);
+}
+
+/**
+ * @brief Ends a run, printing what the program printed and then the reason it ended, if it failed.
+ * @param machine The machine.
+ * @param status How the run ended.
+ * @return The status.
+ */
+int endRun(Machine *machine, int status) {
+    /* What the program printed comes before the reason it ended */
+    flushMachineOutput(machine);
+    if (status == MACHINE_FAULT && machine->fault != NULL) {
+        report(machine->fault, machine->pc);
+    } else if (status == MACHINE_OUT_OF_STEPS) {
+        report("ERR: the program was stopped after %lu instructions\n", machine->steps);
+    }
+    return status;
+}
+
+/**
+ * @brief Runs the program of a machine from its pc, until stop, a fault or the step limit.
+ * @param machine The machine, loaded by loadMachine.
+ * @return MACHINE_STOPPED, MACHINE_FAULT or MACHINE_OUT_OF_STEPS.
+ */
+int runMachine(Machine *machine) {
+    return endRun(machine, executeMachine(machine, machine->step_limit != 0 ? machine->step_limit : ULONG_MAX));
+}
@@ -0,0 +1,340 @@
+#include "HEDER.h"
+
+/* The first bytes of a precompiled library, the digit is the version of the layout */
+#define AML_MAGIC "AML1"
+
+/*
+ * A precompiled library (".aml") is the header, the macros, the hash slots
+ * and the characters of the names and expansions, one after the other. It is
+ * a cache of the machine that wrote it, so the numbers are stored as they are
+ * in memory.
+ */
+typedef struct {
+    char magic[4];
+    int source_length; /* Length of the library source the image was compiled from */
+    unsigned long source_hash; /* FNV-1a hash of that source */
+    int count; /* Number of macros */
+    int slot_count;
+    int chars_length; /* Length of the names and expansions */
+} AmlHeader;
+
+typedef struct {
+    unsigned long hash;
+    int name; /* Offset of the name in the characters */
+    int name_length;
+    int text; /* Offset of the expansion in the characters */
+    int text_length;
+} AmlMacro;
+
+/**
+ * @brief Initializes an empty cache of macro libraries.
+ * @param cache A pointer to the cache to be initialized.
+ * @param arena The batch arena, it must live as long as the cache.
+ * @param write_aml Write a ".aml" file next to every library that is compiled.
+ */
+void initLibraryCache(LibraryCache *cache, Arena *arena, bool write_aml) {
+    cache->libraries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->write_aml = write_aml;
+    cache->file = 0;
+    cache->arena = arena;
+}
+
+/**
+ * @brief Checks a precompiled image and builds the read only table of its macros.
+ *
+ * The names and expansions stay in the image, only the macro records are
+ * built, so loading costs one step per macro whatever the size of the bodies.
+ *
+ * @param library The library, with its image set.
+ * @param source_length The length of the library source.
+ * @param source_hash The hash of the library source.
+ * @param arena The batch arena.
+ * @return 0 if succeded and 1 if the image is damaged or was compiled from another source.
+ */
+static int loadImage(MacroLibrary *library, int source_length, unsigned long source_hash, Arena *arena) {
+    const char *image = library->image.text;
+    const AmlHeader *header = (const AmlHeader *)image;
+    const AmlMacro *records;
+    const int *slots;
+    const char *chars;
+    size_t size;
+    Macro *macros;
+    int i;
+
+    if ((size_t)library->image.length < sizeof(AmlHeader) || memcmp(header->magic, AML_MAGIC, 4) != 0 ||
+        header->source_length != source_length || header->source_hash != source_hash || header->count < 0 ||
+        header->slot_count < 0 || header->chars_length < 0 || (header->slot_count & (header->slot_count - 1)) != 0 ||
+        header->count * 2 > header->slot_count) {
+        return 1;
+    }
+    size = sizeof(AmlHeader) + header->count * sizeof(AmlMacro) + header->slot_count * sizeof(int) +
+           header->chars_length;
+    if (size != (size_t)library->image.length) {
+        return 1;
+    }
+    records = (const AmlMacro *)(image + sizeof(AmlHeader));
+    slots = (const int *)(records + header->count);
+    chars = (const char *)(slots + header->slot_count);
+    for (i = 0; i < header->slot_count; i++) {
+        if (slots[i] < -1 || slots[i] >= header->count) {
+            return 1;
+        }
+    }
+
+    macros = (Macro *)arenaAlloc(arena, (header->count ? header->count : 1) * sizeof(Macro));
+    for (i = 0; i < header->count; i++) {
+        if (records[i].name < 0 || records[i].name_length < 0 || records[i].text < 0 ||
+            records[i].text_length < 0 || records[i].name > header->chars_length - records[i].name_length ||
+            records[i].text > header->chars_length - records[i].text_length) {
+            return 1;
+        }
+        macros[i].name.start = chars + records[i].name;
+        macros[i].name.length = records[i].name_length;
+        macros[i].hash = records[i].hash;
+        macros[i].text = chars + records[i].text;
+        macros[i].length = records[i].text_length;
+    }
+
+    initMacroTable(&library->table, arena);
+    library->table.macros = macros;
+    library->table.count = header->count;
+    library->table.capacity = header->count;
+    library->table.slots = (int *)slots; /* Never written, libraries are read only */
+    library->table.slot_count = header->slot_count;
+    return 0;
+}
+
+/**
+ * @brief Compiles a library source into a precompiled image in the batch arena.
+ *
+ * A library holds only macro definitions, every other line is an error.
+ *
+ * @param library The library, its image is set on success.
+ * @param source The library source.
+ * @param source_hash The hash of the library source.
+ * @param arena The batch arena.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int compileLibrary(MacroLibrary *library, const SourceFile *source, unsigned long source_hash,
+                          Arena *arena) {
+    MacroTable table;
+    TextBuffer outside;
+    AmlHeader *header;
+    AmlMacro *records;
+    char *image, *chars;
+    size_t size;
+    int i, chars_length = 0;
+
+    initMacroTable(&table, arena);
+    outside.chars = NULL;
+    outside.length = 0;
+    outside.capacity = 0;
+    outside.arena = arena;
+
+    if (process_file(source->text, source->length, &outside, &table, NULL) == 1) {
+        report("ERR: macro library '%s' could not be compiled\n", library->name);
+        return 1;
+    }
+    if (outside.length > 0) {
+        report("ERR: macro library '%s' has lines outside of macros\n", library->name);
+        return 1;
+    }
+
+    for (i = 0; i < table.count; i++) {
+        chars_length += table.macros[i].name.length + table.macros[i].length;
+    }
+    size = sizeof(AmlHeader) + table.count * sizeof(AmlMacro) + table.slot_count * sizeof(int) + chars_length;
+    image = (char *)arenaAlloc(arena, size);
+
+    header = (AmlHeader *)image;
+    memset(header, 0, sizeof(AmlHeader));
+    memcpy(header->magic, AML_MAGIC, 4);
+    header->source_length = source->length;
+    header->source_hash = source_hash;
+    header->count = table.count;
+    header->slot_count = table.slot_count;
+    header->chars_length = chars_length;
+
+    records = (AmlMacro *)(image + sizeof(AmlHeader));
+    if (table.slot_count > 0) {
+        memcpy(records + table.count, table.slots, table.slot_count * sizeof(int));
+    }
+    chars = (char *)((int *)(records + table.count) + table.slot_count);
+    chars_length = 0;
+    for (i = 0; i < table.count; i++) {
+        records[i].hash = table.macros[i].hash;
+        records[i].name = chars_length;
+        records[i].name_length = table.macros[i].name.length;
+        memcpy(chars + chars_length, table.macros[i].name.start, table.macros[i].name.length);
+        chars_length += table.macros[i].name.length;
+        records[i].text = chars_length;
+        records[i].text_length = table.macros[i].length;
+        memcpy(chars + chars_length, table.macros[i].text, table.macros[i].length);
+        chars_length += table.macros[i].length;
+    }
+
+    library->image.text = image;
+    library->image.length = (int)size;
+    library->image.mapped = false;
+    return 0;
+}
+
+/**
+ * @brief Hashes the source of a library, found the way an include finds it.
+ * @param name The name the library is included by, it may leave out ".as".
+ * @param arena The arena, used only if the source can't be mapped.
+ * @param length The length of the source.
+ * @param hash The hash of the source.
+ * @return 0 if succeded and 1 if there is no such library.
+ */
+int hashLibrary(const char *name, Arena *arena, int *length, unsigned long *hash) {
+    SourceFile source;
+    char *base_name, *dot_pos;
+
+    base_name = arenaString(arena, name, 0);
+    dot_pos = strrchr(base_name, '.');
+    if (dot_pos && strcmp(dot_pos, ".as") == 0) {
+        *dot_pos = '\0';
+    }
+    if (openSource(&source, name, arena) == 1 &&
+        openSource(&source, outputName(arena, base_name, ".as"), arena) == 1) {
+        return 1;
+    }
+    *length = source.length;
+    *hash = hashName(source.text, source.length);
+    closeSource(&source);
+    return 0;
+}
+
+/**
+ * @brief Checks that the source of a loaded library is the one its table was built from.
+ * @param library The library.
+ * @param arena The batch arena, used only if the source can't be mapped.
+ * @return 0 if the source is the same and 1 if it was changed or removed.
+ */
+static int checkLibrary(MacroLibrary *library, Arena *arena) {
+    int length;
+    unsigned long hash;
+
+    library->checked = hashLibrary(library->name, arena, &length, &hash) == 0 &&
+                       length == library->source_length && hash == library->source_hash;
+    return library->checked ? 0 : 1;
+}
+
+/**
+ * @brief Gives back the macros of a library, loading it on its first include.
+ *
+ * A library is read as given or with ".as" added, like a source file. It is
+ * loaded once per batch: from its ".aml" file if that was compiled from the
+ * same text (same length and hash), and otherwise compiled again. With -aml
+ * the compiled image is written to the ".aml" file for the next builds.
+ *
+ * @param cache The libraries of the batch.
+ * @param name The name of the library, as written in the `.include` line.
+ * @return The read only macro table of the library, or NULL if it can't be loaded.
+ */
+const MacroTable *loadLibrary(LibraryCache *cache, const char *name) {
+    Arena *arena = cache->arena;
+    MacroLibrary *library;
+    SourceFile source;
+    unsigned long source_hash;
+    char *base_name, *dot_pos, *aml_name;
+    int i;
+
+    for (i = 0; i < cache->count; i++) {
+        if (strcmp(cache->libraries[i]->name, name) == 0) {
+            if (cache->libraries[i]->checked || checkLibrary(cache->libraries[i], arena) == 0) {
+                cache->libraries[i]->file = cache->file;
+                return &cache->libraries[i]->table;
+            }
+            /* The library was changed, it is loaded again */
+            closeSource(&cache->libraries[i]->image);
+            cache->libraries[i] = cache->libraries[--cache->count];
+            break;
+        }
+    }
+
+    base_name = arenaString(arena, name, 0);
+    dot_pos = strrchr(base_name, '.');
+    if (dot_pos && strcmp(dot_pos, ".as") == 0) {
+        *dot_pos = '\0';
+    }
+    if (openSource(&source, name, arena) == 1 &&
+        openSource(&source, outputName(arena, base_name, ".as"), arena) == 1) {
+        report("ERR: macro library '%s' does not exist\n", name);
+        return NULL;
+    }
+    source_hash = hashName(source.text, source.length);
+
+    library = (MacroLibrary *)arenaAlloc(arena, sizeof(MacroLibrary));
+    library->name = arenaString(arena, name, 0);
+    library->source_length = source.length;
+    library->source_hash = source_hash;
+    library->checked = true;
+    library->file = cache->file;
+    aml_name = outputName(arena, base_name, ".aml");
+
+    if (openSource(&library->image, aml_name, arena) == 0) {
+        if (loadImage(library, source.length, source_hash, arena) == 1) {
+            closeSource(&library->image);
+            library->image.mapped = false;
+            library->image.length = 0;
+        }
+    } else {
+        library->image.length = 0;
+    }
+
+    if (library->image.length == 0) {
+        if (compileLibrary(library, &source, source_hash, arena) == 1) {
+            closeSource(&source);
+            return NULL;
+        }
+        if (cache->write_aml) {
+            /* Replaced at once, another assembler may have the old one mapped */
+            replaceFile(aml_name, library->image.text, library->image.length);
+        }
+        loadImage(library, source.length, source_hash, arena);
+    }
+    closeSource(&source);
+
+    if (cache->count == cache->capacity) {
+        cache->libraries = (MacroLibrary **)arenaGrow(arena, cache->libraries,
+                                                      cache->capacity * sizeof(MacroLibrary *),
+                                                      (cache->capacity ? cache->capacity * 2 : 8) *
+                                                      sizeof(MacroLibrary *));
+        cache->capacity = cache->capacity ? cache->capacity * 2 : 8;
+    }
+    cache->libraries[cache->count++] = library;
+    return &library->table;
+}
+
+/**
+ * @brief Marks every library of the cache to be checked against its source on its next include.
+ *
+ * A batch trusts its libraries not to change while it runs, the daemon
+ * calls this before every request, as it keeps its libraries between them.
+ *
+ * @param cache The cache.
+ */
+void expireLibraries(LibraryCache *cache) {
+    int i;
+
+    for (i = 0; i < cache->count; i++) {
+        cache->libraries[i]->checked = false;
+    }
+}
+
+/**
+ * @brief Releases the mapped images of the cache, the rest belongs to the batch arena.
+ * @param cache The cache to free.
+ */
+void freeLibraryCache(LibraryCache *cache) {
+    int i;
+
+    for (i = 0; i < cache->count; i++) {
+        closeSource(&cache->libraries[i]->image);
+    }
+    cache->count = 0;
+}
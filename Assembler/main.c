@@ -1,79 +1,184 @@
+/* open_memstream is POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "HEDER.h"
 
-int main(int argc, char **argv) {
-    int i;
-    LineInfo lines[MAX_LINES];
-    int line_count;
-    char name_of_file[MAX_MACRO_NAME];
-    char *dot_pos;
-    char *preprocessed_filename;
-    char new_name[MAX_MACRO_NAME];
+/* What the workers of a batch share, and what each of them owns */
+typedef struct {
+    char **files; /* The names of the files, as given on the command line */
+    const Options *options;
+    Arena *arenas; /* Per worker, reset for every file */
+    Arena *batch_arenas; /* Per worker, for its macro libraries */
+    LibraryCache *libraries; /* Per worker */
+    IoBatch *io; /* Per worker with -uring, NULL otherwise */
+    int file_count;
+    char **messages; /* Per file, the buffered ERR/WARN messages with -j */
+    size_t *messages_length;
+    char **errors; /* Per file, the buffered system errors with -j */
+    size_t *errors_length;
+} Batch;
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <file1> [<file2> ...]\n", argv[0]);
-        return 1;
+/**
+ * @brief Assembles a file of the batch, reading it ahead and queueing its outputs with -uring.
+ * @param batch The batch.
+ * @param task The number of the file.
+ * @param worker The number of the worker.
+ * @return 0 if the batch goes on and 1 if it has to stop.
+ */
+static int assembleTask(Batch *batch, int task, int worker) {
+    IoBatch *io;
+    ArtifactList *previous;
+    SourceFile *input;
+    int result;
+
+    if (batch->io == NULL) {
+        return assembleFile(batch->files[task], NULL, batch->options, &batch->arenas[worker],
+                            &batch->libraries[worker]);
     }
+    io = &batch->io[worker];
+    input = takeInput(io, batch->files, task, batch->file_count);
+    previous = queueOutputs(io);
+    result = assembleFile(batch->files[task], input, batch->options, &batch->arenas[worker],
+                          &batch->libraries[worker]);
+    endQueue(io, previous);
+    return result;
+}
 
-    for (i = 1; i < argc; ++i) {
-        FILE *file = fopen(argv[i], "r");
-        if (file == NULL) {
-            perror("ERR: File does not exist");
-            continue;
-        } else {
-            fclose(file);
-        }
+/**
+ * @brief Assembles a file of the batch on a worker, buffering its diagnostics with -j.
+ * @param task The number of the file.
+ * @param worker The number of the worker.
+ * @param context The batch.
+ * @return 0 if the batch goes on and 1 if it has to stop.
+ */
+static int runFile(int task, int worker, void *context) {
+    Batch *batch = (Batch *)context;
+    FILE *messages, *errors;
+    int result;
 
-        strcpy(new_name, argv[i]);
-        strcat(new_name, ".as");
+    if (batch->options->jobs <= 1) {
+        return assembleTask(batch, task, worker);
+    }
+    messages = open_memstream(&batch->messages[task], &batch->messages_length[task]);
+    errors = open_memstream(&batch->errors[task], &batch->errors_length[task]);
+    if (messages == NULL || errors == NULL) {
+        perror("ERR: Unable to allocate memory for the diagnostics");
+        exit(EXIT_FAILURE);
+    }
+    setDiagnostics(messages, errors);
+    result = assembleTask(batch, task, worker);
+    setDiagnostics(NULL, NULL);
+    fclose(messages);
+    fclose(errors);
+    return result;
+}
 
-        if (rename(argv[i], new_name) != 0) {
-            perror("Error renaming file");
-            continue;
-        }
+/**
+ * @brief Prints the buffered diagnostics of a file, called in the order of the command line.
+ * @param task The number of the file.
+ * @param context The batch.
+ */
+static void finishFile(int task, void *context) {
+    Batch *batch = (Batch *)context;
 
-        strcpy(name_of_file, new_name);
+    if (batch->options->jobs <= 1) {
+        return;
+    }
+    fwrite(batch->errors[task], 1, batch->errors_length[task], stderr);
+    fwrite(batch->messages[task], 1, batch->messages_length[task], stdout);
+    fflush(stdout);
+    free(batch->errors[task]);
+    free(batch->messages[task]);
+}
 
-        dot_pos = strrchr(name_of_file, '.');
-        if (!dot_pos || strcmp(dot_pos, ".as") != 0) {
-            printf("ERR: no '.as' file to proceed\n");
-            return 1;
-        }
+int main(int argc, char **argv) {
+    int i, workers, file_count, result;
+    Options options;
+    Batch batch;
 
-        if (preAss(name_of_file) == 1) {
-            printf("ERR:Error at macro processing\n");
-            return 1;
-        }
+    options.write_am = false;
+    options.write_afp = false;
+    options.write_asp = false;
+    options.write_aml = false;
+    options.write_bo = false;
+    options.write_c = false;
+    options.jobs = 1;
+    options.cache = NULL;
+    options.batch_io = false;
 
-        preprocessed_filename = (char *)malloc(strlen(name_of_file) + 4);
-        if (!preprocessed_filename) {
-            perror("ERR: Unable to allocate memory for preprocessed filename");
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+            if (options.jobs < 1) {
+                fprintf(stderr, "ERR: -j needs a number of jobs above 0\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-uring") == 0) {
+            options.batch_io = true;
+        } else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) {
+            options.cache = argv[++i];
+        } else if (parseOption(argv[i], &options) == 1) {
+            fprintf(stderr, "ERR: unknown option '%s'\n", argv[i]);
             return 1;
         }
+    }
+    if (i >= argc) {
+        fprintf(stderr, "Usage: %s [-am] [-afp] [-asp] [-aml] [-bo] [-c] [-j N] [-cache dir] [-uring] <file1> [<file2> ...]\n", argv[0]);
+        return 1;
+    }
+    file_count = argc - i;
+    workers = options.jobs < file_count ? options.jobs : file_count;
 
-        strcpy(preprocessed_filename, name_of_file);
-        dot_pos = strrchr(preprocessed_filename, '.');
+    batch.files = argv + i;
+    batch.options = &options;
+    batch.arenas = (Arena *)malloc(workers * sizeof(Arena));
+    batch.batch_arenas = (Arena *)malloc(workers * sizeof(Arena));
+    batch.libraries = (LibraryCache *)malloc(workers * sizeof(LibraryCache));
+    batch.io = options.batch_io ? (IoBatch *)malloc(workers * sizeof(IoBatch)) : NULL;
+    batch.file_count = file_count;
+    batch.messages = (char **)calloc(file_count, sizeof(char *));
+    batch.messages_length = (size_t *)calloc(file_count, sizeof(size_t));
+    batch.errors = (char **)calloc(file_count, sizeof(char *));
+    batch.errors_length = (size_t *)calloc(file_count, sizeof(size_t));
+    if (batch.arenas == NULL || batch.batch_arenas == NULL || batch.libraries == NULL ||
+        (options.batch_io && batch.io == NULL) || batch.messages == NULL ||
+        batch.messages_length == NULL || batch.errors == NULL || batch.errors_length == NULL) {
+        perror("ERR: Unable to allocate memory for the batch");
+        return 1;
+    }
 
-        if (dot_pos && strcmp(dot_pos, ".as") == 0) {
-            strcpy(dot_pos, ".am");
-        } else {
-            printf("ERR:no .am file to proceed\n");
-            free(preprocessed_filename);
-            return 1;
+    /* Every worker has an arena for the current file, reset for the next one, and its own macro libraries */
+    for (i = 0; i < workers; i++) {
+        initArena(&batch.arenas[i], ARENA_SIZE);
+        initArena(&batch.batch_arenas[i], ARENA_SIZE);
+        initLibraryCache(&batch.libraries[i], &batch.batch_arenas[i], options.write_aml);
+        if (batch.io != NULL) {
+            initIoBatch(&batch.io[i]);
         }
+    }
+    initScanner();
 
-        line_count = 0;
+    /* With -j the files are assembled on a pool of threads, the diagnostics still come in order */
+    result = runTasks(file_count, workers, runFile, finishFile, &batch);
 
-        if (firstPass(preprocessed_filename, lines, line_count) == 1) {
-            printf("ERR:Error at first pass processing\n");
-            free(preprocessed_filename);
-            return 1;
+    for (i = 0; i < workers; i++) {
+        if (batch.io != NULL) {
+            freeIoBatch(&batch.io[i]); /* Writes the outputs still queued */
         }
-
-        free(preprocessed_filename);
+        freeLibraryCache(&batch.libraries[i]);
+        freeArena(&batch.batch_arenas[i]);
+        freeArena(&batch.arenas[i]);
     }
-    return 0;
+    free(batch.arenas);
+    free(batch.batch_arenas);
+    free(batch.libraries);
+    free(batch.io);
+    free(batch.messages);
+    free(batch.messages_length);
+    free(batch.errors);
+    free(batch.errors_length);
+    return result;
 }
-
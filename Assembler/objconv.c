@@ -0,0 +1,72 @@
+#include "HEDER.h"
+
+/**
+ * @brief Converts the text object files of a source to a ".bo" file.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param arena The per-file arena.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int textToBinary(const char *base_name, Arena *arena) {
+    ObjectImage object;
+
+    if (readObjectText(base_name, arena, &object) == 1) {
+        return 1;
+    }
+    return writeObjectFile(&object, outputName(arena, base_name, ".bo"), arena);
+}
+
+/**
+ * @brief Converts the ".bo" file of a source to the text object files.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param arena The per-file arena.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int binaryToText(const char *base_name, Arena *arena) {
+    SourceFile file;
+    ObjectImage object;
+    char *name_of_file = outputName(arena, base_name, ".bo");
+    int errors;
+
+    if (openSource(&file, name_of_file, arena) == 1) {
+        printf("ERR: '%s' does not exist\n", name_of_file);
+        return 1;
+    }
+    if (loadObjectFile(&file, &object) == 1) {
+        printf("ERR: '%s' is not a binary object of this version\n", name_of_file);
+        closeSource(&file);
+        return 1;
+    }
+    errors = writeObjectText(&object, base_name, arena);
+    closeSource(&file);
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int i, errors = 0;
+    int to_binary;
+    char *base_name;
+    char *dot_pos;
+    Arena arena;
+
+    if (argc < 3 || (strcmp(argv[1], "-b") != 0 && strcmp(argv[1], "-t") != 0)) {
+        fprintf(stderr, "Usage: %s -b|-t <file1> [<file2> ...]\n", argv[0]);
+        fprintf(stderr, "  -b  .ob, .ent and .ext to .bo\n  -t  .bo to .ob, .ent and .ext\n");
+        return 1;
+    }
+    to_binary = strcmp(argv[1], "-b") == 0;
+
+    initArena(&arena, ARENA_SIZE);
+    for (i = 2; i < argc; ++i) {
+        resetArena(&arena);
+
+        /* The files are named after the source, with or without its extension */
+        base_name = arenaString(&arena, argv[i], 0);
+        dot_pos = strrchr(base_name, '.');
+        if (dot_pos && (strcmp(dot_pos, ".as") == 0 || strcmp(dot_pos, ".ob") == 0 || strcmp(dot_pos, ".bo") == 0)) {
+            *dot_pos = '\0';
+        }
+        errors |= to_binary ? textToBinary(base_name, &arena) : binaryToText(base_name, &arena);
+    }
+    freeArena(&arena);
+    return errors;
+}
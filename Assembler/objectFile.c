@@ -0,0 +1,464 @@
+#include "HEDER.h"
+
+/* Every section of a ".bo" file starts at a multiple of this */
+#define OBJECT_ALIGN 4
+#define OBJECT_ALIGNED(size) (((size) + (OBJECT_ALIGN - 1)) & ~(OBJECT_ALIGN - 1))
+
+/**
+ * @brief Sorts the export numbers of an object by label name.
+ *
+ * A merge sort, stable, so exports with the same name keep their order.
+ *
+ * @param index The export numbers, 0 to count - 1.
+ * @param exports The exports.
+ * @param count The number of exports.
+ * @param names The names of the object.
+ * @param arena The arena the merge buffer is allocated from.
+ */
+static void sortExportIndex(int *index, const ObjectSymbol *exports, int count, const char *names, Arena *arena) {
+    int *from = index;
+    int *to = (int *)arenaAlloc(arena, (count + 1) * sizeof(int));
+    int *swap;
+    int width, start, middle, end, left, right, k;
+
+    for (k = 0; k < count; k++) {
+        index[k] = k;
+    }
+    for (width = 1; width < count; width *= 2) {
+        for (start = 0; start < count; start += 2 * width) {
+            middle = start + width < count ? start + width : count;
+            end = start + 2 * width < count ? start + 2 * width : count;
+            left = start;
+            right = middle;
+            for (k = start; k < end; k++) {
+                if (left < middle && (right >= end || strcmp(names + exports[from[left]].name,
+                                                             names + exports[from[right]].name) <= 0)) {
+                    to[k] = from[left++];
+                } else {
+                    to[k] = from[right++];
+                }
+            }
+        }
+        swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != index) {
+        memcpy(index, from, count * sizeof(int));
+    }
+}
+
+/**
+ * @brief Describes the outputs of a file that passed the second pass as an object.
+ *
+ * Both the text files and the ".bo" file are written from this description.
+ * The label names are the interned names of the symbol table, nothing is
+ * copied but the entries and extern references.
+ *
+ * @param program The lines and symbols of the file after the first pass.
+ * @param image The machine words of the file.
+ * @param relocations The extern references recorded while encoding.
+ * @param ic The instruction counter.
+ * @param dc The data counter.
+ * @param object The object to fill, its memory belongs to the arena of the program.
+ */
+void buildObject(Program *program, const MemoryImage *image, const RelocationList *relocations, int ic, int dc,
+                 ObjectImage *object) {
+    LineTable *lines = &program->lines;
+    SymbolTable *symbols = &program->symbols;
+    ObjectSymbol *exports, *externs;
+    int *export_index;
+    int i, count = 0;
+
+    object->words = image->words;
+    object->ic = ic;
+    object->dc = dc;
+    object->flags = 0;
+    object->names = symbols->names ? symbols->names : "";
+    object->names_length = symbols->names_length;
+
+    for (i = 0; i < symbols->count; i++) {
+        if (symbols->symbols[i].flags & SYMBOL_EXTERN) {
+            object->flags |= OBJECT_HAS_EXTERNS;
+        }
+    }
+    for (i = 0; i < lines->count; i++) {
+        if (lines->info[i].is_entry) {
+            object->flags |= OBJECT_HAS_ENTRIES;
+            if (lines->info[i].label != -1) {
+                count++;
+            }
+        }
+    }
+
+    exports = (ObjectSymbol *)arenaAlloc(program->arena, (count + 1) * sizeof(ObjectSymbol));
+    export_index = (int *)arenaAlloc(program->arena, (count + 1) * sizeof(int));
+    count = 0;
+    for (i = 0; i < lines->count; i++) {
+        if (lines->info[i].label != -1 && lines->info[i].is_entry) {
+            exports[count].name = symbols->symbols[lines->info[i].label].name;
+            exports[count].address = lines->memory_value[i];
+            count++;
+        }
+    }
+    sortExportIndex(export_index, exports, count, object->names, program->arena);
+    object->exports = exports;
+    object->export_index = export_index;
+    object->export_count = count;
+
+    externs = (ObjectSymbol *)arenaAlloc(program->arena, (relocations->count + 1) * sizeof(ObjectSymbol));
+    for (i = 0; i < relocations->count; i++) {
+        externs[i].name = symbols->symbols[relocations->refs[i].symbol].name;
+        externs[i].address = relocations->refs[i].address;
+    }
+    object->externs = externs;
+    object->extern_count = relocations->count;
+}
+
+/**
+ * @brief Appends a label and an address as one line, the way "%s %d\n" does.
+ * @param buffer The text buffer of the file.
+ * @param name The label name.
+ * @param address The address.
+ */
+static void appendLabelLine(TextBuffer *buffer, const char *name, int address) {
+    char number[MAX_NUMBER_DIGITS + 2];
+    int length;
+
+    number[0] = ' ';
+    length = 1 + formatDecimal(address, 1, number + 1);
+    number[length++] = '\n';
+    appendText(buffer, name, (int)strlen(name));
+    appendText(buffer, number, length);
+}
+
+/**
+ * @brief Writes a ".ent" or ".ext" file, one label and address per line.
+ * @param name_of_file The name of the file.
+ * @param symbols The labels.
+ * @param count The number of labels.
+ * @param names The names of the object.
+ * @param arena The arena the text is formatted in.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int writeLabelFile(const char *name_of_file, const ObjectSymbol *symbols, int count, const char *names,
+                          Arena *arena) {
+    TextBuffer text;
+    int i;
+
+    text.chars = NULL;
+    text.length = 0;
+    text.capacity = 0;
+    text.arena = arena;
+    for (i = 0; i < count; i++) {
+        appendLabelLine(&text, names + symbols[i].name, symbols[i].address);
+    }
+    return writeTextFile(name_of_file, text.chars ? text.chars : "", text.length);
+}
+
+/**
+ * @brief Writes the text object files: ".ob", and ".ent" and ".ext" if the source states them.
+ * @param object The object.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param arena The arena the texts are formatted in.
+ * @return 0 if succeded and 1 otherwise.
+ */
+int writeObjectText(const ObjectImage *object, const char *base_name, Arena *arena) {
+    MemoryImage image;
+    int errors = 0;
+
+    image.words = (unsigned short *)object->words; /* makeOb only reads the words */
+    image.count = object->ic + object->dc;
+    image.capacity = image.count;
+    image.arena = arena;
+    makeOb(&image, base_name, object->dc, object->ic);
+
+    if (object->flags & OBJECT_HAS_EXTERNS) {
+        errors |= writeLabelFile(outputName(arena, base_name, ".ext"), object->externs, object->extern_count,
+                                 object->names, arena);
+    }
+    if (object->flags & OBJECT_HAS_ENTRIES) {
+        errors |= writeLabelFile(outputName(arena, base_name, ".ent"), object->exports, object->export_count,
+                                 object->names, arena);
+    }
+    return errors;
+}
+
+/**
+ * @brief Reads a number of a text object file.
+ * @param token The view of the number.
+ * @param base 10, or 8 for a machine word.
+ * @param value The number read.
+ * @return 0 if succeded and 1 if the view is not a number.
+ */
+static int readNumber(Span token, int base, int *value) {
+    int i, sign = 1;
+    long number = 0;
+
+    i = 0;
+    if (token.length > 0 && token.start[0] == '-') {
+        sign = -1;
+        i = 1;
+    }
+    if (i == token.length) {
+        return 1;
+    }
+    for (; i < token.length; i++) {
+        if (token.start[i] < '0' || token.start[i] >= '0' + base || number > 0x7FFFFFFL) {
+            return 1;
+        }
+        number = number * base + (token.start[i] - '0');
+    }
+    *value = (int)(sign * number);
+    return 0;
+}
+
+/**
+ * @brief Reads a ".ent" or ".ext" file into labels of an object.
+ * @param name_of_file The name of the file.
+ * @param names The names of the object, the names of the file are added to them.
+ * @param symbols The labels read, or NULL if there is no such file.
+ * @param count The number of labels read.
+ * @param arena The arena that owns the labels.
+ * @return 0 if succeded or the file does not exist, and 1 if it is not a label file.
+ */
+static int readLabelFile(const char *name_of_file, TextBuffer *names, const ObjectSymbol **symbols, int *count,
+                         Arena *arena) {
+    SourceFile file;
+    Scan scan;
+    const char *cursor;
+    Span line, name, address;
+    ObjectSymbol *labels;
+    int capacity = 16;
+
+    *symbols = NULL;
+    *count = 0;
+    if (openSource(&file, name_of_file, arena) == 1) {
+        return 0;
+    }
+    scanText(&scan, file.text, file.length, arena);
+    labels = (ObjectSymbol *)arenaAlloc(arena, capacity * sizeof(ObjectSymbol));
+    cursor = file.text;
+    while (nextLine(&scan, &cursor, &line)) {
+        if (trimSpan(&scan, line).length == 0) {
+            continue;
+        }
+        if (*count == capacity) {
+            labels = (ObjectSymbol *)arenaGrow(arena, labels, capacity * sizeof(ObjectSymbol),
+                                               capacity * 2 * sizeof(ObjectSymbol));
+            capacity *= 2;
+        }
+        if (!nextToken(&scan, &line, SPACES, &name) || !nextToken(&scan, &line, SPACES, &address) ||
+            readNumber(address, 10, &labels[*count].address) == 1) {
+            report("ERR: '%s' is not a label file\n", name_of_file);
+            closeSource(&file);
+            return 1;
+        }
+        labels[*count].name = names->length;
+        appendText(names, name.start, name.length);
+        appendText(names, "", 1); /* Names are kept null terminated */
+        (*count)++;
+    }
+    closeSource(&file);
+    *symbols = labels;
+    return 0;
+}
+
+/**
+ * @brief Reads the text object files of a source back into an object.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param arena The arena that owns the object.
+ * @param object The object read.
+ * @return 0 if succeded and 1 if the ".ob" file is missing or any file is damaged.
+ */
+int readObjectText(const char *base_name, Arena *arena, ObjectImage *object) {
+    SourceFile file;
+    Scan scan;
+    const char *cursor;
+    Span line, token;
+    TextBuffer names;
+    unsigned short *words;
+    char *name_of_file;
+    int count, word, address;
+    int *export_index;
+
+    name_of_file = outputName(arena, base_name, ".ob");
+    if (openSource(&file, name_of_file, arena) == 1) {
+        report("ERR: '%s' does not exist\n", name_of_file);
+        return 1;
+    }
+    scanText(&scan, file.text, file.length, arena);
+    cursor = file.text;
+    if (!nextLine(&scan, &cursor, &line) || !nextToken(&scan, &line, SPACES, &token) ||
+        readNumber(token, 10, &object->ic) == 1 || !nextToken(&scan, &line, SPACES, &token) ||
+        readNumber(token, 10, &object->dc) == 1 || object->ic < 0 || object->dc < 0) {
+        report("ERR: '%s' has no counters line\n", name_of_file);
+        closeSource(&file);
+        return 1;
+    }
+    words = (unsigned short *)arenaAlloc(arena, (object->ic + object->dc + 1) * sizeof(unsigned short));
+    for (count = 0; count < object->ic + object->dc; count++) {
+        if (!nextLine(&scan, &cursor, &line) || !nextToken(&scan, &line, SPACES, &token) ||
+            readNumber(token, 10, &address) == 1 || address != MIN_MEM_VAL + count ||
+            !nextToken(&scan, &line, SPACES, &token) || readNumber(token, 8, &word) == 1 || word > 0x7FFF) {
+            report("ERR: word %d of '%s' is damaged\n", count, name_of_file);
+            closeSource(&file);
+            return 1;
+        }
+        words[count] = (unsigned short)word;
+    }
+    closeSource(&file);
+    object->words = words;
+    object->flags = 0;
+
+    names.chars = NULL;
+    names.length = 0;
+    names.capacity = 0;
+    names.arena = arena;
+
+    /* A label file that exists is a label file that the source asked for, even if it is empty */
+    if (readLabelFile(outputName(arena, base_name, ".ext"), &names, &object->externs, &object->extern_count,
+                      arena) == 1 ||
+        readLabelFile(outputName(arena, base_name, ".ent"), &names, &object->exports, &object->export_count,
+                      arena) == 1) {
+        return 1;
+    }
+    if (object->externs != NULL) {
+        object->flags |= OBJECT_HAS_EXTERNS;
+    }
+    if (object->exports != NULL) {
+        object->flags |= OBJECT_HAS_ENTRIES;
+    }
+
+    object->names = names.chars ? names.chars : "";
+    object->names_length = names.length;
+    export_index = (int *)arenaAlloc(arena, (object->export_count + 1) * sizeof(int));
+    sortExportIndex(export_index, object->exports, object->export_count, object->names, arena);
+    object->export_index = export_index;
+    return 0;
+}
+
+/**
+ * @brief Writes an object as a ".bo" file, with a single write.
+ *
+ * The file is the header followed by the sections, each at an aligned
+ * offset, so a loader maps it and uses it without parsing.
+ *
+ * @param object The object.
+ * @param name_of_file The name of the file.
+ * @param arena The arena the file is built in.
+ * @return 0 if succeded and 1 otherwise.
+ */
+int writeObjectFile(const ObjectImage *object, const char *name_of_file, Arena *arena) {
+    ObjectHeader header;
+    char *file;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OBJECT_MAGIC, 4);
+    header.version = OBJECT_VERSION;
+    header.byte_order = OBJECT_BYTE_ORDER;
+    header.flags = object->flags;
+    header.ic = object->ic;
+    header.dc = object->dc;
+    header.export_count = object->export_count;
+    header.extern_count = object->extern_count;
+    header.names_length = object->names_length;
+
+    header.words_offset = OBJECT_ALIGNED((int)sizeof(ObjectHeader));
+    header.exports_offset = OBJECT_ALIGNED(header.words_offset + (header.ic + header.dc) * (int)sizeof(unsigned short));
+    header.index_offset = header.exports_offset + header.export_count * (int)sizeof(ObjectSymbol);
+    header.externs_offset = header.index_offset + header.export_count * (int)sizeof(int);
+    header.names_offset = header.externs_offset + header.extern_count * (int)sizeof(ObjectSymbol);
+    header.size = header.names_offset + header.names_length;
+
+    file = (char *)arenaAlloc(arena, (size_t)header.size);
+    memset(file, 0, (size_t)header.size);
+    memcpy(file, &header, sizeof(header));
+    memcpy(file + header.words_offset, object->words, (header.ic + header.dc) * sizeof(unsigned short));
+    memcpy(file + header.exports_offset, object->exports, header.export_count * sizeof(ObjectSymbol));
+    memcpy(file + header.index_offset, object->export_index, header.export_count * sizeof(int));
+    memcpy(file + header.externs_offset, object->externs, header.extern_count * sizeof(ObjectSymbol));
+    memcpy(file + header.names_offset, object->names, (size_t)header.names_length);
+    return writeTextFile(name_of_file, file, header.size);
+}
+
+/**
+ * @brief Checks that a section lies inside the file.
+ * @param header The header of the file.
+ * @param offset The offset of the section.
+ * @param size The size of the section.
+ * @return 1 if the section is inside the file and aligned, 0 otherwise.
+ */
+static int sectionFits(const ObjectHeader *header, int offset, long size) {
+    return offset >= (int)sizeof(ObjectHeader) && offset % OBJECT_ALIGN == 0 && size >= 0 &&
+           (long)offset + size <= (long)header->size;
+}
+
+/**
+ * @brief Checks that every label of a section names a string of the names section.
+ * @param symbols The labels.
+ * @param count The number of labels.
+ * @param names_length The length of the names section, which ends with a null.
+ * @return 1 if all the names are inside the names section, 0 otherwise.
+ */
+static int namesFit(const ObjectSymbol *symbols, int count, int names_length) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (symbols[i].name < 0 || symbols[i].name >= names_length) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Uses a mapped ".bo" file as an object, without copying or parsing it.
+ *
+ * The header and the bounds of every section are checked once, then the
+ * object points into the file, which has to stay mapped while it is used.
+ *
+ * @param file The file, opened with openSource.
+ * @param object The object.
+ * @return 0 if succeded and 1 if the file is not a ".bo" file of this version and machine.
+ */
+int loadObjectFile(const SourceFile *file, ObjectImage *object) {
+    const ObjectHeader *header = (const ObjectHeader *)file->text;
+    int i;
+
+    if ((size_t)file->length < sizeof(ObjectHeader) || memcmp(header->magic, OBJECT_MAGIC, 4) != 0 ||
+        header->version != OBJECT_VERSION || header->byte_order != OBJECT_BYTE_ORDER ||
+        header->size != file->length || header->ic < 0 || header->dc < 0 || header->export_count < 0 ||
+        header->extern_count < 0 || header->names_length < 0 ||
+        !sectionFits(header, header->words_offset, (long)(header->ic + header->dc) * sizeof(unsigned short)) ||
+        !sectionFits(header, header->exports_offset, (long)header->export_count * sizeof(ObjectSymbol)) ||
+        !sectionFits(header, header->index_offset, (long)header->export_count * sizeof(int)) ||
+        !sectionFits(header, header->externs_offset, (long)header->extern_count * sizeof(ObjectSymbol)) ||
+        !sectionFits(header, header->names_offset, header->names_length) ||
+        (header->names_length > 0 && file->text[header->names_offset + header->names_length - 1] != '\0')) {
+        return 1;
+    }
+
+    object->words = (const unsigned short *)(file->text + header->words_offset);
+    object->ic = header->ic;
+    object->dc = header->dc;
+    object->flags = header->flags;
+    object->exports = (const ObjectSymbol *)(file->text + header->exports_offset);
+    object->export_index = (const int *)(file->text + header->index_offset);
+    object->export_count = header->export_count;
+    object->externs = (const ObjectSymbol *)(file->text + header->externs_offset);
+    object->extern_count = header->extern_count;
+    object->names = file->text + header->names_offset;
+    object->names_length = header->names_length;
+
+    if (!namesFit(object->exports, object->export_count, object->names_length) ||
+        !namesFit(object->externs, object->extern_count, object->names_length)) {
+        return 1;
+    }
+    for (i = 0; i < object->export_count; i++) {
+        if (object->export_index[i] < 0 || object->export_index[i] >= object->export_count) {
+            return 1;
+        }
+    }
+    return 0;
+}
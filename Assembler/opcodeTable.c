@@ -0,0 +1,125 @@
+#include "HEDER.h"
+
+/* Addressing methods are indexed as method + 1, so index 0 means "no operand" */
+#define NONE_MASK (1 << 0)
+#define IMMEDIATE_MASK (1 << (IMMEDIATE + 1))
+#define DIRECT_MASK (1 << (DIRECT + 1))
+#define INDIRECT_MASK (1 << (INDIRECT_REGISTER + 1))
+#define REGISTER_MASK (1 << (DIRECT_REGISTER + 1))
+#define WRITE_MASK (DIRECT_MASK | INDIRECT_MASK | REGISTER_MASK)
+#define READ_MASK (IMMEDIATE_MASK | WRITE_MASK)
+#define JUMP_MASK (DIRECT_MASK | INDIRECT_MASK)
+
+typedef struct {
+    const char *name;
+    int operands; /* Number of operands the opcode requires */
+    int source_modes; /* Mask of the legal source methods */
+    int destination_modes; /* Mask of the legal destination methods */
+} OpcodeInfo;
+
+/* The instruction set, indexed by opcode value */
+static const OpcodeInfo opcodes[16] = {
+    {"mov", 2, READ_MASK, WRITE_MASK},
+    {"cmp", 2, READ_MASK, READ_MASK},
+    {"add", 2, READ_MASK, WRITE_MASK},
+    {"sub", 2, READ_MASK, WRITE_MASK},
+    {"lea", 2, DIRECT_MASK, WRITE_MASK},
+    {"clr", 1, NONE_MASK, WRITE_MASK},
+    {"not", 1, NONE_MASK, WRITE_MASK},
+    {"inc", 1, NONE_MASK, WRITE_MASK},
+    {"dec", 1, NONE_MASK, WRITE_MASK},
+    {"jmp", 1, NONE_MASK, JUMP_MASK},
+    {"bne", 1, NONE_MASK, JUMP_MASK},
+    {"red", 1, NONE_MASK, WRITE_MASK},
+    {"prn", 1, NONE_MASK, READ_MASK},
+    {"jsr", 1, NONE_MASK, JUMP_MASK},
+    {"rts", 0, NONE_MASK, NONE_MASK},
+    {"stop", 0, NONE_MASK, NONE_MASK}
+};
+
+/*
+ * Perfect hash of the mnemonics: (3 * c0 + 18 * c1 + c2) % 32 is different
+ * for each of the 16 names, so a lookup is one hash and one strcmp.
+ */
+static const signed char opcode_slots[32] = {
+    -1, -1, 12, 1, -1, -1, 13, 10, -1, 8, -1, 0, 6, -1, -1, 2,
+    15, 14, -1, 5, 11, 3, -1, -1, 9, -1, 7, -1, -1, -1, -1, 4
+};
+
+/* First word bits of each method, indexed by method + 1 */
+static const int source_bits[5] = {0, 1 << 7, 1 << 8, 1 << 9, 1 << 10};
+static const int destination_bits[5] = {0, 1 << 3, 1 << 4, 1 << 5, 1 << 6};
+
+/* Words taken by an instruction, indexed by source method + 1 and destination method + 1 */
+static const int word_counts[5][5] = {
+    {1, 2, 2, 2, 2},
+    {2, 3, 3, 3, 3},
+    {2, 3, 3, 3, 3},
+    {2, 3, 3, 2, 2}, /* Two register operands share one word */
+    {2, 3, 3, 2, 2}
+};
+
+/**
+ * @brief Maps an opcode name to its corresponding numeric value.
+ *
+ * This function hashes the opcode name into the perfect hash table of the
+ * instruction set and compares it with the only mnemonic that can match.
+ *
+ * @param opcode_name A view of the name of the opcode.
+ * @return The numeric value of the opcode if found, otherwise -1 for an invalid opcode.
+ */
+int getOpcodeValue(Span opcode_name) {
+    const char *name = opcode_name.start;
+    int slot;
+
+    if (opcode_name.length < 3 || opcode_name.length > 4) {
+        return -1;
+    }
+    slot = opcode_slots[(3 * (unsigned char)name[0] + 18 * (unsigned char)name[1] +
+                        (unsigned char)name[2]) % 32];
+    if (slot != -1 && spanEquals(opcode_name, opcodes[slot].name)) {
+        return slot;
+    }
+    return -1; /* Invalid opcode */
+}
+
+/**
+ * @brief Gives back the mnemonic of an opcode.
+ * @param opcode_value The numeric value of the opcode, or -1.
+ * @return The mnemonic, or an empty string for -1.
+ */
+const char *getOpcodeName(int opcode_value) {
+    return opcode_value == -1 ? "" : opcodes[opcode_value].name;
+}
+
+/**
+ * @brief Gets the legal number of operands for a given opcode.
+ * @return The number of operands that the given opcode requires.
+ */
+int getOperandCount(int opcode_value) {
+    return opcodes[opcode_value].operands;
+}
+
+/**
+ * @brief Looks up how an opcode is encoded with a pair of addressing methods.
+ *
+ * The legality comes from the method masks of the opcode, the size from the
+ * word count table and the first word from the method bit tables, so the
+ * validation, the sizing and the encoding all read the same data.
+ *
+ * @param opcode_value The numeric value of the opcode.
+ * @param source_method The source method, or -1 if there is no source operand.
+ * @param destination_method The destination method, or -1 if there is no destination operand.
+ * @return The form of the instruction.
+ */
+InstructionForm getInstructionForm(int opcode_value, int source_method, int destination_method) {
+    InstructionForm form;
+    const OpcodeInfo *info = &opcodes[opcode_value];
+
+    form.legal = ((info->source_modes >> (source_method + 1)) & 1) &&
+                 ((info->destination_modes >> (destination_method + 1)) & 1);
+    form.words = word_counts[source_method + 1][destination_method + 1];
+    form.first_word = (opcode_value << 11) | source_bits[source_method + 1] |
+                      destination_bits[destination_method + 1] | A;
+    return form;
+}
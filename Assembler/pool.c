@@ -0,0 +1,250 @@
+/* pthreads are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include "HEDER.h"
+
+/*
+ * Every worker starts with an equal, contiguous range of the tasks and takes
+ * them from the front. A worker whose range is empty steals the back half of
+ * the range of another worker, so a worker that got the slow tasks is helped
+ * by the others.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int begin; /* The next task of the range */
+    int end; /* The task after the last one */
+} TaskRange;
+
+typedef struct TaskPool {
+    TaskRange *ranges; /* One per worker */
+    int worker_count;
+    int task_count;
+    TaskFunction run;
+    FinishFunction finish;
+    void *context;
+    pthread_mutex_t order_lock; /* Guards the fields below */
+    char *done; /* done[task] is set once the task ran */
+    int next_finish; /* The first task that was not finished */
+    int last_task; /* The last task that is finished, the first one that failed if any did */
+    int failed;
+} TaskPool;
+
+typedef struct {
+    TaskPool *pool;
+    int worker;
+} Worker;
+
+/**
+ * @brief Takes the next task of the range of a worker.
+ * @param range The range of the worker.
+ * @return The task, or -1 if the range is empty.
+ */
+static int takeTask(TaskRange *range) {
+    int task = -1;
+
+    pthread_mutex_lock(&range->lock);
+    if (range->begin < range->end) {
+        task = range->begin++;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return task;
+}
+
+/**
+ * @brief Moves the back half of the range of another worker to the range of a worker.
+ * @param pool The pool.
+ * @param worker The worker whose range is empty.
+ * @return 1 if tasks were stolen and 0 if every range is empty.
+ */
+static int stealTasks(TaskPool *pool, int worker) {
+    TaskRange *victim;
+    int i, begin = 0, end = 0;
+
+    for (i = 1; i < pool->worker_count && begin == end; i++) {
+        victim = &pool->ranges[(worker + i) % pool->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            end = victim->end;
+            begin = victim->end - (victim->end - victim->begin + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    if (begin == end) {
+        return 0;
+    }
+    pthread_mutex_lock(&pool->ranges[worker].lock);
+    pool->ranges[worker].begin = begin;
+    pool->ranges[worker].end = end;
+    pthread_mutex_unlock(&pool->ranges[worker].lock);
+    return 1;
+}
+
+/**
+ * @brief Removes the tasks after a task from every range, so they are never started.
+ * @param pool The pool.
+ * @param task The last task that may still run.
+ */
+static void stopTasks(TaskPool *pool, int task) {
+    int i;
+
+    for (i = 0; i < pool->worker_count; i++) {
+        pthread_mutex_lock(&pool->ranges[i].lock);
+        if (pool->ranges[i].end > task + 1) {
+            pool->ranges[i].end = pool->ranges[i].begin > task + 1 ? pool->ranges[i].begin : task + 1;
+        }
+        pthread_mutex_unlock(&pool->ranges[i].lock);
+    }
+}
+
+/**
+ * @brief Records a task that ran, and finishes every task that can be finished in order.
+ * @param pool The pool.
+ * @param task The task that ran.
+ * @param result What the task gave back, 1 stops the pool.
+ */
+static void completeTask(TaskPool *pool, int task, int result) {
+    int stop;
+
+    pthread_mutex_lock(&pool->order_lock);
+    pool->done[task] = 1;
+    stop = result != 0 && (!pool->failed || task < pool->last_task);
+    if (stop) {
+        pool->last_task = task;
+        pool->failed = 1;
+    }
+    while (pool->next_finish <= pool->last_task && pool->done[pool->next_finish]) {
+        if (pool->finish != NULL) {
+            pool->finish(pool->next_finish, pool->context);
+        }
+        pool->next_finish++;
+    }
+    pthread_mutex_unlock(&pool->order_lock);
+    if (stop) {
+        stopTasks(pool, task);
+    }
+}
+
+/**
+ * @brief Checks if a task comes after a task that failed.
+ *
+ * A range stolen just before a task failed may still hold the tasks after it.
+ *
+ * @param pool The pool.
+ * @param task The task.
+ * @return 1 if the task must not run and 0 otherwise.
+ */
+static int isCancelled(TaskPool *pool, int task) {
+    int cancelled;
+
+    pthread_mutex_lock(&pool->order_lock);
+    cancelled = task > pool->last_task;
+    pthread_mutex_unlock(&pool->order_lock);
+    return cancelled;
+}
+
+/**
+ * @brief Runs tasks until every range is empty.
+ * @param argument The worker.
+ * @return NULL.
+ */
+static void *runWorker(void *argument) {
+    Worker *worker = (Worker *)argument;
+    TaskPool *pool = worker->pool;
+    int task;
+
+    for (;;) {
+        task = takeTask(&pool->ranges[worker->worker]);
+        if (task == -1) {
+            if (!stealTasks(pool, worker->worker)) {
+                break;
+            }
+            continue;
+        }
+        if (isCancelled(pool, task)) {
+            continue;
+        }
+        completeTask(pool, task, pool->run(task, worker->worker, pool->context));
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs tasks on a pool of threads.
+ *
+ * The tasks run in any order and at the same time, but finish is called
+ * once for every task, one at a time and in the order of the tasks, as soon
+ * as all the tasks before it ran. If a task gives back 1 the pool stops after
+ * it, as a loop would: the tasks before it still run and are finished, and
+ * the tasks after it are not started (or, if they already ran, not finished).
+ *
+ * @param task_count The number of tasks.
+ * @param worker_count The number of threads, the calling thread is one of them.
+ * @param run Runs a task on a worker, gives back 0 or 1 to stop the pool.
+ * @param finish Finishes a task in order, or NULL.
+ * @param context Passed to run and finish.
+ * @return 0 if every task ran and gave back 0, and 1 otherwise.
+ */
+int runTasks(int task_count, int worker_count, TaskFunction run, FinishFunction finish, void *context) {
+    TaskPool pool;
+    Worker *workers;
+    pthread_t *threads;
+    int i, started, failed;
+
+    if (worker_count > task_count) {
+        worker_count = task_count;
+    }
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    pool.worker_count = worker_count;
+    pool.task_count = task_count;
+    pool.run = run;
+    pool.finish = finish;
+    pool.context = context;
+    pool.next_finish = 0;
+    pool.last_task = task_count - 1;
+    pool.failed = 0;
+    pool.ranges = (TaskRange *)malloc(worker_count * sizeof(TaskRange));
+    pool.done = (char *)calloc((size_t)task_count + 1, 1);
+    workers = (Worker *)malloc(worker_count * sizeof(Worker));
+    threads = (pthread_t *)malloc(worker_count * sizeof(pthread_t));
+    if (pool.ranges == NULL || pool.done == NULL || workers == NULL || threads == NULL) {
+        perror("ERR: Unable to allocate memory for the threads");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&pool.order_lock, NULL);
+    for (i = 0; i < worker_count; i++) {
+        pthread_mutex_init(&pool.ranges[i].lock, NULL);
+        pool.ranges[i].begin = (int)((long)task_count * i / worker_count);
+        pool.ranges[i].end = (int)((long)task_count * (i + 1) / worker_count);
+        workers[i].pool = &pool;
+        workers[i].worker = i;
+    }
+
+    /* A worker that can't be started leaves its range to be stolen by the others */
+    started = 1;
+    for (i = 1; i < worker_count; i++) {
+        if (pthread_create(&threads[i], NULL, runWorker, &workers[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+    runWorker(&workers[0]);
+    for (i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    failed = pool.failed;
+    for (i = 0; i < worker_count; i++) {
+        pthread_mutex_destroy(&pool.ranges[i].lock);
+    }
+    pthread_mutex_destroy(&pool.order_lock);
+    free(pool.ranges);
+    free(pool.done);
+    free(workers);
+    free(threads);
+    return failed;
+}
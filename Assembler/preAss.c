@@ -1,231 +1,404 @@
 #include <stdio.h>
 #include "HEDER.h"
 
-Macro macros[MAX_MACROS];  
-int macro_count;   
-
 /**
- * @brief Trims leading and trailing whitespace from a string and reduces multiple spaces to a single space.
- * @param str A pointer to the string to be processed.
+ * @brief Appends a text to a text buffer, keeping the buffer null terminated.
+ * @param buffer The text buffer.
+ * @param text The text to append, it doesn't have to be null terminated.
+ * @param length The length of the text.
  * @returns void
  */
-void trim_whitespace(char* str) {
-    char* dest = str;  /* Destination pointer for modifying the string in place*/
-    char* src = str;   /* Source pointer for iterating over the string*/
-    int in_word = 0;
-
-    /*Trim leading spaces*/
-    while (isspace((unsigned char)*src)) src++;
-
-    while (*src != '\0') {
-        if (isspace((unsigned char)*src)) {
-            if (in_word) {
-                *dest++ = ' ';  /* Replace multiple spaces with a single space*/
-                in_word = 0;
-            }
-        } else {
-            *dest++ = *src;  /* Copy non-space characters*/
-            in_word = 1;
-        }
-        src++;
+void appendText(TextBuffer *buffer, const char *text, int length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        buffer->chars = (char *)arenaGrow(buffer->arena, buffer->chars, buffer->capacity,
+                                          (buffer->length + length + 1) * 2);
+        buffer->capacity = (buffer->length + length + 1) * 2;
     }
+    memcpy(buffer->chars + buffer->length, text, length);
+    buffer->length += length;
+    buffer->chars[buffer->length] = '\0';
+}
 
-    /*Remove trailing space*/
-    if (dest > str && isspace((unsigned char)*(dest - 1))) {
-        dest--;
-    }
+/**
+ * @brief Writes a text to a file with a single write.
+ *
+ * If the thread captures its outputs (see captureOutputs) the file is kept
+ * in memory instead.
+ *
+ * @param name_of_file The name of the file.
+ * @param text The text.
+ * @param length The length of the text.
+ * @returns 0 if succeded and 1 otherwise.
+ */
+int writeTextFile(const char *name_of_file, const char *text, int length) {
+    FILE *file;
 
-    *dest = '\0';  /* Null-terminate the modified string*/
+    if (captureOutput(name_of_file, text, length)) {
+        return 0;
+    }
+    /* A new file, so an output linked to the build cache is replaced and not written into */
+    remove(name_of_file);
+    file = fopen(name_of_file, "w");
+    if (!file) {
+        reportError("ERR: Failed to open file");
+        return 1;
+    }
+    if (fwrite(text, 1, (size_t)length, file) != (size_t)length) {
+        reportError("ERR: Failed to write file");
+        fclose(file);
+        return 1;
+    }
+    fclose(file);
+    return 0;
 }
 
-
 /**
- * @brief Trims lines that contain null only.
- * @param input_file is the name of the input file.
+ * @brief Doubles the slot array of the macro databank and places all the macros again.
+ * @param table The macro databank to grow.
  * @returns void
  */
-void remove_blank_lines(const char *input_file) {
-    FILE *fin, *temp, *fout;
-    char trimmed_line[MAX_LINE_LENGTH];
-    char line[MAX_LINE_LENGTH];
-
-    fin = fopen(input_file, "r");
-    if (!fin) {
-        perror("ERR:Error opening input file");
-        return;
-    }
+static void growMacroSlots(MacroTable *table) {
+    int i, slot, mask;
+    int new_count = table->slot_count ? table->slot_count * 2 : 32;
+    int *new_slots = (int *)arenaAlloc(table->arena, new_count * sizeof(int));
 
-    temp = tmpfile();
-    if (!temp) {
-        perror("Error creating temporary file");
-        fclose(fin);
-        return;
+    for (i = 0; i < new_count; i++) {
+        new_slots[i] = -1;
     }
+    mask = new_count - 1;
+    for (i = 0; i < table->count; i++) {
+        slot = (int)(table->macros[i].hash & (unsigned long)mask);
+        while (new_slots[slot] != -1) {
+            slot = (slot + 1) & mask;
+        }
+        new_slots[slot] = i;
+    }
+    table->slots = new_slots;
+    table->slot_count = new_count;
+}
 
-    while (fgets(line, sizeof(line), fin)) {
-        strcpy(trimmed_line, line);
-        trim_whitespace(trimmed_line);
-
-        if (*trimmed_line != '\0' && *trimmed_line != '\n') {
-            fputs(line, temp);
+/**
+ * @brief Finds the hash slot of a macro name.
+ * @param table The macro databank of the file, with at least one slot.
+ * @param name The name to search for.
+ * @param hash The hash of the name.
+ * @returns The index of the slot that holds the name or the empty slot where it belongs.
+ */
+static int findMacroSlot(const MacroTable *table, Span name, unsigned long hash) {
+    int mask = table->slot_count - 1;
+    int slot = (int)(hash & (unsigned long)mask);
+    const Macro *macro;
+
+    while (table->slots[slot] != -1) {
+        macro = &table->macros[table->slots[slot]];
+        if (macro->hash == hash && macro->name.length == name.length &&
+            memcmp(macro->name.start, name.start, (size_t)name.length) == 0) {
+            return slot;
         }
+        slot = (slot + 1) & mask;
     }
+    return slot;
+}
 
-    fclose(fin);
+/**
+ * @brief Adds a new macro to the macro databank.
+ *
+ * The expansion was built in the arena by process_file, so the macro takes
+ * it over without copying. If the name is already defined the first
+ * definition is kept. The databank grows when it is full.
+ *
+ * @param table The macro databank of the file.
+ * @param name name of macro, a view of the source.
+ * @param text The expansion of the macro, allocated from the arena.
+ * @param length The length of the expansion.
+ * @returns void
+ */
+void add_macro(MacroTable *table, Span name, const char *text, int length) {
+    unsigned long hash = hashName(name.start, name.length);
+    Macro *macro;
+    int slot;
 
-    fout = fopen(input_file, "w");
-    if (!fout) {
-        perror("Error opening output file");
-        fclose(temp);
+    if ((table->count + 1) * 2 > table->slot_count) {
+        growMacroSlots(table);
+    }
+    slot = findMacroSlot(table, name, hash);
+    if (table->slots[slot] != -1) {
         return;
     }
+    if (table->count == table->capacity) {
+        table->macros = (Macro *)arenaGrow(table->arena, table->macros, table->capacity * sizeof(Macro),
+                                           (table->capacity ? table->capacity * 2 : 16) * sizeof(Macro));
+        table->capacity = table->capacity ? table->capacity * 2 : 16;
+    }
+    macro = &table->macros[table->count];
+    macro->name = name;
+    macro->hash = hash;
+    macro->text = text;
+    macro->length = length;
+    table->slots[slot] = table->count++;
+}
 
-    rewind(temp);
-    while (fgets(line, sizeof(line), temp)) {
-        fputs(line, fout);
+/**
+ * @brief Finds a macro in one table, without its libraries.
+ * @param table The macro databank or library to search.
+ * @param name The name to search for.
+ * @param hash The hash of the name.
+ * @returns The macro, or NULL if the name is not in the table.
+ */
+static Macro *findMacro(const MacroTable *table, Span name, unsigned long hash) {
+    int slot;
+
+    if (table->count == 0) {
+        return NULL;
     }
+    slot = findMacroSlot(table, name, hash);
+    return table->slots[slot] == -1 ? NULL : &table->macros[table->slots[slot]];
+}
+
+/**
+ * @brief Gives back the body of a macro that was callen.
+ *
+ * The macros of the file come first, then the included libraries in the
+ * order they were included.
+ *
+ * @param table The macro databank of the file.
+ * @param name is the name of the macro called.
+ * @returns Macro structure, or NULL if the name is not a macro.
+ */
+Macro* get_macro(MacroTable *table, Span name) {
+    unsigned long hash;
+    Macro *macro;
+    int i;
 
-    fclose(fout);
-    fclose(temp);
+    if (table->count == 0 && table->library_count == 0) {
+        return NULL;
+    }
+    hash = hashName(name.start, name.length);
+    macro = findMacro(table, name, hash);
+    for (i = 0; macro == NULL && i < table->library_count; i++) {
+        macro = findMacro(table->libraries[i], name, hash);
+    }
+    return macro;
 }
 
 /**
- * @brief Adds a new macro to the macro databank.
- * @param name name of macro.
- * @param body A 2D array containing the lines that form the body of the macro.
- * @param body_lines The number of lines in the macro's body. 
+ * @brief Makes the macros of a library visible to a macro databank.
+ * @param table The macro databank of the file.
+ * @param library The library, included only once however many times it is asked for.
  * @returns void
  */
-void add_macro(const char* name, char body[][MAX_LINE_LENGTH], int body_lines) {
+static void addLibrary(MacroTable *table, const MacroTable *library) {
     int i;
-    if (macro_count < MAX_MACROS) {
-        strcpy(macros[macro_count].name, name);
-        macros[macro_count].body_lines = body_lines;
-        for (i = 0; i < body_lines; ++i) {
-            strcpy(macros[macro_count].body[i], body[i]);
+
+    for (i = 0; i < table->library_count; i++) {
+        if (table->libraries[i] == library) {
+            return;
         }
-        macro_count++;
-    } else {
-        fprintf(stderr, "ERR:Maximum number of macros exceeded.\n");
     }
+    if (table->library_count == table->library_capacity) {
+        table->libraries = (const MacroTable **)arenaGrow(table->arena, (void *)table->libraries,
+                                                          table->library_capacity * sizeof(MacroTable *),
+                                                          (table->library_capacity ? table->library_capacity * 2 : 4) *
+                                                          sizeof(MacroTable *));
+        table->library_capacity = table->library_capacity ? table->library_capacity * 2 : 4;
+    }
+    table->libraries[table->library_count++] = library;
 }
 
 /**
- * @brief Gives back the body of a macro that was callen.
- * @param name is the name of the macro called.
- * @returns Macro structure.
+ * @brief Reads an `.include "name"` line and loads the library it names.
+ * @param table The macro databank of the file.
+ * @param scan The scan of the text the line is in.
+ * @param line The view of the line, starting with ".include".
+ * @param cache The libraries of the batch, or NULL if the text is a library itself.
+ * @returns 0 if succeded and 1 otherwise.
  */
-Macro* get_macro(const char* name) {
-    int i;
-    for (i = 0; i < macro_count; ++i) {
-        if (strcmp(macros[i].name, name) == 0) {
-            return &macros[i];
-        }
+static int includeLibrary(MacroTable *table, const Scan *scan, Span line, LibraryCache *cache) {
+    Span name;
+    char *path;
+    const MacroTable *library;
+
+    name.start = line.start + 8;
+    name.length = line.length - 8;
+    name = trimSpan(scan, name);
+    if (cache == NULL) {
+        report("ERR: a macro library can't include another library\n");
+        return 1;
+    }
+    if (name.length < 2 || name.start[0] != '"' || name.start[name.length - 1] != '"') {
+        report("ERR: .include needs a quoted file name: %.*s\n", line.length, line.start);
+        return 1;
+    }
+    path = (char *)arenaAlloc(table->arena, (size_t)name.length - 1);
+    memcpy(path, name.start + 1, (size_t)name.length - 2);
+    path[name.length - 2] = '\0';
+
+    library = loadLibrary(cache, path);
+    if (library == NULL) {
+        return 1;
     }
-    return NULL;
+    addLibrary(table, library);
+    return 0;
 }
 
 /**
- * @brief Makes a new file without macros and without comments ";"
- * @param input_file name of file with macro.
- * @param output_file name of file after the macro process.
+ * @brief Appends a line with its macros expanded and its words separated by single spaces.
+ *
+ * A macro is written as its whole expansion in one copy, starting where the
+ * token was and without a space before it.
+ *
+ * @param output The text buffer.
+ * @param scan The scan of the text the line is in.
+ * @param line The view of the line.
+ * @param table The macro databank of the file.
  * @returns void
  */
-void process_file(const char* input_file, const char* output_file) {
-    FILE *fin, *fout;
-    char line[MAX_LINE_LENGTH];
-    int i, in_macro_definition, first_token, body_line_count;
-    char current_macro_name[MAX_MACRO_NAME];
-    char macro_body[MAX_MACRO_BODY][MAX_LINE_LENGTH];
-    char *token;
-
-    fin = fopen(input_file, "r");
-    fout = fopen(output_file, "w");
-
-    if (!fin || !fout) {
-        perror("ERR: Error opening file PrePass");
-        if (fin) fclose(fin);
-        if (fout) fclose(fout);
-        return;
+static void expandLine(TextBuffer *output, const Scan *scan, Span line, MacroTable *table) {
+    Span token;
+    Macro *macro;
+    int first_token = 1;
+
+    while (nextToken(scan, &line, SPACES, &token)) {
+        macro = get_macro(table, token);
+        if (macro) {
+            if (macro->length > 0) {
+                appendText(output, macro->text, macro->length);
+            }
+        } else {
+            if (!first_token) {
+                appendText(output, " ", 1);
+            }
+            appendText(output, token.start, token.length);
+        }
+        first_token = 0;
     }
+}
 
-    in_macro_definition = 0;
-    body_line_count = 0;
-
-    while (fgets(line, sizeof(line), fin)) {
-        trim_whitespace(line); /*triming the blanks that could cause an error*/
+/**
+ * @brief Expands the macros of a source, without comments ";" and without blank lines.
+ *
+ * The source is classified once by the block scanner and then read through
+ * views, and lines have no length limit. Every output line has its words
+ * separated by single spaces. A macro body is normalized and expanded once,
+ * when it is defined, so a body may call the macros defined before it and
+ * every call is a single copy of the finished text. An `.include "name"`
+ * line makes the macros of a library visible from that line on.
+ *
+ * @param source The text of the source file, it doesn't have to be null terminated.
+ * @param length The length of the source.
+ * @param output The text buffer the expanded source is appended to.
+ * @param table The macro databank of the file.
+ * @param cache The libraries of the batch, or NULL if the source is a library itself.
+ * @returns 0 if succeded and 1 if a library could not be included.
+ */
+int process_file(const char* source, int length, TextBuffer *output, MacroTable *table, LibraryCache *cache) {
+    const char *cursor = source;
+    Scan scan;
+    Span line, rest;
+    int in_macro_definition;
+    int errors = 0;
+    Span current_macro_name;
+    TextBuffer body;
 
-        /* Skip lines that start with ';' */
-        if (line[0] == ';') {
+    in_macro_definition = 0;
+    current_macro_name.start = source;
+    current_macro_name.length = 0;
+    body.chars = NULL;
+    body.length = 0;
+    body.capacity = 0;
+    body.arena = table->arena;
+
+    scanText(&scan, source, length, table->arena);
+    while (nextLine(&scan, &cursor, &line)) {
+        line = trimSpan(&scan, line); /*triming the blanks that could cause an error*/
+
+        /* Skip blank lines and lines that start with ';' */
+        if (line.length == 0 || line.start[0] == ';') {
             continue;
         }
 
         if (in_macro_definition) {
-            if (strcmp(line, "endmacr") == 0) {
-                add_macro(current_macro_name, macro_body, body_line_count);
+            if (spanEquals(line, "endmacr")) {
+                add_macro(table, current_macro_name, body.chars ? body.chars : "", body.length);
                 in_macro_definition = 0;
             } else {
-                trim_whitespace(line);
-                strcpy(macro_body[body_line_count++], line);
+                /* Nothing else is allocated while a body is read, so it grows in place */
+                if (body.length > 0) {
+                    appendText(&body, "\n", 1);
+                }
+                expandLine(&body, &scan, line, table);
             }
         } else {
-            if (strncmp(line, "macr", 4) == 0) {
-                sscanf(line, "macr %[^\n]", current_macro_name);
+            if (line.length >= 4 && strncmp(line.start, "macr", 4) == 0) {
+                rest.start = line.start + 4;
+                rest.length = line.length - 4;
+                current_macro_name = trimSpan(&scan, rest);
                 in_macro_definition = 1;
-                body_line_count = 0;
+                /* Every macro gets its own body */
+                body.chars = NULL;
+                body.length = 0;
+                body.capacity = 0;
+            } else if (line.length >= 8 && strncmp(line.start, ".include", 8) == 0 &&
+                       (line.length == 8 || isspace((unsigned char)line.start[8]))) {
+                errors |= includeLibrary(table, &scan, line, cache);
             } else {
-                token = strtok(line, " ");
-                first_token = 1;
-
-                while (token) {
-                    Macro* macro = get_macro(token);
-                    if (macro) {
-                        for (i = 0; i < macro->body_lines; i++) {
-                            if (i == macro->body_lines - 1)
-                                fprintf(fout, "%s", macro->body[i]);
-                            else
-                                fprintf(fout, "%s\n", macro->body[i]);
-                        }
-                    } else {
-                        if (!first_token) {
-                            fprintf(fout, " ");
-                        }
-                        fprintf(fout, "%s", token);
-                    }
-                    token = strtok(NULL, " ");
-                    first_token = 0;
-                }
-                fprintf(fout, "\n");
+                expandLine(output, &scan, line, table);
+                appendText(output, "\n", 1);
             }
         }
     }
-
-    fclose(fin);
-    fclose(fout);
+    return errors;
 }
 
 /**
- * @brief Makes a new file callen "input file".am (after macro) after macro process.
- * @param name_of_file is the name of input file from the main.
- * @returns 0 if succeded and 1 otherwise.
+ * @brief Initializes an empty macro databank.
+ * @param table A pointer to the databank to be initialized.
+ * @param arena The arena that owns the memory of the databank.
+ * @returns void
  */
-int preAss(char *name_of_file) {
-    char output_file[80];
-    char *dot_pos;
-
-    if (!name_of_file)
-        return 1;
+void initMacroTable(MacroTable *table, Arena *arena) {
+    table->macros = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->slots = NULL;
+    table->slot_count = 0;
+    table->libraries = NULL;
+    table->library_count = 0;
+    table->library_capacity = 0;
+    table->arena = arena;
+}
 
-    remove_blank_lines(name_of_file);
+/**
+ * @brief Expands the macros of a source file in memory.
+ *
+ * The macros are views of the source and the expanded text is kept in the
+ * per-file arena, so they are gone once the arena is reset for the next
+ * file. The included libraries stay in the batch cache for the next files.
+ * The source itself is never modified.
+ *
+ * @param source The source file.
+ * @param cache The libraries of the batch.
+ * @param arena The per-file arena.
+ * @param expanded The view of the expanded source, the text of the ".am" file.
+ * @returns 0 if succeded and 1 if a library could not be included.
+ */
+int preAss(const SourceFile *source, LibraryCache *cache, Arena *arena, Span *expanded) {
+    MacroTable table;
+    TextBuffer output;
+    int errors;
+
+    initMacroTable(&table, arena);
+    if (cache != NULL) {
+        cache->file++;
+    }
 
-    strcpy(output_file, name_of_file);
-    dot_pos = strrchr(output_file, '.');
+    output.chars = NULL;
+    output.length = 0;
+    output.capacity = 0;
+    output.arena = arena;
 
-    if (dot_pos && strcmp(dot_pos, ".as") == 0) {
-        strcpy(dot_pos, ".am");  /* Replace ".in" with ".am" */
-    } else {
-        printf("ERR:no .am file to proceed\n");  /* In case there is no ".in", append ".am" */
-    }
-    process_file(name_of_file, output_file);
-    return 0;
+    errors = process_file(source->text, source->length, &output, &table, cache);
+    expanded->start = output.chars ? output.chars : "";
+    expanded->length = output.length;
+    return errors;
 }
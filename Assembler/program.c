@@ -0,0 +1,174 @@
+#include "HEDER.h"
+
+/* Lines the line table has room for before it first grows */
+#define INITIAL_LINES 256
+
+/**
+ * @brief Initializes an empty program in an arena.
+ *
+ * The line table, the data pool and the string pool start small and grow
+ * as lines, words and texts are added. All the memory of the program
+ * belongs to the arena and is released when the arena is reset.
+ *
+ * @param program A pointer to the program to be initialized.
+ * @param arena The per-file arena that owns the memory of the program.
+ */
+void initProgram(Program *program, Arena *arena) {
+    LineTable *lines = &program->lines;
+
+    program->arena = arena;
+
+    lines->count = 0;
+    lines->capacity = 0;
+    lines->opcode_value = NULL;
+    lines->source_method = NULL;
+    lines->destination_method = NULL;
+    lines->source_value = NULL;
+    lines->destination_value = NULL;
+    lines->memory_value = NULL;
+    lines->memory_cells = NULL;
+    lines->info = NULL;
+
+    initSymbolTable(&program->symbols, arena);
+
+    program->data.values = NULL;
+    program->data.count = 0;
+    program->data.capacity = 0;
+
+    program->strings.chars = NULL;
+    program->strings.length = 0;
+    program->strings.capacity = 0;
+}
+
+/**
+ * @brief Doubles the capacity of every array of the line table.
+ * @param program The program that owns the line table.
+ */
+static void growLines(Program *program) {
+    LineTable *lines = &program->lines;
+    Arena *arena = program->arena;
+    size_t old_count = lines->capacity;
+    size_t new_count = lines->capacity ? lines->capacity * 2 : INITIAL_LINES;
+
+    lines->opcode_value = (signed char *)arenaGrow(arena, lines->opcode_value, old_count * sizeof(signed char),
+                                                   new_count * sizeof(signed char));
+    lines->source_method = (signed char *)arenaGrow(arena, lines->source_method, old_count * sizeof(signed char),
+                                                    new_count * sizeof(signed char));
+    lines->destination_method = (signed char *)arenaGrow(arena, lines->destination_method,
+                                                         old_count * sizeof(signed char),
+                                                         new_count * sizeof(signed char));
+    lines->source_value = (int *)arenaGrow(arena, lines->source_value, old_count * sizeof(int),
+                                           new_count * sizeof(int));
+    lines->destination_value = (int *)arenaGrow(arena, lines->destination_value, old_count * sizeof(int),
+                                                new_count * sizeof(int));
+    lines->memory_value = (int *)arenaGrow(arena, lines->memory_value, old_count * sizeof(int),
+                                           new_count * sizeof(int));
+    lines->memory_cells = (int *)arenaGrow(arena, lines->memory_cells, old_count * sizeof(int),
+                                           new_count * sizeof(int));
+    lines->info = (LineInfo *)arenaGrow(arena, lines->info, old_count * sizeof(LineInfo),
+                                        new_count * sizeof(LineInfo));
+    lines->capacity = (int)new_count;
+}
+
+/**
+ * @brief Adds a line with default values to the line table.
+ *
+ * Methods and the opcode are set to -1, the label and text to none, and
+ * every flag to false. The table grows when it is full.
+ *
+ * @param program The program that owns the line table.
+ * @return The index of the new line.
+ */
+int addLine(Program *program) {
+    LineTable *lines = &program->lines;
+    LineInfo *info;
+    int index = lines->count;
+
+    if (index == lines->capacity) {
+        growLines(program);
+    }
+    lines->opcode_value[index] = -1; /* Invalid value as default */
+    lines->source_method[index] = -1;
+    lines->destination_method[index] = -1;
+    lines->source_value[index] = 0;
+    lines->destination_value[index] = 0;
+    lines->memory_value[index] = MIN_MEM_VAL;
+    lines->memory_cells[index] = 0;
+
+    info = &lines->info[index];
+    info->label = -1;
+    info->text = -1;
+    info->data_start = 0;
+    info->count_op = -1;
+    info->is_data = false;
+    info->is_string = false;
+    info->is_entry = false;
+    info->is_extern = false;
+    info->flag = false;
+
+    lines->count++;
+    return index;
+}
+
+/**
+ * @brief Copies a text into the string pool of the program, with a null at its end.
+ * @param program The program that owns the string pool.
+ * @param str The text to copy, it doesn't have to be null terminated.
+ * @param length The length of the text.
+ * @return The offset of the copy in the pool.
+ */
+int addString(Program *program, const char *str, int length) {
+    StringPool *strings = &program->strings;
+    int offset = strings->length;
+
+    if (strings->length + length + 1 > strings->capacity) {
+        strings->chars = (char *)arenaGrow(program->arena, strings->chars, strings->capacity,
+                                           (strings->length + length + 1) * 2);
+        strings->capacity = (strings->length + length + 1) * 2;
+    }
+    memcpy(strings->chars + offset, str, length);
+    strings->chars[offset + length] = '\0';
+    strings->length += length + 1;
+    return offset;
+}
+
+/**
+ * @brief Gives back the text of a line from the string pool.
+ * @param program The program that owns the line.
+ * @param index The index of the line.
+ * @return The text of the line, or an empty string if the line has no text.
+ */
+const char *lineText(const Program *program, int index) {
+    int text = program->lines.info[index].text;
+    return text == -1 ? "" : program->strings.chars + text;
+}
+
+/**
+ * @brief Adds a word to the data pool of the program.
+ * @param program The program that owns the data pool.
+ * @param value The value of the word.
+ */
+void addDataValue(Program *program, int value) {
+    DataPool *data = &program->data;
+
+    if (data->count == data->capacity) {
+        data->values = (int *)arenaGrow(program->arena, data->values, data->capacity * sizeof(int),
+                                        (data->capacity ? data->capacity * 2 : 64) * sizeof(int));
+        data->capacity = data->capacity ? data->capacity * 2 : 64;
+    }
+    data->values[data->count++] = value;
+}
+
+/**
+ * @brief Builds the name of an output file from the base name of the source.
+ * @param arena The per-file arena that the name is allocated from.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param extension The extension of the output file, with its dot.
+ * @return The name of the output file.
+ */
+char *outputName(Arena *arena, const char *base_name, const char *extension) {
+    char *name = arenaString(arena, base_name, strlen(extension));
+
+    strcat(name, extension);
+    return name;
+}
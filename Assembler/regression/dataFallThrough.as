@@ -0,0 +1,5 @@
+; the run falls from an instruction into data, which is not an instruction
+MAIN: prn #65
+X: .data 5
+ prn #66
+ stop
@@ -0,0 +1,10 @@
+; data between the instructions is written to, by label and through a register
+MAIN: mov #3, r1
+ jmp GO
+X: .data 5
+GO: add r1, X
+ prn X
+ lea X, r2
+ inc *r2
+ prn X
+ stop
@@ -0,0 +1,9 @@
+; an instruction placed after data is rewritten through a register
+MAIN: jmp GO
+W: .data 532
+V: .data 0
+GO: lea PATCH, r4
+ inc r4
+ mov W, *r4
+PATCH: prn #65
+ stop
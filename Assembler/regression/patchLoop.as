@@ -0,0 +1,13 @@
+; every 'a' of the input makes the prn of the loop print the next letter
+MAIN: lea SHOW, r4
+ inc r4
+LOOP: red r1
+ cmp r1, #-1
+ bne MORE
+ stop
+MORE: cmp r1, #97
+ bne SHOW
+ add #8, *r4
+SHOW: prn #65
+ jmp LOOP
+COUNT: .data 0
@@ -0,0 +1,161 @@
+/* Sockets are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/**
+ * @brief Gives the path of the socket of the daemon.
+ * @param given The path given on the command line, or NULL.
+ * @return The given path, or $ASSEMBLER_SOCKET, or DEFAULT_SOCKET.
+ */
+const char *socketPath(const char *given) {
+    const char *path = given ? given : getenv("ASSEMBLER_SOCKET");
+
+    return path && path[0] ? path : DEFAULT_SOCKET;
+}
+
+/**
+ * @brief Fills the address of a Unix domain socket.
+ * @param address The address.
+ * @param path The path of the socket.
+ * @return 0 if succeded and 1 if the path is too long.
+ */
+static int socketAddress(struct sockaddr_un *address, const char *path) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        return 1;
+    }
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+/**
+ * @brief Creates the socket of the daemon, replacing the one of a daemon that is gone.
+ * @param path The path of the socket.
+ * @return The listening socket, or -1 if it can't be created.
+ */
+int listenSocket(const char *path) {
+    struct sockaddr_un address;
+    int fd;
+
+    if (socketAddress(&address, path) == 1) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(fd, 16) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Connects to the daemon.
+ * @param path The path of the socket.
+ * @return The connected socket, or -1 if no daemon listens on it.
+ */
+int connectSocket(const char *path) {
+    struct sockaddr_un address;
+    int fd;
+
+    if (socketAddress(&address, path) == 1) {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sends a buffer whole, a socket may take it in parts.
+ * @param fd The socket.
+ * @param data The buffer.
+ * @param length The length of the buffer.
+ * @return 0 if succeded and 1 if the other side is gone.
+ */
+int sendAll(int fd, const void *data, size_t length) {
+    const char *cursor = (const char *)data;
+    ssize_t count;
+
+    while (length > 0) {
+        count = write(fd, cursor, length);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return 1;
+        }
+        cursor += count;
+        length -= (size_t)count;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receives a buffer whole.
+ * @param fd The socket.
+ * @param data The buffer.
+ * @param length The length to receive.
+ * @return 0 if succeded and 1 if the other side is gone.
+ */
+int receiveAll(int fd, void *data, size_t length) {
+    char *cursor = (char *)data;
+    ssize_t count;
+
+    while (length > 0) {
+        count = read(fd, cursor, length);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return 1;
+        }
+        cursor += count;
+        length -= (size_t)count;
+    }
+    return 0;
+}
+
+/**
+ * @brief Packs the options of the command line into the bits of a request.
+ * @param options The options.
+ * @return The REQUEST_* bits.
+ */
+int packOptions(const Options *options) {
+    return (options->write_am ? REQUEST_AM : 0) | (options->write_afp ? REQUEST_AFP : 0) |
+           (options->write_asp ? REQUEST_ASP : 0) | (options->write_aml ? REQUEST_AML : 0) |
+           (options->write_bo ? REQUEST_BO : 0) | (options->write_c ? REQUEST_C : 0);
+}
+
+/**
+ * @brief Unpacks the bits of a request into options, for a single job.
+ * @param bits The REQUEST_* bits.
+ * @param options The options.
+ */
+void unpackOptions(int bits, Options *options) {
+    options->write_am = (bits & REQUEST_AM) != 0;
+    options->write_afp = (bits & REQUEST_AFP) != 0;
+    options->write_asp = (bits & REQUEST_ASP) != 0;
+    options->write_aml = (bits & REQUEST_AML) != 0;
+    options->write_bo = (bits & REQUEST_BO) != 0;
+    options->write_c = (bits & REQUEST_C) != 0;
+    options->jobs = 1;
+    options->cache = NULL;
+    options->batch_io = false;
+}
@@ -0,0 +1,192 @@
+#include <limits.h>
+#include "HEDER.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_SCANNERS 1
+#endif
+
+/* A block is classified into one 32 bit mask of each class */
+typedef char scan_mask_has_32_bits[(sizeof(unsigned int) * CHAR_BIT >= SCAN_BLOCK) ? 1 : -1];
+
+typedef void (*ScanBlocks)(const char *text, int blocks, unsigned int *spaces, unsigned int *commas,
+                           unsigned int *newlines);
+
+/**
+ * @brief Classifies blocks of text one character at a time.
+ *
+ * This is the fallback for processors without SSE2 and the reference the
+ * vector versions must agree with.
+ *
+ * @param text The text, blocks * SCAN_BLOCK characters.
+ * @param blocks The number of blocks.
+ * @param spaces The whitespace masks, one per block.
+ * @param commas The comma masks, one per block.
+ * @param newlines The newline masks, one per block.
+ */
+static void scanBlocksScalar(const char *text, int blocks, unsigned int *spaces, unsigned int *commas,
+                             unsigned int *newlines) {
+    int i, j;
+    unsigned char c;
+
+    for (i = 0; i < blocks; i++) {
+        spaces[i] = commas[i] = newlines[i] = 0;
+        for (j = 0; j < SCAN_BLOCK; j++) {
+            c = (unsigned char)text[i * SCAN_BLOCK + j];
+            if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                spaces[i] |= 1U << j;
+            }
+            if (c == ',') {
+                commas[i] |= 1U << j;
+            }
+            if (c == '\n') {
+                newlines[i] |= 1U << j;
+            }
+        }
+    }
+}
+
+#ifdef X86_SCANNERS
+/**
+ * @brief Classifies blocks of text 16 characters at a time with SSE2.
+ * @param text The text, blocks * SCAN_BLOCK characters.
+ * @param blocks The number of blocks.
+ * @param spaces The whitespace masks, one per block.
+ * @param commas The comma masks, one per block.
+ * @param newlines The newline masks, one per block.
+ */
+__attribute__((target("sse2")))
+static void scanBlocksSse2(const char *text, int blocks, unsigned int *spaces, unsigned int *commas,
+                           unsigned int *newlines) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    __m128i v, control;
+    unsigned int masks[3];
+    int i, half;
+
+    for (i = 0; i < blocks; i++) {
+        masks[0] = masks[1] = masks[2] = 0;
+        for (half = 0; half < 2; half++) {
+            v = _mm_loadu_si128((const __m128i *)(text + i * SCAN_BLOCK + half * 16));
+            /* '\t'..'\r' is a range: c - '\t' is at most '\r' - '\t' as an unsigned byte */
+            control = _mm_sub_epi8(v, tab);
+            control = _mm_cmpeq_epi8(_mm_min_epu8(control, control_range), control);
+            masks[0] |= (unsigned int)_mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(v, space)))
+                        << (half * 16);
+            masks[1] |= (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)) << (half * 16);
+            masks[2] |= (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (half * 16);
+        }
+        spaces[i] = masks[0];
+        commas[i] = masks[1];
+        newlines[i] = masks[2];
+    }
+}
+
+/**
+ * @brief Classifies blocks of text 32 characters at a time with AVX2.
+ * @param text The text, blocks * SCAN_BLOCK characters.
+ * @param blocks The number of blocks.
+ * @param spaces The whitespace masks, one per block.
+ * @param commas The comma masks, one per block.
+ * @param newlines The newline masks, one per block.
+ */
+__attribute__((target("avx2")))
+static void scanBlocksAvx2(const char *text, int blocks, unsigned int *spaces, unsigned int *commas,
+                           unsigned int *newlines) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i control_range = _mm256_set1_epi8('\r' - '\t');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i v, control;
+    int i;
+
+    for (i = 0; i < blocks; i++) {
+        v = _mm256_loadu_si256((const __m256i *)(text + i * SCAN_BLOCK));
+        control = _mm256_sub_epi8(v, tab);
+        control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, control_range), control);
+        spaces[i] = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(control, _mm256_cmpeq_epi8(v, space)));
+        commas[i] = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, comma));
+        newlines[i] = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+    }
+}
+#endif
+
+/* The block scanner picked by initScanner */
+static ScanBlocks chosen = NULL;
+
+/**
+ * @brief Picks the widest block scanner the processor supports.
+ *
+ * ASSEMBLER_SCAN=scalar, sse2 or avx2 in the environment forces a scanner
+ * (a scanner the processor can't run is never picked). It has to be called
+ * before threads are started, scanText calls it if it was not.
+ */
+void initScanner(void) {
+    ScanBlocks picked = scanBlocksScalar;
+    const char *forced;
+
+    if (chosen != NULL) {
+        return;
+    }
+    forced = getenv("ASSEMBLER_SCAN");
+#ifdef X86_SCANNERS
+    __builtin_cpu_init();
+    if (forced == NULL || strcmp(forced, "scalar") != 0) {
+        if (__builtin_cpu_supports("avx2") && (forced == NULL || strcmp(forced, "avx2") == 0)) {
+            picked = scanBlocksAvx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            picked = scanBlocksSse2;
+        }
+    }
+#else
+    (void)forced;
+#endif
+    chosen = picked;
+}
+
+/**
+ * @brief Classifies a whole text in one pass.
+ *
+ * For every character there is one bit in each mask: whitespace (newlines
+ * included), commas, newlines, and separators (whitespace or commas). The
+ * lexer finds tokens and lines from the masks instead of testing the text a
+ * character at a time.
+ *
+ * @param scan The scan to fill.
+ * @param text The text, it doesn't have to be null terminated.
+ * @param length The length of the text.
+ * @param arena The per-file arena that the masks are allocated from.
+ */
+void scanText(Scan *scan, const char *text, int length, Arena *arena) {
+    ScanBlocks scanBlocks;
+    int full_blocks = length / SCAN_BLOCK;
+    int blocks = full_blocks + 1; /* The last block is partial, or empty */
+    char tail[SCAN_BLOCK];
+    int i;
+
+    initScanner();
+    scanBlocks = chosen;
+    scan->text = text;
+    scan->length = length;
+    scan->spaces = (unsigned int *)arenaAlloc(arena, blocks * sizeof(unsigned int));
+    scan->commas = (unsigned int *)arenaAlloc(arena, blocks * sizeof(unsigned int));
+    scan->newlines = (unsigned int *)arenaAlloc(arena, blocks * sizeof(unsigned int));
+
+    scan->separators = (unsigned int *)arenaAlloc(arena, blocks * sizeof(unsigned int));
+
+    scanBlocks(text, full_blocks, scan->spaces, scan->commas, scan->newlines);
+
+    /* The end of the text may be the end of a mapping, so the tail is scanned from a padded copy */
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, text + full_blocks * SCAN_BLOCK, (size_t)(length - full_blocks * SCAN_BLOCK));
+    scanBlocks(tail, 1, scan->spaces + full_blocks, scan->commas + full_blocks, scan->newlines + full_blocks);
+
+    /* Operands are separated by both, so their mask is kept ready */
+    for (i = 0; i < blocks; i++) {
+        scan->separators[i] = scan->spaces[i] | scan->commas[i];
+    }
+}
@@ -1,358 +1,281 @@
 #include "HEDER.h"
-/**
- * @brief Gets the legal number of operands for a given opcode.
- * @return The number of operands that the given opcode requires.
- */
-int getOperandCount(int opcode_value) {
-    static const int operand_counts[] = {2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0};
-    return operand_counts[opcode_value];
-}
+
+/* Two octal digits for every 6 bit value, digits of value i at 2 * i */
+static const char octal_pairs[] =
+    "00010203040506071011121314151617"
+    "20212223242526273031323334353637"
+    "40414243444546475051525354555657"
+    "60616263646566677071727374757677";
+
+/* Four binary digits for every 4 bit value */
+static const char binary_nibbles[16][4] = {
+    {'0', '0', '0', '0'}, {'0', '0', '0', '1'}, {'0', '0', '1', '0'}, {'0', '0', '1', '1'},
+    {'0', '1', '0', '0'}, {'0', '1', '0', '1'}, {'0', '1', '1', '0'}, {'0', '1', '1', '1'},
+    {'1', '0', '0', '0'}, {'1', '0', '0', '1'}, {'1', '0', '1', '0'}, {'1', '0', '1', '1'},
+    {'1', '1', '0', '0'}, {'1', '1', '0', '1'}, {'1', '1', '1', '0'}, {'1', '1', '1', '1'}
+};
 
 /**
  * @brief Converts an integer to a binary string representation.
  *
  * This function takes an integer, masks it to fit within 15 bits,
- * and then converts it to a binary string representation. The function 
- * allocates memory for the binary string, which the caller must free!!!
+ * and then converts it to a binary string representation in the
+ * buffer of the caller, four bits at a time from a table.
  * 
  * @param num The integer to be converted to binary. Only the lower 15 bits are used.
- * @return A pointer to a dynamically allocated string containing the binary representation of the number.
- *         The caller is responsible for freeing this memory.
+ * @param binary_str A buffer of at least BITS + 1 characters for the binary string.
+ * @return The binary_str buffer.
  */
-char* printBinary(int num) {
-    int i;
-    char *binary_str = (char *)malloc(BITS + 1);
+char* printBinary(int num, char *binary_str) {
     num = num & 0x7FFF;
-    if (binary_str == NULL) {
-        perror("ERR: Unable to allocate memory for binary string");
-        exit(EXIT_FAILURE);
-    }
-    for (i = 0; i < BITS; i++) {
-        binary_str[i] = (num & (1 << (BITS - 1 - i))) ? '1' : '0';
-    }
+    memcpy(binary_str, binary_nibbles[num >> 12] + 1, 3); /* Bit 15 is never set */
+    memcpy(binary_str + 3, binary_nibbles[(num >> 8) & 0xF], 4);
+    memcpy(binary_str + 7, binary_nibbles[(num >> 4) & 0xF], 4);
+    memcpy(binary_str + 11, binary_nibbles[num & 0xF], 4);
     binary_str[BITS] = '\0'; 
     return binary_str;
 }
 
 /**
- * @brief Takes the structure table "lines" after the first pass and converts it to proper files.
- * @param name_of_file The name of the file.
- * @param lines The structure of data after the first pass.
- * @param line_count The number of lines.
- * @return 0 if the proccess succeded and 1 otherwise
+ * @brief Writes a machine word as 5 octal digits, the way "%05o" does.
+ * @param word The word, only its lower 15 bits are used.
+ * @param out The buffer, at least 5 characters.
  */
-int secondPass(char *name_of_file ,LineInfo *lines, int line_count){
-    char output_filename[MAX_LABEL_LENGTH]; 
-    char *dot_pos;
+void formatOctal(int word, char *out) {
+    word &= 0x7FFF;
+    out[0] = (char)('0' + (word >> 12));
+    memcpy(out + 1, octal_pairs + 2 * ((word >> 6) & 0x3F), 2);
+    memcpy(out + 3, octal_pairs + 2 * (word & 0x3F), 2);
+}
 
-    strcpy(output_filename, name_of_file);
+/**
+ * @brief Writes a number in decimal, padded with zeros the way "%0*d" does.
+ * @param value The number.
+ * @param width The smallest number of digits.
+ * @param out The buffer, at least MAX_NUMBER_DIGITS characters.
+ * @return The number of characters written.
+ */
+int formatDecimal(int value, int width, char *out) {
+    char digits[MAX_NUMBER_DIGITS];
+    unsigned int magnitude = value < 0 ? 0U - (unsigned int)value : (unsigned int)value;
+    int count = 0, length = 0;
 
-    dot_pos = strrchr(output_filename, '.');
-    if (dot_pos && strcmp(dot_pos, ".afp") == 0) {
-        strcpy(dot_pos, ".asp");
-    } else {
-        printf("ERR: no '.afp' file to proceed");
-        return 1;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (count < width) {
+        digits[count++] = '0';
     }
-
-    generateOutput(lines, line_count, output_filename);
-
-    return 0;
+    if (value < 0) {
+        out[length++] = '-';
+    }
+    while (count > 0) {
+        out[length++] = digits[--count];
+    }
+    return length;
 }
 
 /**
- * @brief Finds the memory value of a given label.
- *
- * This function searches through a LineInfo struct to find a 
- * specific label. If the label is found, it returns the associated memory value.
- * 
- * @param lines is a LineInfo struct that contains label names and memory values.
- * @param numLines The number of elements in the lines struct.
- * @param label The label name to search for in the lines struct.
- * @return The memory value associated with the label if found, otherwise returns -1.
+ * @brief Takes the program after the first pass and converts it to proper files.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param program The lines, symbols and data of the file after the first pass.
+ * @param options The files that were asked for, the ".asp" file is written only if asked.
+ * @return 0 if the proccess succeded and 1 otherwise
  */
-int findLabelMemory(LineInfo lines[], int numLines, char *label){
-    int i;
-    for (i = 0; i < numLines; i++) {   
-        if(strcmp(lines[i].label_name, label) == 0) {
-            return lines[i].memory_value;
-        }
-    }
-    return -1;
+int secondPass(const char *base_name, Program *program, const Options *options){
+    generateOutput(program, base_name, options);
+    return 0;
 }
 
 /**
  * @brief Finds and formats the address associated with a given label.
  *
- * This function searches through a LineInfo struct to find a 
- * specific label and formats its memory address. The function 
- * also checks if the label is an entry or external and formats the address accordingly.
+ * This function formats the memory address of a label from the symbol table.
+ * The function also checks if the label is external and formats the address accordingly.
  * 
- * @param lines is a LineInfo struct that contains label names and memory values.
- * @param numLines The number of elements in the lines array.
- * @param label The label name to search for in the lines array.
- * @return The formatted address associated with the label, or 1 if the label is external and not found in the array.
+ * @param symbols The symbol table built at the end of the first pass.
+ * @param id The id of the label in the symbol table.
+ * @return The formatted address associated with the label, 1 if the label is external, or -1 if it is not defined.
  */
-int findLabelAddress(LineInfo lines[], int numLines, char *label){
+int findLabelAddress(SymbolTable *symbols, int id){
     int word = -1;
-    int i;
-    if(isExtern(lines, numLines, label) == 0) {
+
+    if (symbols->symbols[id].flags & SYMBOL_EXTERN) {
          return 1;
     }
-    
-    for (i = 0; i < numLines; i++) {   
-        if(strcmp(lines[i].label_name, label) == 0) { 
-            word = 0;
-            word |= ((lines[i].memory_value) << 3);
-            word |= (1 << 1);
-        }
+    if (symbols->symbols[id].flags & SYMBOL_DEFINED) {
+        word = 0;
+        word |= ((symbols->symbols[id].address) << 3);
+        word |= (1 << 1);
     }
-    
     return word;
 }
 
 /**
- * @brief Generates the output files based on the parsed lines of assembly code.
+ * @brief Encodes the extra word of a single operand.
+ * @param method The addressing method of the operand.
+ * @param value The decoded operand: a number, a register number or a symbol id.
+ * @param shift The position of the register field, 6 for a source and 3 for a destination.
+ * @param symbols The symbol table built at the end of the first pass.
+ * @return The encoded word, or -1 if the operand is a label that is not defined.
+ */
+int encodeOperand(int method, int value, int shift, SymbolTable *symbols){
+    if (method == IMMEDIATE) {
+        return (value << 3) | A;
+    }
+    if (method == DIRECT) {
+        return findLabelAddress(symbols, value);
+    }
+    return (value << shift) | A;
+}
+
+/**
+ * @brief Encodes the program into machine words and describes it as an object.
  *
- * This function processes a LineInfo struct, generating the binary output 
- * for each line and writing it to a specified output file. It handles various types of lines, 
+ * This function processes the line table of the program, generating the machine words
+ * for each line. It handles various types of lines, 
  * including data lines, string lines, entry lines, extern lines and operation lines.
+ * The operands and data were decoded by the first pass, so the encoding here works on numbers only,
+ * reading the hot fields of the lines from their contiguous arrays. Nothing is written to files.
  *
- * @param lines a LineInfo struct that contains the parsed assembly lines.
- * @param numLines The number of elements in the lines struct.
- * @param filename The name of the output file where the binary data will be written.
+ * @param program The lines, symbols and data of the file after the first pass.
+ * @param object The object, its words are set even if there are errors.
+ * @return 0 if the program has no errors and 1 otherwise.
  */
-void generateOutput(LineInfo lines[], int numLines, const char *filename) {
-    int output[MAX_LINES] = {0};
-    int outputIndex = MIN_MEM_VAL;
+int encodeProgram(Program *program, ObjectImage *object) {
+    LineTable *lines = &program->lines;
+    SymbolTable *symbols = &program->symbols;
+    MemoryImage image;
     int ic = 0, dc = 0;
-    int value;
-    char *c;
-    char *token;
-    char *temp;
     int word;
-    int address;
-    int regWord;
-    char *binary_str;
     int i, k;
-    FILE *file;
+    int opcode, source_method, destination_method;
+    const int *data_words;
+    RelocationList relocations;
+
+    relocations.refs = NULL;
+    relocations.count = 0;
+    relocations.capacity = 0;
+    relocations.arena = program->arena;
+
+    /* The first pass already sized every line, so the image normally never grows */
+    image.words = NULL;
+    image.count = 0;
+    image.capacity = 0;
+    image.arena = program->arena;
+    if (lines->count > 0) {
+        image.capacity = lines->memory_value[lines->count - 1] + lines->memory_cells[lines->count - 1] - MIN_MEM_VAL;
+        image.words = (unsigned short *)arenaAlloc(program->arena, image.capacity * sizeof(unsigned short));
+    }
     
-    for (i = 0; i < numLines; i++) {
-        LineInfo line = lines[i];
-
-        if (line.is_data) {
-            token = strtok(line.data_string_value, ",");
-            token[strcspn(token, "\r\t\n")] = '\0';
-            while (token) {
-                temp = token;
-                if (*temp == '+' || *temp == '-') {
-                    temp++; }
-                while (*temp) {
-                    if (!isdigit(*temp)) {
-                        printf("ERR: '%s' is not a valid data value\n", token);
-                        lines[i].flag = true;
-			break ;
-                    }
-		    else {
-                    temp++; }
-                }
-                value = atoi(token);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = (value & 0x7FFF);
-                    dc++;
-                }
-                token = strtok(NULL, ",\t ");
-            }
-        } else if (line.is_string) {
-            for (c = line.data_string_value; *c; c++) {
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = (*c & 0x7FFF);
-                    dc++;
-                }
-            }
-            if (outputIndex < MAX_LINES) {
-                output[outputIndex++] = 0;
+    for (i = 0; i < lines->count; i++) {
+        opcode = lines->opcode_value[i];
+        source_method = lines->source_method[i];
+        destination_method = lines->destination_method[i];
+
+        if (lines->info[i].is_data || lines->info[i].is_string) {
+            data_words = program->data.values + lines->info[i].data_start;
+            for (k = 0; k < lines->memory_cells[i]; k++) {
+                addWord(&image, data_words[k]);
                 dc++;
             }
 
-        } else if (line.opcode_value != -1) {
-            if (isGoodLine(line)==1){
-                lines[i].flag=true;
-                printf("ERR: the '%s' op code in line %d and method combination is not valid\n",line.opcode_name, i);
+        } else if (opcode != -1) {
+            if (isGoodLine(lines, i)==1){
+                lines->info[i].flag=true;
+                report("ERR: the '%s' op code in line %d and method combination is not valid\n",getOpcodeName(opcode), i);
             }
             
-            word = (line.opcode_value << 11);
-
-            if (line.source_method == IMMEDIATE) {
-                word |= (1 << 7);
-            } else if (line.source_method == DIRECT) {
-                word |= (1 << 8);
-            } else if (line.source_method == INDIRECT_REGISTER) {
-                word |= (1 << 9);
-            } else if (line.source_method == DIRECT_REGISTER) {
-                word |= (1 << 10);
-            }
-
-            if (line.destination_method == IMMEDIATE) {
-                word |= (1 << 3);
-            } else if (line.destination_method == DIRECT) {
-                word |= (1 << 4);
-            } else if (line.destination_method == INDIRECT_REGISTER) {
-                word |= (1 << 5);
-            } else if (line.destination_method == DIRECT_REGISTER) {
-                word |= (1 << 6);
-            }
+            word = getInstructionForm(opcode, source_method, destination_method).first_word;
 
-            word |= (1 << 2);
+            addWord(&image, word);
+            ic++;
 
-            if (outputIndex < MAX_LINES) {
-                output[outputIndex++] = word;
+            if ((source_method == DIRECT_REGISTER || source_method == INDIRECT_REGISTER) &&
+                (destination_method == DIRECT_REGISTER || destination_method == INDIRECT_REGISTER)) {
+                /* Two register operands share one word */
+                word = (lines->source_value[i] << 6) | (lines->destination_value[i] << 3) | A;
+                addWord(&image, word);
                 ic++;
-            }
-            word = 0;
-
-            if (line.source_method == IMMEDIATE) {
-                value = atoi(line.source_method_value + 1);
-                if (outputIndex < MAX_LINES) {
-                    word = (value << 3);
-                    word |= (1 << 2);
-                    output[outputIndex++] = word;
-                    ic++;
-                }
-            } else if (line.source_method == DIRECT) {
-                address = findLabelAddress(lines, numLines, line.source_method_value);
-                if (address == -1) {
-                    printf("ERR: the label %s wasn't found\n", line.source_method_value);
-                    lines[i].flag = true;
-                }
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = address;
-                    ic++;
-                }
-            } else if ((line.destination_method == DIRECT_REGISTER || line.destination_method == INDIRECT_REGISTER) &&
-                       (line.source_method == DIRECT_REGISTER || line.source_method == INDIRECT_REGISTER)) {
-                regWord = 0;
-                if (line.source_method == INDIRECT_REGISTER) {
-                    regWord |= ((line.source_method_value[2] - '0') << 6);
-                } else if (line.source_method == DIRECT_REGISTER) {
-                    regWord |= ((line.source_method_value[1] - '0') << 6);
-                }
-
-                if (line.destination_method == INDIRECT_REGISTER) {
-                    regWord |= ((line.destination_method_value[2] - '0') << 3);
-                } else if (line.destination_method == DIRECT_REGISTER) {
-                    regWord |= ((line.destination_method_value[1] - '0') << 3);
-                }
-
-                regWord |= (1 << 2);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = regWord;
-                    ic++;
-                }
-            } else if (line.source_method == INDIRECT_REGISTER) {
-                regWord = 0;
-                regWord |= ((line.source_method_value[2] - '0') << 6);
-                regWord |= (1 << 2);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = regWord;
-                    ic++;
-                }
-            } else if (line.source_method == DIRECT_REGISTER) {
-                regWord = 0;
-                regWord |= ((line.source_method_value[1] - '0') << 6);
-                regWord |= (1 << 2);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = regWord;
-                    ic++;
-                }
-            }
-
-            if (line.destination_method == INDIRECT_REGISTER && (line.source_method != INDIRECT_REGISTER &&
-                                                                 line.source_method != DIRECT_REGISTER)) {
-                regWord = 0;
-                regWord |= ((line.destination_method_value[2] - '0') << 3);
-                regWord |= (1 << 2);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = regWord;
-                    ic++;
-                }
-            } else if (line.destination_method == DIRECT_REGISTER && (line.source_method != INDIRECT_REGISTER &&
-                                                                      line.source_method != DIRECT_REGISTER)) {
-                regWord = 0;
-                regWord |= ((line.destination_method_value[1] - '0') << 3);
-                regWord |= (1 << 2);
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = regWord;
-                    ic++;
-                }
-            }
-            if (line.destination_method == IMMEDIATE) {
-                value = atoi(line.destination_method_value + 1);
-                if (outputIndex < MAX_LINES) {
-                    word = (value << 3);
-                    word |= (1 << 2);
-                    output[outputIndex++] = word;
+            } else {
+                if (source_method != -1) {
+                    word = encodeOperand(source_method, lines->source_value[i], 6, symbols);
+                    if (word == -1) {
+                        report("ERR: the label %s wasn't found\n", symbolName(symbols, lines->source_value[i]));
+                        lines->info[i].flag = true;
+                    }
+                    if (source_method == DIRECT && word == 1) { /*extern label, record the word that refers to it*/
+                        addExternRef(&relocations, lines->source_value[i], MIN_MEM_VAL + image.count);
+                    }
+                    addWord(&image, word);
                     ic++;
                 }
-            } else if (line.destination_method == DIRECT) {
-                address = findLabelAddress(lines, numLines, line.destination_method_value);
-                if (address == -1) {
-                    printf("ERR: the label %s wasn't found\n", line.destination_method_value);
-                    lines[i].flag = true;
-                }
-                if (outputIndex < MAX_LINES) {
-                    output[outputIndex++] = address;
+                if (destination_method != -1) {
+                    word = encodeOperand(destination_method, lines->destination_value[i], 3, symbols);
+                    if (word == -1) {
+                        report("ERR: the label %s wasn't found\n", symbolName(symbols, lines->destination_value[i]));
+                        lines->info[i].flag = true;
+                    }
+                    if (destination_method == DIRECT && word == 1) { /*extern label, record the word that refers to it*/
+                        addExternRef(&relocations, lines->destination_value[i], MIN_MEM_VAL + image.count);
+                    }
+                    addWord(&image, word);
                     ic++;
                 }
             }
         }
     }
 
-    file = fopen(filename, "w");
-    if (!file) {
-        perror("ERR: Failed to open file");
-        return;
-    }
-    for (k = MIN_MEM_VAL; k < outputIndex; k++) {
-        binary_str = printBinary(output[k]);
-        fprintf(file, "%s\n", binary_str);
-        free(binary_str);
-        binary_str = NULL;
+    buildObject(program, &image, &relocations, ic, dc, object);
+    return isFlag(lines) == false ? 0 : 1;
+}
+
+/**
+ * @brief Generates the output files of the program.
+ * @param program The lines, symbols and data of the file after the first pass.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param options The files that were asked for, the ".asp", ".bo" and ".c" files are written only if asked.
+ */
+void generateOutput(Program *program, const char *base_name, const Options *options) {
+    ObjectImage object;
+    int errors = encodeProgram(program, &object);
+    int count = object.ic + object.dc;
+    char *text;
+    int k;
+
+    if (options->write_asp) {
+        /* Every line is the 15 binary digits of a word and a newline */
+        text = (char *)arenaAlloc(program->arena, (size_t)count * (BITS + 1) + 1);
+        for (k = 0; k < count; k++) {
+            printBinary(object.words[k], text + k * (BITS + 1));
+            text[k * (BITS + 1) + BITS] = '\n';
+        }
+        writeTextFile(outputName(program->arena, base_name, ".asp"), text, count * (BITS + 1));
     }
-    fclose(file);
 
-    if (isFlag(lines, numLines) == false) {
-        makeOb(output, filename, dc, ic);
-        makeExt(lines, numLines, (char *)filename);
-        makeEnt(lines, numLines, (char *)filename);
+    if (errors == 0) {
+        writeObjectText(&object, base_name, program->arena);
+        if (options->write_bo) {
+            writeObjectFile(&object, outputName(program->arena, base_name, ".bo"), program->arena);
+        }
+        if (options->write_c) {
+            makeC(program, &object, base_name);
+        }
     } else {
-        printf("We didnt make the files (ob/ext/ent) becuse you have errors\n");
+        report("We didnt make the files (ob/ext/ent) becuse you have errors\n");
     }
 }
 
 /**
  * @brief a function that checks if the opcode and operand are valid
- * @param lines gets line info structure
+ * @param lines gets the line table
+ * @param index gets the index of the line
  * @return true if the line is not valid and false otherwise
  */
-int isGoodLine(LineInfo line){
-    int opNum=line.opcode_value;
-    if ((opNum==0 || opNum==2 || opNum==3) && line.destination_method==0){
-        return true;
-    }
-    if (opNum==4  && (line.source_method!=1 || line.destination_method==0)){
-        return true;
-    }
-    if (((opNum>=5  && opNum<=8) || opNum==11) && (line.source_method!=-1 || line.destination_method==0)){
-        return true;
-    }
-    if ((opNum==9 || opNum==10 || opNum==13) && (line.source_method!=-1 || line.destination_method==0 || line.destination_method==3)){
-        return true;
-    }
-    if ((opNum==14 || opNum==15 ) && (line.source_method!=-1 || line.destination_method!=-1)){
-        return true;
-    }
-    if ((opNum==12) && (line.source_method!=-1 )){
+int isGoodLine(LineTable *lines, int index){
+    if (!getInstructionForm(lines->opcode_value[index], lines->source_method[index],
+                            lines->destination_method[index]).legal){
         return true;
     }
     return false;
@@ -360,14 +283,13 @@ int isGoodLine(LineInfo line){
 
 /**
  * @brief a function that checks if there is error lines int the process
- * @param lines gets line info structure
- * @param numLines gets the number of lines
+ * @param lines gets the line table
  * @return false if there is no errors an true if there is errors
  */
-int isFlag(LineInfo lines[], int numLines){
+int isFlag(LineTable *lines){
     int i;
-    for (i = 0; i < numLines; i++) {
-        if (lines[i].flag == true) {
+    for (i = 0; i < lines->count; i++) {
+        if (lines->info[i].flag == true) {
             return true;
         }
     }
@@ -375,188 +297,68 @@ int isFlag(LineInfo lines[], int numLines){
 }
 
 /**
- * @brief Generates the object file (.ob) based on the machine code array.
- *
- * This function creates an object file with the extension ".ob" based on the provided filename.
- * It processes the input filename to replace its extension with ".ob" and prepares the object file for writing.
- *
- * @param machine An array of integers representing the machine code.
- * @param filename The original filename to which the ".ob" extension will be applied.
- * @param dc The data counter representing the amount of data stored.
- * @param ic The instruction counter representing the number of instructions processed.
+ * @brief Adds a word to the memory image, growing it when it is full.
+ * @param image The memory image of the file.
+ * @param word The word to add, only its lower 15 bits are kept.
  */
-void makeOb(int machine[], const char *filename, int dc, int ic){
-    char *dot_pos;
-    int k;
-    FILE *file;
-    char *object_file_name = (char *)malloc(strlen(filename) + 4);
-
-    if (object_file_name == NULL) {
-        perror("ERR: Unable to allocate memory for object file name");
-        exit(EXIT_FAILURE);
-    }
-
-    strcpy(object_file_name, filename);
-    dot_pos = strrchr(object_file_name, '.');
-    if (dot_pos) {
-        strcpy(dot_pos, ".ob");
-    } else {
-        printf("ERR: no .asp file to proceed\n");
-        free(object_file_name);
-        return;
-    }
-
-    file = fopen(object_file_name, "w");
-    if (!file) {
-        perror("ERR: Failed to open file");
-        free(object_file_name);
-        return;
-    }
-
-    fprintf(file, "%d %d\n", ic, dc);
-    for (k = MIN_MEM_VAL; k < MIN_MEM_VAL + ic + dc; k++) {
-        fprintf(file, "%04d %05o\n", k, ((machine[k]) & 077777));
-    }
-    fclose(file);
-    free(object_file_name);
+void addWord(MemoryImage *image, int word){
+    if (image->count == image->capacity) {
+        image->words = (unsigned short *)arenaGrow(image->arena, image->words,
+                                                   image->capacity * sizeof(unsigned short),
+                                                   (image->capacity ? image->capacity * 2 : 256) * sizeof(unsigned short));
+        image->capacity = image->capacity ? image->capacity * 2 : 256;
+    }
+    image->words[image->count++] = (unsigned short)(word & 0x7FFF);
 }
 
 /**
- * @brief Checks if a given label is external.
+ * @brief Generates the object file (.ob) based on the memory image.
  *
- * This function iterates through a LineInfo struct to determine 
- * if a specific label is marked as external. It returns 0 if the label is found 
- * and is external, otherwise, it returns 1.
+ * This function creates an object file with the extension ".ob" based on the name of the source.
+ * The whole file is formatted from tables into one buffer and written at once.
  *
- * @param lines of LineInfo struct containing the parsed assembly lines.
- * @param num_of_lines The number of elements in the `lines` array.
- * @param label The label name to check if it is external.
- * @return 0 if the label is external, otherwise 1.
+ * @param image The machine words of the file, the first one at address MIN_MEM_VAL.
+ * @param base_name The name of the source without its ".as" extension.
+ * @param dc The data counter representing the amount of data stored.
+ * @param ic The instruction counter representing the number of instructions processed.
  */
-void makeExt(LineInfo *lines, int num_of_lines, char *filename){
-    int flag = 0;
-    int i;
+void makeOb(const MemoryImage *image, const char *base_name, int dc, int ic){
     int k;
-    char *dot_pos;
-    FILE *file;
-    char *extern_file_name;
-
-    for (i = 0; i < num_of_lines; i++) {
-        if (lines[i].is_extern) {
-            flag = 1;
-        }
-    }
-    if (flag == 0) {
-        return;
-    }
-
-    extern_file_name = (char *)malloc(strlen(filename) + 5);
-
-    if (extern_file_name == NULL) {
-        perror("ERR: Unable to allocate memory for extern file name");
-        exit(EXIT_FAILURE);
-    }
-
-    strcpy(extern_file_name, filename);
-    dot_pos = strrchr(extern_file_name, '.');
-    if (dot_pos) {
-        strcpy(dot_pos, ".ext");
-    } else {
-        printf("ERR: no .asp file to proceed\n");
-        free(extern_file_name);
-        return;
-    }
-
-    file = fopen(extern_file_name, "w");
-    if (!file) {
-        perror("ERR: Failed to open file");
-        free(extern_file_name);
-        return;
-    }
-    for (k = 0; k < num_of_lines; k++) {
-        if (isExtern(lines, num_of_lines, lines[k].source_method_value) == 0) {
-            fprintf(file, "%s %d\n", lines[k].source_method_value, lines[k].memory_value + 1);
-        }
-        if (isExtern(lines, num_of_lines, lines[k].destination_method_value) == 0) {
-            if (lines[k].source_method == -1) {
-                fprintf(file, "%s %d\n", lines[k].destination_method_value, lines[k].memory_value + 1);
-            } else {
-                fprintf(file, "%s %d\n", lines[k].destination_method_value, lines[k].memory_value + 2);
-            }
-        }
-    }
-    fclose(file);
-    free(extern_file_name);
+    int length;
+    char *text;
+    char *object_file_name = outputName(image->arena, base_name, ".ob");
+
+    /* The longest line is an address, a space, 5 octal digits and a newline */
+    text = (char *)arenaAlloc(image->arena, (size_t)(ic + dc + 1) * (MAX_NUMBER_DIGITS + 8));
+    length = formatDecimal(ic, 1, text);
+    text[length++] = ' ';
+    length += formatDecimal(dc, 1, text + length);
+    text[length++] = '\n';
+
+    for (k = 0; k < ic + dc; k++) {
+        length += formatDecimal(MIN_MEM_VAL + k, 4, text + length);
+        text[length++] = ' ';
+        formatOctal(image->words[k], text + length);
+        length += 5;
+        text[length++] = '\n';
+    }
+    writeTextFile(object_file_name, text, length);
 }
 
 /**
- * @brief Generates the entry file (.ent) based on the parsed assembly lines.
- *
- * This function creates an entry file with the extension ".ent" based on the provided filename.
- * It processes the input filename to replace its extension with ".ent" and writes all the labels
- * marked as entry points along with their memory addresses into the entry file.
- *
- * @param lines a LineInfo struct containing the parsed assembly lines.
- * @param num_of_lines The number of elements in the lines struct.
- * @param filename The original filename to which the ".ent" extension will be applied.
+ * @brief Records a word that refers to an extern label.
+ * @param relocations The list of extern references of the file.
+ * @param symbol The id of the extern symbol.
+ * @param address The address of the emitted word.
  */
-void makeEnt(LineInfo *lines, int num_of_lines, char *filename){
-    int flag = 0;
-    int i, k;
-    char *dot_pos;
-    char *entry_file_name;
-    FILE *file;
-
-    for (i = 0; i < num_of_lines; i++) {
-        if (lines[i].is_entry) {
-            flag = 1;
-        }
-    }
-    if (flag == 0) {
-        return;
-    }
-
-    entry_file_name = (char *)malloc(strlen(filename) + 5);
-
-    if (entry_file_name == NULL) {
-        perror("ERR: Unable to allocate memory for entry file name");
-        exit(EXIT_FAILURE);
-    }
-
-    strcpy(entry_file_name, filename);
-    dot_pos = strrchr(entry_file_name, '.');
-    if (dot_pos) {
-        strcpy(dot_pos, ".ent");
-    } else {
-        printf("ERR: no .asp file to proceed\n");
-        free(entry_file_name);
-        return;
-    }
-
-    file = fopen(entry_file_name, "w");
-    if (!file) {
-        perror("ERR: Failed to open file");
-        free(entry_file_name);
-        return;
-    }
-    for (k = 0; k < num_of_lines; k++) {
-        if (strcmp(lines[k].label_name, "") != 0 && lines[k].is_entry) {
-            fprintf(file, "%s %d\n", lines[k].label_name, lines[k].memory_value);
-        }
-    }
-    fclose(file);
-    free(entry_file_name);
+void addExternRef(RelocationList *relocations, int symbol, int address){
+    if (relocations->count == relocations->capacity) {
+        relocations->refs = (ExternRef *)arenaGrow(relocations->arena, relocations->refs,
+                                                   relocations->capacity * sizeof(ExternRef),
+                                                   (relocations->capacity ? relocations->capacity * 2 : 16) * sizeof(ExternRef));
+        relocations->capacity = relocations->capacity ? relocations->capacity * 2 : 16;
+    }
+    relocations->refs[relocations->count].symbol = symbol;
+    relocations->refs[relocations->count].address = address;
+    relocations->count++;
 }
-
-int isExtern(LineInfo *lines, int num_of_lines, char *label){
-    int i;
-    for (i = 0; i < num_of_lines; i++) {
-        if (lines[i].is_extern == 1 && lines[i].opcode_value == -1) {
-            if (strcmp(label, lines[i].data_string_value) == 0) {
-                return 0;
-            }
-        }
-    }
-    return 1;
-}
-
@@ -0,0 +1,271 @@
+/* STDIN_FILENO, STDOUT_FILENO and open are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "HEDER.h"
+
+/**
+ * @brief Reads the object of a program, from its ".bo" file or from its ".ob", ".ent" and ".ext" files.
+ * @param name The name given on the command line.
+ * @param arena The arena the object is read into.
+ * @param file The ".bo" file, mapped, it has to stay open as long as the object is used.
+ * @param object The object.
+ * @return 0 if succeded and 1 otherwise.
+ */
+static int readProgram(const char *name, Arena *arena, SourceFile *file, ObjectImage *object) {
+    char *base_name = arenaString(arena, name, 0);
+    char *dot_pos = strrchr(base_name, '.');
+
+    file->text = NULL;
+    file->mapped = false;
+    if (dot_pos && strcmp(dot_pos, ".bo") == 0) {
+        if (openSource(file, name, arena) == 1) {
+            report("ERR: '%s' does not exist\n", name);
+            return 1;
+        }
+        if (loadObjectFile(file, object) == 1) {
+            report("ERR: '%s' is not a binary object of this version\n", name);
+            return 1;
+        }
+        return 0;
+    }
+    /* The files are named after the source, with or without its extension */
+    if (dot_pos && (strcmp(dot_pos, ".as") == 0 || strcmp(dot_pos, ".ob") == 0)) {
+        *dot_pos = '\0';
+    }
+    return readObjectText(base_name, arena, object);
+}
+
+/**
+ * @brief Runs a program in the interpreter and then through the translator, with no input and no output,
+ * and prints how fast each was and whether they ended the same.
+ * @param machine The machine, loaded.
+ * @param object The object, loaded again for the translator.
+ * @return 0 if the runs agree and 1 otherwise.
+ */
+static int benchmark(Machine *machine, const ObjectImage *object) {
+    Machine *translated = (Machine *)malloc(sizeof(Machine));
+    const char *names[2] = {"interpreter", "translated"};
+    Machine *machines[2];
+    double seconds[2];
+    int status[2];
+    int null_fd, i, agree;
+    clock_t start;
+    Jit *jit = createJit();
+
+    null_fd = open("/dev/null", O_RDWR);
+    if (translated == NULL || null_fd == -1) {
+        perror("ERR: Unable to set up the benchmark");
+        free(translated);
+        freeJit(jit);
+        return 1;
+    }
+    if (jit == NULL) {
+        fprintf(stderr, "WARN: generated code can't run here, both runs use the interpreter\n");
+    }
+    initMachine(translated, null_fd, null_fd);
+    translated->step_limit = machine->step_limit;
+    translated->print_numbers = machine->print_numbers;
+    loadMachine(translated, object);
+    machine->input_fd = null_fd;
+    machine->output_fd = null_fd;
+    machines[0] = machine;
+    machines[1] = translated;
+
+    for (i = 0; i < 2; i++) {
+        start = clock();
+        status[i] = i == 0 || jit == NULL ? runMachine(machines[i]) : runJit(machines[i], jit);
+        seconds[i] = (double)(clock() - start) / CLOCKS_PER_SEC;
+        fprintf(stderr, "%-11s %lu instructions in %.3f seconds", names[i], machines[i]->steps, seconds[i]);
+        if (seconds[i] > 0) {
+            fprintf(stderr, ", %.1f million per second", machines[i]->steps / seconds[i] / 1e6);
+        }
+        fprintf(stderr, "\n");
+    }
+    if (seconds[0] > 0 && seconds[1] > 0) {
+        fprintf(stderr, "the translated run was %.2f times as fast\n", seconds[0] / seconds[1]);
+    }
+    /* The memory and the registers, the constants are the same as long as the code is */
+    agree = status[0] == status[1] && machine->steps == translated->steps && machine->pc == translated->pc &&
+            machine->zero == translated->zero && machine->stack_depth == translated->stack_depth &&
+            memcmp(machine->cells, translated->cells, CONSTANT_CELLS * sizeof(machine->cells[0])) == 0;
+    if (!agree) {
+        fprintf(stderr, "ERR: the runs ended in different states\n");
+    }
+    close(null_fd);
+    freeJit(jit);
+    free(translated);
+    return agree ? 0 : 1;
+}
+
+/**
+ * @brief Runs a program once for every input, each run from the state right after loading.
+ *
+ * The machine is kept as it was loaded, and after every run only the pages
+ * of memory the run wrote to are copied back, so a run costs about the same
+ * no matter how big the program is. red reads the input and what prn prints
+ * is written to the input name with ".out" added. How a run ended, if not
+ * by stop, is reported after the name of its input.
+ *
+ * @param machine The machine, loaded.
+ * @param arena The arena the names of the outputs are made in.
+ * @param names The input files.
+ * @param count The number of input files.
+ * @param statistics Print how many instructions were run and pages restored, and how long it took.
+ * @return 0 if every run stopped and 1 otherwise.
+ */
+static int runTests(Machine *machine, Arena *arena, char **names, int count, bool statistics) {
+    Machine *snapshot = (Machine *)malloc(sizeof(Machine));
+    unsigned long limit = machine->step_limit != 0 ? machine->step_limit : ULONG_MAX;
+    unsigned long steps = 0, pages = 0;
+    char *output_name;
+    clock_t start;
+    double seconds;
+    int i, status, failed = 0;
+
+    if (snapshot == NULL) {
+        perror("ERR: Unable to allocate memory for the snapshot");
+        return 1;
+    }
+    snapshotMachine(machine, snapshot);
+    start = clock();
+    for (i = 0; i < count; i++) {
+        machine->input_fd = open(names[i], O_RDONLY);
+        if (machine->input_fd == -1) {
+            report("ERR: '%s' does not exist\n", names[i]);
+            failed = 1;
+            continue;
+        }
+        output_name = outputName(arena, names[i], ".out");
+        remove(output_name);
+        machine->output_fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (machine->output_fd == -1) {
+            reportError("ERR: Failed to open file");
+            close(machine->input_fd);
+            failed = 1;
+            continue;
+        }
+
+        status = stepMachine(machine, limit - machine->steps);
+        flushMachineOutput(machine);
+        if (status == MACHINE_FAULT && machine->fault != NULL) {
+            report("%s: ", names[i]);
+            report(machine->fault, machine->pc);
+        } else if (status == MACHINE_OUT_OF_STEPS) {
+            report("%s: ERR: the program was stopped after %lu instructions\n", names[i], machine->steps);
+        }
+        if (status != MACHINE_STOPPED) {
+            failed = 1;
+        }
+        steps += machine->steps - snapshot->steps;
+        close(machine->input_fd);
+        close(machine->output_fd);
+        pages += (unsigned long)restoreMachine(machine, snapshot);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (statistics) {
+        fprintf(stderr, "%d runs, %lu instructions and %lu pages restored in %.3f seconds\n", count, steps, pages,
+                seconds);
+    }
+    free(snapshot);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    Machine *machine;
+    Arena arena;
+    SourceFile file;
+    ObjectImage object;
+    bool statistics = false, translate = false, compare = false, batch = false, tests = false;
+    Jit *jit = NULL;
+    clock_t start;
+    double seconds;
+    int i, status;
+
+    machine = (Machine *)malloc(sizeof(Machine));
+    if (machine == NULL) {
+        perror("ERR: Unable to allocate memory for the machine");
+        return 1;
+    }
+    initMachine(machine, STDIN_FILENO, STDOUT_FILENO);
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-d") == 0) {
+            machine->print_numbers = true;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+            machine->step_limit = (unsigned long)atol(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            statistics = true;
+        } else if (strcmp(argv[i], "-jit") == 0) {
+            translate = true;
+        } else if (strcmp(argv[i], "-bench") == 0) {
+            compare = true;
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "-tests") == 0) {
+            tests = true;
+        } else {
+            fprintf(stderr, "ERR: unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (batch || tests ? i > argc - 2 || batch == tests || translate : i != argc - 1) {
+        fprintf(stderr, "Usage: %s [-d] [-l steps] [-s] [-jit] [-bench] <file>\n", argv[0]);
+        fprintf(stderr, "       %s [-d] [-l steps] [-s] -batch|-tests <file> <input1> [<input2> ...]\n", argv[0]);
+        fprintf(stderr, "  runs <file>.ob (with its .ent and .ext) or <file>.bo from address %d\n", MIN_MEM_VAL);
+        fprintf(stderr, "  -d  prn prints numbers, not characters\n  -l  stops after this many instructions\n");
+        fprintf(stderr, "  -s  prints how many instructions were run and how long it took\n");
+        fprintf(stderr, "  -jit  runs the program translated to x86-64\n");
+        fprintf(stderr, "  -bench  runs the program with no input and output, interpreted and translated\n");
+        fprintf(stderr, "  -batch  runs the program once for every input, many at a time, into <input>.out\n");
+        fprintf(stderr, "  -tests  runs the program once for every input, one after another from a snapshot\n");
+        return 1;
+    }
+
+    /* The standard output belongs to the program */
+    setDiagnostics(stderr, stderr);
+    initArena(&arena, ARENA_SIZE);
+    if (readProgram(argv[i], &arena, &file, &object) == 1 || loadMachine(machine, &object) == 1) {
+        closeSource(&file);
+        freeArena(&arena);
+        free(machine);
+        return 1;
+    }
+    if (compare || batch || tests) {
+        if (tests) {
+            status = runTests(machine, &arena, argv + i + 1, argc - i - 1, statistics);
+        } else if (batch) {
+            status = runLanes(machine, argv + i + 1, argc - i - 1, statistics);
+        } else {
+            status = benchmark(machine, &object);
+        }
+        closeSource(&file);
+        freeArena(&arena);
+        free(machine);
+        return status;
+    }
+    closeSource(&file);
+
+    if (translate) {
+        jit = createJit();
+        if (jit == NULL) {
+            fprintf(stderr, "WARN: generated code can't run here, the program is interpreted\n");
+        }
+    }
+    start = clock();
+    status = jit != NULL ? runJit(machine, jit) : runMachine(machine);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (statistics) {
+        fprintf(stderr, "%lu instructions in %.3f seconds", machine->steps, seconds);
+        if (seconds > 0) {
+            fprintf(stderr, ", %.1f million per second", machine->steps / seconds / 1e6);
+        }
+        fprintf(stderr, "\n");
+    }
+    freeJit(jit);
+    freeArena(&arena);
+    free(machine);
+    return status == MACHINE_STOPPED ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+#include "HEDER.h"
+
+/**
+ * @brief Hashes a label or macro name with the FNV-1a function.
+ * @param name The name to hash, it doesn't have to be null terminated.
+ * @param length The length of the name.
+ * @return The 32 bit hash of the name.
+ */
+unsigned long hashName(const char *name, int length) {
+    unsigned long hash = 2166136261UL;
+    while (length-- > 0) {
+        hash ^= (unsigned char)*name++;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Initializes an empty symbol table.
+ * @param table A pointer to the table to be initialized.
+ * @param arena The per-file arena that owns the memory of the table.
+ */
+void initSymbolTable(SymbolTable *table, Arena *arena) {
+    table->arena = arena;
+    table->symbols = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->slots = NULL;
+    table->slot_count = 0;
+    table->names = NULL;
+    table->names_length = 0;
+    table->names_capacity = 0;
+}
+
+/**
+ * @brief Gives back the interned name of a symbol.
+ * @param table The symbol table that owns the symbol.
+ * @param id The id of the symbol.
+ * @return A pointer to the name, valid until the next insertion to the table.
+ */
+const char *symbolName(const SymbolTable *table, int id) {
+    return table->names + table->symbols[id].name;
+}
+
+/**
+ * @brief Finds the open addressed slot of a name.
+ *
+ * The slot count is always a power of two and never more than half full,
+ * so linear probing always ends on the name itself or on an empty slot.
+ *
+ * @param table The symbol table to search.
+ * @param name The label name to search for, it doesn't have to be null terminated.
+ * @param length The length of the name.
+ * @param hash The hash of the name.
+ * @return The index of the slot that holds the name or the empty slot where it belongs.
+ */
+static int findSlot(const SymbolTable *table, const char *name, int length, unsigned long hash) {
+    int mask = table->slot_count - 1;
+    int slot = (int)(hash & (unsigned long)mask);
+    const char *symbol_name;
+    int id;
+
+    while ((id = table->slots[slot]) != -1) {
+        symbol_name = symbolName(table, id);
+        if (table->symbols[id].hash == hash && strncmp(symbol_name, name, (size_t)length) == 0 &&
+            symbol_name[length] == '\0') {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Doubles the slot array and places all the symbols again.
+ * @param table The symbol table to grow.
+ */
+static void growSlots(SymbolTable *table) {
+    int i, slot, mask;
+    int new_count = table->slot_count ? table->slot_count * 2 : 64;
+    int *new_slots = (int *)arenaAlloc(table->arena, new_count * sizeof(int));
+
+    for (i = 0; i < new_count; i++) {
+        new_slots[i] = -1;
+    }
+    mask = new_count - 1;
+    for (i = 0; i < table->count; i++) {
+        slot = (int)(table->symbols[i].hash & (unsigned long)mask);
+        while (new_slots[slot] != -1) {
+            slot = (slot + 1) & mask;
+        }
+        new_slots[slot] = i;
+    }
+    table->slots = new_slots;
+    table->slot_count = new_count;
+}
+
+/**
+ * @brief Finds a symbol by name.
+ * @param table The symbol table to search.
+ * @param name The label name to search for.
+ * @return The id of the symbol, or -1 if the name is not in the table.
+ */
+int findSymbol(const SymbolTable *table, const char *name) {
+    int length = (int)strlen(name);
+
+    if (table->count == 0) {
+        return -1;
+    }
+    return table->slots[findSlot(table, name, length, hashName(name, length))];
+}
+
+/**
+ * @brief Finds a symbol by name and adds it if it is not in the table yet.
+ *
+ * A new symbol has no flags and no address. Its name is copied once into
+ * the string pool of the table.
+ *
+ * @param table The symbol table to search and update.
+ * @param name The label name of the symbol, it doesn't have to be null terminated.
+ * @param length The length of the name.
+ * @return The id of the symbol.
+ */
+int internSymbol(SymbolTable *table, const char *name, int length) {
+    unsigned long hash = hashName(name, length);
+    int slot;
+    Symbol *symbol;
+
+    if ((table->count + 1) * 2 > table->slot_count) {
+        growSlots(table);
+    }
+    slot = findSlot(table, name, length, hash);
+    if (table->slots[slot] != -1) {
+        return table->slots[slot];
+    }
+
+    if (table->names_length + length + 1 > table->names_capacity) {
+        table->names = (char *)arenaGrow(table->arena, table->names, table->names_capacity,
+                                         (table->names_length + length + 1) * 2);
+        table->names_capacity = (table->names_length + length + 1) * 2;
+    }
+    if (table->count == table->capacity) {
+        table->symbols = (Symbol *)arenaGrow(table->arena, table->symbols, table->capacity * sizeof(Symbol),
+                                             (table->capacity ? table->capacity * 2 : 32) * sizeof(Symbol));
+        table->capacity = table->capacity ? table->capacity * 2 : 32;
+    }
+
+    symbol = &table->symbols[table->count];
+    symbol->name = table->names_length;
+    symbol->hash = hash;
+    symbol->address = -1;
+    symbol->flags = 0;
+    memcpy(table->names + table->names_length, name, length);
+    table->names[table->names_length + length] = '\0';
+    table->names_length += length + 1;
+
+    table->slots[slot] = table->count;
+    return table->count++;
+}
+
+/**
+ * @brief Builds the symbol table from the lines of the first pass.
+ *
+ * Every label definition is recorded with its memory value (a label that is
+ * defined twice keeps the last address, as the old linear scan did), and
+ * every `.entry`/`.extern` statement sets the matching flag on its operand.
+ *
+ * @param program The program filled by the first pass.
+ */
+void buildSymbolTable(Program *program) {
+    SymbolTable *table = &program->symbols;
+    LineTable *lines = &program->lines;
+    int i, id;
+
+    for (i = 0; i < lines->count; i++) {
+        if (lines->info[i].label != -1) {
+            id = lines->info[i].label;
+            table->symbols[id].address = lines->memory_value[i];
+            table->symbols[id].flags |= SYMBOL_DEFINED;
+        }
+        if (lines->opcode_value[i] == -1 && lines->info[i].is_extern) {
+            id = internSymbol(table, lineText(program, i), (int)strlen(lineText(program, i)));
+            table->symbols[id].flags |= SYMBOL_EXTERN;
+        } else if (lines->opcode_value[i] == -1 && lines->info[i].is_entry) {
+            id = internSymbol(table, lineText(program, i), (int)strlen(lineText(program, i)));
+            table->symbols[id].flags |= SYMBOL_ENTRY;
+        }
+    }
+}
+
+/**
+ * @brief Resolves the `.entry`/`.extern` statements against the symbol table.
+ *
+ * Every `.entry` statement is checked once: a label that is stated both entry
+ * and extern is an error, and an entry label that is never defined gets a
+ * warning. All the problems are reported, not only the first one. Then every
+ * line that defines a label gets the entry/extern marks of its symbol.
+ *
+ * @param program The program filled by the first pass, with its symbol table built.
+ * @return The number of errors found.
+ */
+int resolveSymbols(Program *program) {
+    SymbolTable *table = &program->symbols;
+    LineTable *lines = &program->lines;
+    int i, flags;
+    int errors = 0;
+
+    for (i = 0; i < lines->count; i++) {
+        if (lines->opcode_value[i] == -1 && lines->info[i].is_entry) { /*if entry statement*/
+            flags = table->symbols[findSymbol(table, lineText(program, i))].flags;
+            if (flags & SYMBOL_EXTERN) {
+                report("ERR: label '%s' is stated entry and extern\n", lineText(program, i));
+                lines->info[i].flag = true;
+                errors++;
+            } else if (!(flags & SYMBOL_DEFINED)) {
+                report("WARN: entry label '%s' is not defined in the file\n", lineText(program, i));
+            }
+        }
+    }
+
+    for (i = 0; i < lines->count; i++) {
+        if (lines->info[i].label != -1) {
+            flags = table->symbols[lines->info[i].label].flags;
+            if (flags & SYMBOL_ENTRY) {
+                lines->info[i].is_entry = true;
+            }
+            if (flags & SYMBOL_EXTERN) {
+                lines->info[i].is_extern = true;
+            }
+        }
+    }
+    return errors;
+}